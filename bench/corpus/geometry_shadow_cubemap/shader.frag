@@ -0,0 +1,13 @@
+#version 450
+
+layout(location = 0) in vec3 gs_worldPosition;
+
+layout(set = 0, binding = 0) uniform ShadowCube {
+	mat4 faceViewProjections[6];
+	vec4 lightPosition; // w = far plane
+} u_shadow;
+
+void main()
+{
+	gl_FragDepth = length(gs_worldPosition - u_shadow.lightPosition.xyz) / u_shadow.lightPosition.w;
+}
@@ -0,0 +1,12 @@
+#version 450
+
+layout(location = 0) in vec3 in_position;
+
+layout(set = 1, binding = 0) uniform Instance {
+	mat4 model;
+} u_instance;
+
+void main()
+{
+	gl_Position = u_instance.model * vec4(in_position, 1.0);
+}
@@ -0,0 +1,873 @@
+#version 450
+
+// Material ubershader: every feature is selected at run time through u_material.flags, so a single
+// program covers all material permutations. Each layer contributes its own block of code.
+
+#define PI 3.14159265359
+#define MAX_LIGHTS 16
+#define MAX_LAYERS 24
+#define MAX_DECALS 8
+
+struct Light {
+	vec4 position;
+	vec4 color;
+	vec4 direction;
+	mat4 shadowMatrix;
+};
+
+struct Layer {
+	vec4 tint;
+	vec4 params; // x = weight, y = roughness, z = metalness, w = uv scale
+	vec4 uvTransform;
+};
+
+struct Decal {
+	mat4 projection;
+	vec4 tint;
+};
+
+layout(location = 0) in vec3 vs_worldPosition;
+layout(location = 1) in vec3 vs_normal;
+layout(location = 2) in vec3 vs_tangent;
+layout(location = 3) in vec3 vs_bitangent;
+layout(location = 4) in vec2 vs_uv;
+
+layout(set = 0, binding = 0) uniform Camera {
+	mat4 view;
+	mat4 projection;
+	vec4 position;
+} u_camera;
+
+layout(set = 2, binding = 0) uniform Lights {
+	Light lights[MAX_LIGHTS];
+	int lightCount;
+	float exposure;
+	float time;
+	float fogDensity;
+	vec4 fogColor;
+} u_lights;
+
+layout(set = 2, binding = 1) uniform Material {
+	Layer layers[MAX_LAYERS];
+	Decal decals[MAX_DECALS];
+	uint flags;
+	int layerCount;
+	int decalCount;
+	float parallaxScale;
+	vec4 emission;
+	vec4 subsurface;
+	vec4 clearcoat;
+	vec4 sheen;
+} u_material;
+
+layout(set = 3, binding = 0) uniform sampler2D u_albedoMap;
+layout(set = 3, binding = 1) uniform sampler2D u_normalMap;
+layout(set = 3, binding = 2) uniform sampler2D u_rmaMap;
+layout(set = 3, binding = 3) uniform samplerCube u_irradianceMap;
+layout(set = 3, binding = 4) uniform samplerCube u_prefilterMap;
+layout(set = 3, binding = 5) uniform sampler2D u_brdfLut;
+layout(set = 3, binding = 6) uniform sampler2DShadow u_shadowMap;
+layout(set = 3, binding = 7) uniform sampler2D u_heightMap;
+layout(set = 3, binding = 8) uniform sampler2D u_emissionMap;
+layout(set = 3, binding = 9) uniform sampler2D u_detailMap;
+layout(set = 3, binding = 10) uniform sampler2D u_decalAtlas;
+layout(set = 3, binding = 11) uniform sampler2D u_layerMaps[4];
+
+layout(location = 0) out vec4 fs_color;
+layout(location = 1) out vec4 fs_normal;
+
+const uint FLAG_NORMAL_MAP = 1u;
+const uint FLAG_PARALLAX = 2u;
+const uint FLAG_EMISSION = 4u;
+const uint FLAG_SUBSURFACE = 8u;
+const uint FLAG_CLEARCOAT = 16u;
+const uint FLAG_SHEEN = 32u;
+const uint FLAG_DETAIL = 64u;
+const uint FLAG_DECALS = 128u;
+const uint FLAG_FOG = 256u;
+const uint FLAG_LAYERS = 512u;
+const uint FLAG_ALPHA_TEST = 1024u;
+const uint FLAG_IBL = 2048u;
+
+bool has_flag(uint flag)
+{
+	return (u_material.flags & flag) != 0u;
+}
+
+float saturate(float x)
+{
+	return clamp(x, 0.0, 1.0);
+}
+
+float hash12(vec2 p)
+{
+	vec3 p3 = fract(vec3(p.xyx) * 0.1031);
+	p3 += dot(p3, p3.yzx + 33.33);
+	return fract((p3.x + p3.y) * p3.z);
+}
+
+float value_noise(vec2 p)
+{
+	vec2 i = floor(p);
+	vec2 f = fract(p);
+	vec2 u = f * f * (3.0 - 2.0 * f);
+	return mix(mix(hash12(i), hash12(i + vec2(1.0, 0.0)), u.x), mix(hash12(i + vec2(0.0, 1.0)), hash12(i + vec2(1.0, 1.0)), u.x), u.y);
+}
+
+float fbm(vec2 p)
+{
+	float sum = 0.0;
+	float amplitude = 0.5;
+	for(int i = 0; i < 5; ++i)
+	{
+		sum += amplitude * value_noise(p);
+		p = p * 2.03 + vec2(17.1, 9.7);
+		amplitude *= 0.5;
+	}
+	return sum;
+}
+
+float distribution_ggx(float nDotH, float roughness)
+{
+	float a = roughness * roughness;
+	float a2 = a * a;
+	float denom = nDotH * nDotH * (a2 - 1.0) + 1.0;
+	return a2 / (PI * denom * denom);
+}
+
+float geometry_schlick_ggx(float nDotV, float roughness)
+{
+	float r = roughness + 1.0;
+	float k = (r * r) / 8.0;
+	return nDotV / (nDotV * (1.0 - k) + k);
+}
+
+vec3 fresnel_schlick(float cosTheta, vec3 f0)
+{
+	return f0 + (1.0 - f0) * pow(saturate(1.0 - cosTheta), 5.0);
+}
+
+vec3 fresnel_schlick_roughness(float cosTheta, vec3 f0, float roughness)
+{
+	return f0 + (max(vec3(1.0 - roughness), f0) - f0) * pow(saturate(1.0 - cosTheta), 5.0);
+}
+
+float distribution_charlie(float nDotH, float roughness)
+{
+	float invAlpha = 1.0 / max(roughness * roughness, 0.0001);
+	float sin2h = max(1.0 - nDotH * nDotH, 0.0078125);
+	return (2.0 + invAlpha) * pow(sin2h, invAlpha * 0.5) / (2.0 * PI);
+}
+
+float visibility_ashikhmin(float nDotV, float nDotL)
+{
+	return saturate(1.0 / (4.0 * (nDotL + nDotV - nDotL * nDotV)));
+}
+
+vec2 parallax_occlusion(vec2 uv, vec3 viewTangent)
+{
+	const int minLayers = 8;
+	const int maxLayers = 32;
+	float layerCount = mix(float(maxLayers), float(minLayers), abs(viewTangent.z));
+	float layerDepth = 1.0 / layerCount;
+	vec2 deltaUv = viewTangent.xy / max(viewTangent.z, 0.05) * u_material.parallaxScale / layerCount;
+	vec2 currentUv = uv;
+	float currentDepth = 0.0;
+	float sampledDepth = 1.0 - textureLod(u_heightMap, currentUv, 0.0).r;
+	for(int i = 0; i < maxLayers; ++i)
+	{
+		if(currentDepth >= sampledDepth)
+			break;
+		currentUv -= deltaUv;
+		sampledDepth = 1.0 - textureLod(u_heightMap, currentUv, 0.0).r;
+		currentDepth += layerDepth;
+	}
+	vec2 previousUv = currentUv + deltaUv;
+	float after = sampledDepth - currentDepth;
+	float before = (1.0 - textureLod(u_heightMap, previousUv, 0.0).r) - currentDepth + layerDepth;
+	float weight = after / (after - before);
+	return mix(currentUv, previousUv, weight);
+}
+
+float sample_shadow_pcf(mat4 shadowMatrix, vec3 worldPosition, float bias)
+{
+	vec4 shadowCoord = shadowMatrix * vec4(worldPosition, 1.0);
+	shadowCoord.xyz /= shadowCoord.w;
+	float rotation = hash12(gl_FragCoord.xy) * 2.0 * PI;
+	mat2 rot = mat2(cos(rotation), sin(rotation), -sin(rotation), cos(rotation));
+	float shadow = 0.0;
+	for(int x = -2; x <= 2; ++x)
+	{
+		for(int y = -2; y <= 2; ++y)
+		{
+			vec2 offset = rot * vec2(x, y) / 2048.0;
+			shadow += texture(u_shadowMap, vec3(shadowCoord.xy + offset, shadowCoord.z - bias));
+		}
+	}
+	return shadow / 25.0;
+}
+
+
+vec4 evaluate_layer0(Layer layer, vec2 uv, vec3 n, inout float roughness, inout float metalness)
+{
+	vec2 layerUv = uv * layer.params.w + layer.uvTransform.xy + layer.uvTransform.zw * u_lights.time;
+	vec4 sampled = texture(u_layerMaps[0], layerUv);
+	float mask = saturate(fbm(layerUv * 1.50) * 1.00 - 0.20);
+	float slope = saturate(dot(n, vec3(0.0, 1.0, 0.0)) * 0.50 + 0.0);
+	float detail = sin(abs(sampled.r) + 0.5) * cos(abs(mask) + 0.25);
+	float weight = layer.params.x * mask * mix(1.0, slope, 0.0) * (0.75 + 0.25 * detail);
+	roughness = mix(roughness, layer.params.y * (0.8 + 0.2 * sampled.a), weight);
+	metalness = mix(metalness, layer.params.z, weight);
+	vec3 color = layer.tint.rgb * sampled.rgb;
+	color = mix(color, color.gbr, saturate(detail * 0.0));
+	return vec4(color, weight);
+}
+
+vec4 evaluate_layer1(Layer layer, vec2 uv, vec3 n, inout float roughness, inout float metalness)
+{
+	vec2 layerUv = uv * layer.params.w + layer.uvTransform.xy + layer.uvTransform.zw * u_lights.time;
+	vec4 sampled = texture(u_layerMaps[1], layerUv);
+	float mask = saturate(fbm(layerUv * 1.75) * 1.10 - 0.21);
+	float slope = saturate(dot(n, vec3(0.0, 1.0, 0.0)) * 0.55 + 0.1);
+	float detail = cos(abs(sampled.g) + 1.5) * log2(abs(mask) + 0.50);
+	float weight = layer.params.x * mask * mix(1.0, slope, 0.3) * (0.75 + 0.25 * detail);
+	roughness = mix(roughness, layer.params.y * (0.8 + 0.2 * sampled.a), weight);
+	metalness = mix(metalness, layer.params.z, weight);
+	vec3 color = layer.tint.rgb * sampled.rgb;
+	for(int k = 0; k < 3; ++k)
+		color += 0.05 * vec3(value_noise(layerUv * float(k + 2)), value_noise(layerUv.yx * float(k + 3)), detail);
+	return vec4(color, weight);
+}
+
+vec4 evaluate_layer2(Layer layer, vec2 uv, vec3 n, inout float roughness, inout float metalness)
+{
+	vec2 layerUv = uv * layer.params.w + layer.uvTransform.xy + layer.uvTransform.zw * u_lights.time;
+	vec4 sampled = texture(u_layerMaps[2], layerUv);
+	float mask = saturate(fbm(layerUv * 2.00) * 1.20 - 0.22);
+	float slope = saturate(dot(n, vec3(0.0, 1.0, 0.0)) * 0.60 + 0.2);
+	float detail = sqrt(abs(sampled.b) + 2.5) * sin(abs(mask) + 0.75);
+	float weight = layer.params.x * mask * mix(1.0, slope, 0.6) * (0.75 + 0.25 * detail);
+	roughness = mix(roughness, layer.params.y * (0.8 + 0.2 * sampled.a), weight);
+	metalness = mix(metalness, layer.params.z, weight);
+	vec3 color = layer.tint.rgb * sampled.rgb;
+	if(mask > 0.34)
+		color = pow(max(color, vec3(0.0)), vec3(1.10));
+	else
+		color *= 0.88 + 0.1 * detail;
+	return vec4(color, weight);
+}
+
+vec4 evaluate_layer3(Layer layer, vec2 uv, vec3 n, inout float roughness, inout float metalness)
+{
+	vec2 layerUv = uv * layer.params.w + layer.uvTransform.xy + layer.uvTransform.zw * u_lights.time;
+	vec4 sampled = texture(u_layerMaps[3], layerUv);
+	float mask = saturate(fbm(layerUv * 2.25) * 1.30 - 0.23);
+	float slope = saturate(dot(n, vec3(0.0, 1.0, 0.0)) * 0.65 + 0.3);
+	float detail = exp2(abs(sampled.a) + 3.5) * exp2(abs(mask) + 1.00);
+	float weight = layer.params.x * mask * mix(1.0, slope, 0.0) * (0.75 + 0.25 * detail);
+	roughness = mix(roughness, layer.params.y * (0.8 + 0.2 * sampled.a), weight);
+	metalness = mix(metalness, layer.params.z, weight);
+	vec3 color = layer.tint.rgb * sampled.rgb;
+	color = mix(color, color.gbr, saturate(detail * 0.3));
+	return vec4(color, weight);
+}
+
+vec4 evaluate_layer4(Layer layer, vec2 uv, vec3 n, inout float roughness, inout float metalness)
+{
+	vec2 layerUv = uv * layer.params.w + layer.uvTransform.xy + layer.uvTransform.zw * u_lights.time;
+	vec4 sampled = texture(u_layerMaps[0], layerUv);
+	float mask = saturate(fbm(layerUv * 2.50) * 1.40 - 0.24);
+	float slope = saturate(dot(n, vec3(0.0, 1.0, 0.0)) * 0.70 + 0.4);
+	float detail = log2(abs(sampled.r) + 4.5) * abs(abs(mask) + 1.25);
+	float weight = layer.params.x * mask * mix(1.0, slope, 0.3) * (0.75 + 0.25 * detail);
+	roughness = mix(roughness, layer.params.y * (0.8 + 0.2 * sampled.a), weight);
+	metalness = mix(metalness, layer.params.z, weight);
+	vec3 color = layer.tint.rgb * sampled.rgb;
+	for(int k = 0; k < 2; ++k)
+		color += 0.05 * vec3(value_noise(layerUv * float(k + 2)), value_noise(layerUv.yx * float(k + 3)), detail);
+	return vec4(color, weight);
+}
+
+vec4 evaluate_layer5(Layer layer, vec2 uv, vec3 n, inout float roughness, inout float metalness)
+{
+	vec2 layerUv = uv * layer.params.w + layer.uvTransform.xy + layer.uvTransform.zw * u_lights.time;
+	vec4 sampled = texture(u_layerMaps[1], layerUv);
+	float mask = saturate(fbm(layerUv * 2.75) * 1.50 - 0.25);
+	float slope = saturate(dot(n, vec3(0.0, 1.0, 0.0)) * 0.75 + 0.0);
+	float detail = fract(abs(sampled.g) + 5.5) * sqrt(abs(mask) + 1.50);
+	float weight = layer.params.x * mask * mix(1.0, slope, 0.6) * (0.75 + 0.25 * detail);
+	roughness = mix(roughness, layer.params.y * (0.8 + 0.2 * sampled.a), weight);
+	metalness = mix(metalness, layer.params.z, weight);
+	vec3 color = layer.tint.rgb * sampled.rgb;
+	if(mask > 0.40)
+		color = pow(max(color, vec3(0.0)), vec3(1.25));
+	else
+		color *= 0.85 + 0.1 * detail;
+	return vec4(color, weight);
+}
+
+vec4 evaluate_layer6(Layer layer, vec2 uv, vec3 n, inout float roughness, inout float metalness)
+{
+	vec2 layerUv = uv * layer.params.w + layer.uvTransform.xy + layer.uvTransform.zw * u_lights.time;
+	vec4 sampled = texture(u_layerMaps[2], layerUv);
+	float mask = saturate(fbm(layerUv * 3.00) * 1.60 - 0.26);
+	float slope = saturate(dot(n, vec3(0.0, 1.0, 0.0)) * 0.80 + 0.1);
+	float detail = abs(abs(sampled.b) + 6.5) * fract(abs(mask) + 1.75);
+	float weight = layer.params.x * mask * mix(1.0, slope, 0.0) * (0.75 + 0.25 * detail);
+	roughness = mix(roughness, layer.params.y * (0.8 + 0.2 * sampled.a), weight);
+	metalness = mix(metalness, layer.params.z, weight);
+	vec3 color = layer.tint.rgb * sampled.rgb;
+	color = mix(color, color.gbr, saturate(detail * 0.2));
+	return vec4(color, weight);
+}
+
+vec4 evaluate_layer7(Layer layer, vec2 uv, vec3 n, inout float roughness, inout float metalness)
+{
+	vec2 layerUv = uv * layer.params.w + layer.uvTransform.xy + layer.uvTransform.zw * u_lights.time;
+	vec4 sampled = texture(u_layerMaps[3], layerUv);
+	float mask = saturate(fbm(layerUv * 3.25) * 1.70 - 0.27);
+	float slope = saturate(dot(n, vec3(0.0, 1.0, 0.0)) * 0.85 + 0.2);
+	float detail = sin(abs(sampled.a) + 7.5) * cos(abs(mask) + 2.00);
+	float weight = layer.params.x * mask * mix(1.0, slope, 0.3) * (0.75 + 0.25 * detail);
+	roughness = mix(roughness, layer.params.y * (0.8 + 0.2 * sampled.a), weight);
+	metalness = mix(metalness, layer.params.z, weight);
+	vec3 color = layer.tint.rgb * sampled.rgb;
+	for(int k = 0; k < 5; ++k)
+		color += 0.05 * vec3(value_noise(layerUv * float(k + 2)), value_noise(layerUv.yx * float(k + 3)), detail);
+	return vec4(color, weight);
+}
+
+vec4 evaluate_layer8(Layer layer, vec2 uv, vec3 n, inout float roughness, inout float metalness)
+{
+	vec2 layerUv = uv * layer.params.w + layer.uvTransform.xy + layer.uvTransform.zw * u_lights.time;
+	vec4 sampled = texture(u_layerMaps[0], layerUv);
+	float mask = saturate(fbm(layerUv * 3.50) * 1.80 - 0.28);
+	float slope = saturate(dot(n, vec3(0.0, 1.0, 0.0)) * 0.90 + 0.3);
+	float detail = cos(abs(sampled.r) + 8.5) * log2(abs(mask) + 2.25);
+	float weight = layer.params.x * mask * mix(1.0, slope, 0.6) * (0.75 + 0.25 * detail);
+	roughness = mix(roughness, layer.params.y * (0.8 + 0.2 * sampled.a), weight);
+	metalness = mix(metalness, layer.params.z, weight);
+	vec3 color = layer.tint.rgb * sampled.rgb;
+	if(mask > 0.46)
+		color = pow(max(color, vec3(0.0)), vec3(1.40));
+	else
+		color *= 0.82 + 0.1 * detail;
+	return vec4(color, weight);
+}
+
+vec4 evaluate_layer9(Layer layer, vec2 uv, vec3 n, inout float roughness, inout float metalness)
+{
+	vec2 layerUv = uv * layer.params.w + layer.uvTransform.xy + layer.uvTransform.zw * u_lights.time;
+	vec4 sampled = texture(u_layerMaps[1], layerUv);
+	float mask = saturate(fbm(layerUv * 3.75) * 1.90 - 0.29);
+	float slope = saturate(dot(n, vec3(0.0, 1.0, 0.0)) * 0.95 + 0.4);
+	float detail = sqrt(abs(sampled.g) + 9.5) * sin(abs(mask) + 2.50);
+	float weight = layer.params.x * mask * mix(1.0, slope, 0.0) * (0.75 + 0.25 * detail);
+	roughness = mix(roughness, layer.params.y * (0.8 + 0.2 * sampled.a), weight);
+	metalness = mix(metalness, layer.params.z, weight);
+	vec3 color = layer.tint.rgb * sampled.rgb;
+	color = mix(color, color.gbr, saturate(detail * 0.1));
+	return vec4(color, weight);
+}
+
+vec4 evaluate_layer10(Layer layer, vec2 uv, vec3 n, inout float roughness, inout float metalness)
+{
+	vec2 layerUv = uv * layer.params.w + layer.uvTransform.xy + layer.uvTransform.zw * u_lights.time;
+	vec4 sampled = texture(u_layerMaps[2], layerUv);
+	float mask = saturate(fbm(layerUv * 4.00) * 2.00 - 0.30);
+	float slope = saturate(dot(n, vec3(0.0, 1.0, 0.0)) * 1.00 + 0.0);
+	float detail = exp2(abs(sampled.b) + 10.5) * exp2(abs(mask) + 2.75);
+	float weight = layer.params.x * mask * mix(1.0, slope, 0.3) * (0.75 + 0.25 * detail);
+	roughness = mix(roughness, layer.params.y * (0.8 + 0.2 * sampled.a), weight);
+	metalness = mix(metalness, layer.params.z, weight);
+	vec3 color = layer.tint.rgb * sampled.rgb;
+	for(int k = 0; k < 4; ++k)
+		color += 0.05 * vec3(value_noise(layerUv * float(k + 2)), value_noise(layerUv.yx * float(k + 3)), detail);
+	return vec4(color, weight);
+}
+
+vec4 evaluate_layer11(Layer layer, vec2 uv, vec3 n, inout float roughness, inout float metalness)
+{
+	vec2 layerUv = uv * layer.params.w + layer.uvTransform.xy + layer.uvTransform.zw * u_lights.time;
+	vec4 sampled = texture(u_layerMaps[3], layerUv);
+	float mask = saturate(fbm(layerUv * 4.25) * 2.10 - 0.31);
+	float slope = saturate(dot(n, vec3(0.0, 1.0, 0.0)) * 1.05 + 0.1);
+	float detail = log2(abs(sampled.a) + 11.5) * abs(abs(mask) + 3.00);
+	float weight = layer.params.x * mask * mix(1.0, slope, 0.6) * (0.75 + 0.25 * detail);
+	roughness = mix(roughness, layer.params.y * (0.8 + 0.2 * sampled.a), weight);
+	metalness = mix(metalness, layer.params.z, weight);
+	vec3 color = layer.tint.rgb * sampled.rgb;
+	if(mask > 0.52)
+		color = pow(max(color, vec3(0.0)), vec3(1.55));
+	else
+		color *= 0.79 + 0.1 * detail;
+	return vec4(color, weight);
+}
+
+vec4 evaluate_layer12(Layer layer, vec2 uv, vec3 n, inout float roughness, inout float metalness)
+{
+	vec2 layerUv = uv * layer.params.w + layer.uvTransform.xy + layer.uvTransform.zw * u_lights.time;
+	vec4 sampled = texture(u_layerMaps[0], layerUv);
+	float mask = saturate(fbm(layerUv * 4.50) * 2.20 - 0.32);
+	float slope = saturate(dot(n, vec3(0.0, 1.0, 0.0)) * 1.10 + 0.2);
+	float detail = fract(abs(sampled.r) + 12.5) * sqrt(abs(mask) + 3.25);
+	float weight = layer.params.x * mask * mix(1.0, slope, 0.0) * (0.75 + 0.25 * detail);
+	roughness = mix(roughness, layer.params.y * (0.8 + 0.2 * sampled.a), weight);
+	metalness = mix(metalness, layer.params.z, weight);
+	vec3 color = layer.tint.rgb * sampled.rgb;
+	color = mix(color, color.gbr, saturate(detail * 0.0));
+	return vec4(color, weight);
+}
+
+vec4 evaluate_layer13(Layer layer, vec2 uv, vec3 n, inout float roughness, inout float metalness)
+{
+	vec2 layerUv = uv * layer.params.w + layer.uvTransform.xy + layer.uvTransform.zw * u_lights.time;
+	vec4 sampled = texture(u_layerMaps[1], layerUv);
+	float mask = saturate(fbm(layerUv * 4.75) * 2.30 - 0.33);
+	float slope = saturate(dot(n, vec3(0.0, 1.0, 0.0)) * 1.15 + 0.3);
+	float detail = abs(abs(sampled.g) + 13.5) * fract(abs(mask) + 3.50);
+	float weight = layer.params.x * mask * mix(1.0, slope, 0.3) * (0.75 + 0.25 * detail);
+	roughness = mix(roughness, layer.params.y * (0.8 + 0.2 * sampled.a), weight);
+	metalness = mix(metalness, layer.params.z, weight);
+	vec3 color = layer.tint.rgb * sampled.rgb;
+	for(int k = 0; k < 3; ++k)
+		color += 0.05 * vec3(value_noise(layerUv * float(k + 2)), value_noise(layerUv.yx * float(k + 3)), detail);
+	return vec4(color, weight);
+}
+
+vec4 evaluate_layer14(Layer layer, vec2 uv, vec3 n, inout float roughness, inout float metalness)
+{
+	vec2 layerUv = uv * layer.params.w + layer.uvTransform.xy + layer.uvTransform.zw * u_lights.time;
+	vec4 sampled = texture(u_layerMaps[2], layerUv);
+	float mask = saturate(fbm(layerUv * 5.00) * 2.40 - 0.34);
+	float slope = saturate(dot(n, vec3(0.0, 1.0, 0.0)) * 1.20 + 0.4);
+	float detail = sin(abs(sampled.b) + 14.5) * cos(abs(mask) + 3.75);
+	float weight = layer.params.x * mask * mix(1.0, slope, 0.6) * (0.75 + 0.25 * detail);
+	roughness = mix(roughness, layer.params.y * (0.8 + 0.2 * sampled.a), weight);
+	metalness = mix(metalness, layer.params.z, weight);
+	vec3 color = layer.tint.rgb * sampled.rgb;
+	if(mask > 0.58)
+		color = pow(max(color, vec3(0.0)), vec3(1.70));
+	else
+		color *= 0.76 + 0.1 * detail;
+	return vec4(color, weight);
+}
+
+vec4 evaluate_layer15(Layer layer, vec2 uv, vec3 n, inout float roughness, inout float metalness)
+{
+	vec2 layerUv = uv * layer.params.w + layer.uvTransform.xy + layer.uvTransform.zw * u_lights.time;
+	vec4 sampled = texture(u_layerMaps[3], layerUv);
+	float mask = saturate(fbm(layerUv * 5.25) * 2.50 - 0.35);
+	float slope = saturate(dot(n, vec3(0.0, 1.0, 0.0)) * 1.25 + 0.0);
+	float detail = cos(abs(sampled.a) + 15.5) * log2(abs(mask) + 4.00);
+	float weight = layer.params.x * mask * mix(1.0, slope, 0.0) * (0.75 + 0.25 * detail);
+	roughness = mix(roughness, layer.params.y * (0.8 + 0.2 * sampled.a), weight);
+	metalness = mix(metalness, layer.params.z, weight);
+	vec3 color = layer.tint.rgb * sampled.rgb;
+	color = mix(color, color.gbr, saturate(detail * 0.3));
+	return vec4(color, weight);
+}
+
+vec4 evaluate_layer16(Layer layer, vec2 uv, vec3 n, inout float roughness, inout float metalness)
+{
+	vec2 layerUv = uv * layer.params.w + layer.uvTransform.xy + layer.uvTransform.zw * u_lights.time;
+	vec4 sampled = texture(u_layerMaps[0], layerUv);
+	float mask = saturate(fbm(layerUv * 5.50) * 2.60 - 0.36);
+	float slope = saturate(dot(n, vec3(0.0, 1.0, 0.0)) * 1.30 + 0.1);
+	float detail = sqrt(abs(sampled.r) + 16.5) * sin(abs(mask) + 4.25);
+	float weight = layer.params.x * mask * mix(1.0, slope, 0.3) * (0.75 + 0.25 * detail);
+	roughness = mix(roughness, layer.params.y * (0.8 + 0.2 * sampled.a), weight);
+	metalness = mix(metalness, layer.params.z, weight);
+	vec3 color = layer.tint.rgb * sampled.rgb;
+	for(int k = 0; k < 2; ++k)
+		color += 0.05 * vec3(value_noise(layerUv * float(k + 2)), value_noise(layerUv.yx * float(k + 3)), detail);
+	return vec4(color, weight);
+}
+
+vec4 evaluate_layer17(Layer layer, vec2 uv, vec3 n, inout float roughness, inout float metalness)
+{
+	vec2 layerUv = uv * layer.params.w + layer.uvTransform.xy + layer.uvTransform.zw * u_lights.time;
+	vec4 sampled = texture(u_layerMaps[1], layerUv);
+	float mask = saturate(fbm(layerUv * 5.75) * 2.70 - 0.37);
+	float slope = saturate(dot(n, vec3(0.0, 1.0, 0.0)) * 1.35 + 0.2);
+	float detail = exp2(abs(sampled.g) + 17.5) * exp2(abs(mask) + 4.50);
+	float weight = layer.params.x * mask * mix(1.0, slope, 0.6) * (0.75 + 0.25 * detail);
+	roughness = mix(roughness, layer.params.y * (0.8 + 0.2 * sampled.a), weight);
+	metalness = mix(metalness, layer.params.z, weight);
+	vec3 color = layer.tint.rgb * sampled.rgb;
+	if(mask > 0.64)
+		color = pow(max(color, vec3(0.0)), vec3(1.85));
+	else
+		color *= 0.73 + 0.1 * detail;
+	return vec4(color, weight);
+}
+
+vec4 evaluate_layer18(Layer layer, vec2 uv, vec3 n, inout float roughness, inout float metalness)
+{
+	vec2 layerUv = uv * layer.params.w + layer.uvTransform.xy + layer.uvTransform.zw * u_lights.time;
+	vec4 sampled = texture(u_layerMaps[2], layerUv);
+	float mask = saturate(fbm(layerUv * 6.00) * 2.80 - 0.38);
+	float slope = saturate(dot(n, vec3(0.0, 1.0, 0.0)) * 1.40 + 0.3);
+	float detail = log2(abs(sampled.b) + 18.5) * abs(abs(mask) + 4.75);
+	float weight = layer.params.x * mask * mix(1.0, slope, 0.0) * (0.75 + 0.25 * detail);
+	roughness = mix(roughness, layer.params.y * (0.8 + 0.2 * sampled.a), weight);
+	metalness = mix(metalness, layer.params.z, weight);
+	vec3 color = layer.tint.rgb * sampled.rgb;
+	color = mix(color, color.gbr, saturate(detail * 0.2));
+	return vec4(color, weight);
+}
+
+vec4 evaluate_layer19(Layer layer, vec2 uv, vec3 n, inout float roughness, inout float metalness)
+{
+	vec2 layerUv = uv * layer.params.w + layer.uvTransform.xy + layer.uvTransform.zw * u_lights.time;
+	vec4 sampled = texture(u_layerMaps[3], layerUv);
+	float mask = saturate(fbm(layerUv * 6.25) * 2.90 - 0.39);
+	float slope = saturate(dot(n, vec3(0.0, 1.0, 0.0)) * 1.45 + 0.4);
+	float detail = fract(abs(sampled.a) + 19.5) * sqrt(abs(mask) + 5.00);
+	float weight = layer.params.x * mask * mix(1.0, slope, 0.3) * (0.75 + 0.25 * detail);
+	roughness = mix(roughness, layer.params.y * (0.8 + 0.2 * sampled.a), weight);
+	metalness = mix(metalness, layer.params.z, weight);
+	vec3 color = layer.tint.rgb * sampled.rgb;
+	for(int k = 0; k < 5; ++k)
+		color += 0.05 * vec3(value_noise(layerUv * float(k + 2)), value_noise(layerUv.yx * float(k + 3)), detail);
+	return vec4(color, weight);
+}
+
+vec4 evaluate_layer20(Layer layer, vec2 uv, vec3 n, inout float roughness, inout float metalness)
+{
+	vec2 layerUv = uv * layer.params.w + layer.uvTransform.xy + layer.uvTransform.zw * u_lights.time;
+	vec4 sampled = texture(u_layerMaps[0], layerUv);
+	float mask = saturate(fbm(layerUv * 6.50) * 3.00 - 0.40);
+	float slope = saturate(dot(n, vec3(0.0, 1.0, 0.0)) * 1.50 + 0.0);
+	float detail = abs(abs(sampled.r) + 20.5) * fract(abs(mask) + 5.25);
+	float weight = layer.params.x * mask * mix(1.0, slope, 0.6) * (0.75 + 0.25 * detail);
+	roughness = mix(roughness, layer.params.y * (0.8 + 0.2 * sampled.a), weight);
+	metalness = mix(metalness, layer.params.z, weight);
+	vec3 color = layer.tint.rgb * sampled.rgb;
+	if(mask > 0.70)
+		color = pow(max(color, vec3(0.0)), vec3(2.00));
+	else
+		color *= 0.70 + 0.1 * detail;
+	return vec4(color, weight);
+}
+
+vec4 evaluate_layer21(Layer layer, vec2 uv, vec3 n, inout float roughness, inout float metalness)
+{
+	vec2 layerUv = uv * layer.params.w + layer.uvTransform.xy + layer.uvTransform.zw * u_lights.time;
+	vec4 sampled = texture(u_layerMaps[1], layerUv);
+	float mask = saturate(fbm(layerUv * 6.75) * 3.10 - 0.41);
+	float slope = saturate(dot(n, vec3(0.0, 1.0, 0.0)) * 1.55 + 0.1);
+	float detail = sin(abs(sampled.g) + 21.5) * cos(abs(mask) + 5.50);
+	float weight = layer.params.x * mask * mix(1.0, slope, 0.0) * (0.75 + 0.25 * detail);
+	roughness = mix(roughness, layer.params.y * (0.8 + 0.2 * sampled.a), weight);
+	metalness = mix(metalness, layer.params.z, weight);
+	vec3 color = layer.tint.rgb * sampled.rgb;
+	color = mix(color, color.gbr, saturate(detail * 0.1));
+	return vec4(color, weight);
+}
+
+vec4 evaluate_layer22(Layer layer, vec2 uv, vec3 n, inout float roughness, inout float metalness)
+{
+	vec2 layerUv = uv * layer.params.w + layer.uvTransform.xy + layer.uvTransform.zw * u_lights.time;
+	vec4 sampled = texture(u_layerMaps[2], layerUv);
+	float mask = saturate(fbm(layerUv * 7.00) * 3.20 - 0.42);
+	float slope = saturate(dot(n, vec3(0.0, 1.0, 0.0)) * 1.60 + 0.2);
+	float detail = cos(abs(sampled.b) + 22.5) * log2(abs(mask) + 5.75);
+	float weight = layer.params.x * mask * mix(1.0, slope, 0.3) * (0.75 + 0.25 * detail);
+	roughness = mix(roughness, layer.params.y * (0.8 + 0.2 * sampled.a), weight);
+	metalness = mix(metalness, layer.params.z, weight);
+	vec3 color = layer.tint.rgb * sampled.rgb;
+	for(int k = 0; k < 4; ++k)
+		color += 0.05 * vec3(value_noise(layerUv * float(k + 2)), value_noise(layerUv.yx * float(k + 3)), detail);
+	return vec4(color, weight);
+}
+
+vec4 evaluate_layer23(Layer layer, vec2 uv, vec3 n, inout float roughness, inout float metalness)
+{
+	vec2 layerUv = uv * layer.params.w + layer.uvTransform.xy + layer.uvTransform.zw * u_lights.time;
+	vec4 sampled = texture(u_layerMaps[3], layerUv);
+	float mask = saturate(fbm(layerUv * 7.25) * 3.30 - 0.43);
+	float slope = saturate(dot(n, vec3(0.0, 1.0, 0.0)) * 1.65 + 0.3);
+	float detail = sqrt(abs(sampled.a) + 23.5) * sin(abs(mask) + 6.00);
+	float weight = layer.params.x * mask * mix(1.0, slope, 0.6) * (0.75 + 0.25 * detail);
+	roughness = mix(roughness, layer.params.y * (0.8 + 0.2 * sampled.a), weight);
+	metalness = mix(metalness, layer.params.z, weight);
+	vec3 color = layer.tint.rgb * sampled.rgb;
+	if(mask > 0.76)
+		color = pow(max(color, vec3(0.0)), vec3(2.15));
+	else
+		color *= 0.67 + 0.1 * detail;
+	return vec4(color, weight);
+}
+
+vec4 apply_layers(vec2 uv, vec3 n, vec4 baseColor, inout float roughness, inout float metalness)
+{
+	vec4 color = baseColor;
+	if(u_material.layerCount > 0)
+	{
+		vec4 layer = evaluate_layer0(u_material.layers[0], uv, n, roughness, metalness);
+		color.rgb = mix(color.rgb, layer.rgb, saturate(layer.a));
+	}
+	if(u_material.layerCount > 1)
+	{
+		vec4 layer = evaluate_layer1(u_material.layers[1], uv, n, roughness, metalness);
+		color.rgb = mix(color.rgb, layer.rgb, saturate(layer.a));
+	}
+	if(u_material.layerCount > 2)
+	{
+		vec4 layer = evaluate_layer2(u_material.layers[2], uv, n, roughness, metalness);
+		color.rgb = mix(color.rgb, layer.rgb, saturate(layer.a));
+	}
+	if(u_material.layerCount > 3)
+	{
+		vec4 layer = evaluate_layer3(u_material.layers[3], uv, n, roughness, metalness);
+		color.rgb = mix(color.rgb, layer.rgb, saturate(layer.a));
+	}
+	if(u_material.layerCount > 4)
+	{
+		vec4 layer = evaluate_layer4(u_material.layers[4], uv, n, roughness, metalness);
+		color.rgb = mix(color.rgb, layer.rgb, saturate(layer.a));
+	}
+	if(u_material.layerCount > 5)
+	{
+		vec4 layer = evaluate_layer5(u_material.layers[5], uv, n, roughness, metalness);
+		color.rgb = mix(color.rgb, layer.rgb, saturate(layer.a));
+	}
+	if(u_material.layerCount > 6)
+	{
+		vec4 layer = evaluate_layer6(u_material.layers[6], uv, n, roughness, metalness);
+		color.rgb = mix(color.rgb, layer.rgb, saturate(layer.a));
+	}
+	if(u_material.layerCount > 7)
+	{
+		vec4 layer = evaluate_layer7(u_material.layers[7], uv, n, roughness, metalness);
+		color.rgb = mix(color.rgb, layer.rgb, saturate(layer.a));
+	}
+	if(u_material.layerCount > 8)
+	{
+		vec4 layer = evaluate_layer8(u_material.layers[8], uv, n, roughness, metalness);
+		color.rgb = mix(color.rgb, layer.rgb, saturate(layer.a));
+	}
+	if(u_material.layerCount > 9)
+	{
+		vec4 layer = evaluate_layer9(u_material.layers[9], uv, n, roughness, metalness);
+		color.rgb = mix(color.rgb, layer.rgb, saturate(layer.a));
+	}
+	if(u_material.layerCount > 10)
+	{
+		vec4 layer = evaluate_layer10(u_material.layers[10], uv, n, roughness, metalness);
+		color.rgb = mix(color.rgb, layer.rgb, saturate(layer.a));
+	}
+	if(u_material.layerCount > 11)
+	{
+		vec4 layer = evaluate_layer11(u_material.layers[11], uv, n, roughness, metalness);
+		color.rgb = mix(color.rgb, layer.rgb, saturate(layer.a));
+	}
+	if(u_material.layerCount > 12)
+	{
+		vec4 layer = evaluate_layer12(u_material.layers[12], uv, n, roughness, metalness);
+		color.rgb = mix(color.rgb, layer.rgb, saturate(layer.a));
+	}
+	if(u_material.layerCount > 13)
+	{
+		vec4 layer = evaluate_layer13(u_material.layers[13], uv, n, roughness, metalness);
+		color.rgb = mix(color.rgb, layer.rgb, saturate(layer.a));
+	}
+	if(u_material.layerCount > 14)
+	{
+		vec4 layer = evaluate_layer14(u_material.layers[14], uv, n, roughness, metalness);
+		color.rgb = mix(color.rgb, layer.rgb, saturate(layer.a));
+	}
+	if(u_material.layerCount > 15)
+	{
+		vec4 layer = evaluate_layer15(u_material.layers[15], uv, n, roughness, metalness);
+		color.rgb = mix(color.rgb, layer.rgb, saturate(layer.a));
+	}
+	if(u_material.layerCount > 16)
+	{
+		vec4 layer = evaluate_layer16(u_material.layers[16], uv, n, roughness, metalness);
+		color.rgb = mix(color.rgb, layer.rgb, saturate(layer.a));
+	}
+	if(u_material.layerCount > 17)
+	{
+		vec4 layer = evaluate_layer17(u_material.layers[17], uv, n, roughness, metalness);
+		color.rgb = mix(color.rgb, layer.rgb, saturate(layer.a));
+	}
+	if(u_material.layerCount > 18)
+	{
+		vec4 layer = evaluate_layer18(u_material.layers[18], uv, n, roughness, metalness);
+		color.rgb = mix(color.rgb, layer.rgb, saturate(layer.a));
+	}
+	if(u_material.layerCount > 19)
+	{
+		vec4 layer = evaluate_layer19(u_material.layers[19], uv, n, roughness, metalness);
+		color.rgb = mix(color.rgb, layer.rgb, saturate(layer.a));
+	}
+	if(u_material.layerCount > 20)
+	{
+		vec4 layer = evaluate_layer20(u_material.layers[20], uv, n, roughness, metalness);
+		color.rgb = mix(color.rgb, layer.rgb, saturate(layer.a));
+	}
+	if(u_material.layerCount > 21)
+	{
+		vec4 layer = evaluate_layer21(u_material.layers[21], uv, n, roughness, metalness);
+		color.rgb = mix(color.rgb, layer.rgb, saturate(layer.a));
+	}
+	if(u_material.layerCount > 22)
+	{
+		vec4 layer = evaluate_layer22(u_material.layers[22], uv, n, roughness, metalness);
+		color.rgb = mix(color.rgb, layer.rgb, saturate(layer.a));
+	}
+	if(u_material.layerCount > 23)
+	{
+		vec4 layer = evaluate_layer23(u_material.layers[23], uv, n, roughness, metalness);
+		color.rgb = mix(color.rgb, layer.rgb, saturate(layer.a));
+	}
+	return color;
+}
+
+vec4 apply_decals(vec3 worldPosition, vec4 color, inout vec3 n)
+{
+	for(int i = 0; i < u_material.decalCount; ++i)
+	{
+		Decal decal = u_material.decals[i];
+		vec4 projected = decal.projection * vec4(worldPosition, 1.0);
+		vec3 decalUvw = projected.xyz / projected.w * 0.5 + 0.5;
+		if(any(lessThan(decalUvw, vec3(0.0))) || any(greaterThan(decalUvw, vec3(1.0))))
+			continue;
+		vec2 atlasUv = (decalUvw.xy + vec2(float(i % 4), float(i / 4))) * 0.25;
+		vec4 decalColor = texture(u_decalAtlas, atlasUv) * decal.tint;
+		float fade = 1.0 - abs(decalUvw.z * 2.0 - 1.0);
+		color.rgb = mix(color.rgb, decalColor.rgb, decalColor.a * fade);
+		n = normalize(mix(n, vec3(0.0, 1.0, 0.0), decalColor.a * fade * 0.1));
+	}
+	return color;
+}
+
+vec3 evaluate_light(Light light, vec3 worldPosition, vec3 n, vec3 v, vec3 albedo, float roughness, float metalness, vec3 f0, int index)
+{
+	vec3 l;
+	float attenuation = 1.0;
+	if(light.position.w == 0.0)
+		l = normalize(-light.direction.xyz);
+	else
+	{
+		vec3 toLight = light.position.xyz - worldPosition;
+		float dist = length(toLight);
+		l = toLight / dist;
+		float range = light.position.w;
+		attenuation = pow(saturate(1.0 - pow(dist / range, 4.0)), 2.0) / (dist * dist + 1.0);
+		if(light.direction.w > 0.0)
+		{
+			float cosAngle = dot(-l, normalize(light.direction.xyz));
+			attenuation *= smoothstep(light.direction.w, light.direction.w + 0.05, cosAngle);
+		}
+	}
+	if(attenuation <= 0.0)
+		return vec3(0.0);
+	vec3 h = normalize(v + l);
+	float nDotL = max(dot(n, l), 0.0);
+	float nDotV = max(dot(n, v), 0.0001);
+	float nDotH = max(dot(n, h), 0.0);
+	vec3 radiance = light.color.rgb * light.color.w * attenuation;
+
+	float ndf = distribution_ggx(nDotH, roughness);
+	float g = geometry_schlick_ggx(nDotV, roughness) * geometry_schlick_ggx(nDotL, roughness);
+	vec3 f = fresnel_schlick(max(dot(h, v), 0.0), f0);
+	vec3 specular = (ndf * g * f) / (4.0 * nDotV * nDotL + 0.0001);
+	vec3 kd = (vec3(1.0) - f) * (1.0 - metalness);
+	vec3 result = (kd * albedo / PI + specular) * nDotL;
+
+	if(has_flag(FLAG_SHEEN))
+	{
+		float sheenD = distribution_charlie(nDotH, u_material.sheen.w);
+		float sheenV = visibility_ashikhmin(nDotV, nDotL);
+		result += u_material.sheen.rgb * sheenD * sheenV * nDotL;
+	}
+	if(has_flag(FLAG_CLEARCOAT))
+	{
+		float coatD = distribution_ggx(nDotH, u_material.clearcoat.y);
+		vec3 coatF = fresnel_schlick(max(dot(h, v), 0.0), vec3(0.04)) * u_material.clearcoat.x;
+		result = result * (1.0 - coatF) + coatD * coatF * nDotL * 0.25;
+	}
+	if(has_flag(FLAG_SUBSURFACE))
+	{
+		float wrap = u_material.subsurface.w;
+		float scatter = saturate((dot(n, l) + wrap) / ((1.0 + wrap) * (1.0 + wrap)));
+		float backLight = pow(saturate(dot(v, -l)), 4.0);
+		result += u_material.subsurface.rgb * albedo * (scatter + backLight) * 0.5;
+	}
+	float shadow = 1.0;
+	if(index < 4)
+		shadow = sample_shadow_pcf(light.shadowMatrix, worldPosition, max(0.005 * (1.0 - nDotL), 0.0005));
+	return result * radiance * shadow;
+}
+
+vec3 evaluate_ibl(vec3 n, vec3 v, vec3 albedo, float roughness, float metalness, vec3 f0, float ao)
+{
+	float nDotV = max(dot(n, v), 0.0);
+	vec3 f = fresnel_schlick_roughness(nDotV, f0, roughness);
+	vec3 kd = (1.0 - f) * (1.0 - metalness);
+	vec3 irradiance = texture(u_irradianceMap, n).rgb;
+	vec3 diffuse = irradiance * albedo;
+	vec3 r = reflect(-v, n);
+	vec3 prefiltered = textureLod(u_prefilterMap, r, roughness * 6.0).rgb;
+	vec2 brdf = texture(u_brdfLut, vec2(nDotV, roughness)).rg;
+	vec3 specular = prefiltered * (f * brdf.x + brdf.y);
+	return (kd * diffuse + specular) * ao;
+}
+
+void main()
+{
+	vec3 v = normalize(u_camera.position.xyz - vs_worldPosition);
+	mat3 tbn = mat3(normalize(vs_tangent), normalize(vs_bitangent), normalize(vs_normal));
+	vec2 uv = vs_uv;
+	if(has_flag(FLAG_PARALLAX))
+		uv = parallax_occlusion(uv, normalize(transpose(tbn) * v));
+
+	vec4 albedo = texture(u_albedoMap, uv);
+	if(has_flag(FLAG_ALPHA_TEST) && albedo.a < 0.5)
+		discard;
+	vec3 rma = texture(u_rmaMap, uv).rgb;
+	float roughness = rma.r;
+	float metalness = rma.g;
+	float ao = rma.b;
+
+	vec3 n = normalize(vs_normal);
+	if(has_flag(FLAG_NORMAL_MAP))
+	{
+		vec3 tangentNormal = texture(u_normalMap, uv).xyz * 2.0 - 1.0;
+		if(has_flag(FLAG_DETAIL))
+		{
+			vec3 detailNormal = texture(u_detailMap, uv * 8.0).xyz * 2.0 - 1.0;
+			tangentNormal = normalize(vec3(tangentNormal.xy + detailNormal.xy, tangentNormal.z * detailNormal.z));
+		}
+		n = normalize(tbn * tangentNormal);
+	}
+	if(has_flag(FLAG_LAYERS))
+		albedo = apply_layers(uv, n, albedo, roughness, metalness);
+	if(has_flag(FLAG_DECALS))
+		albedo = apply_decals(vs_worldPosition, albedo, n);
+	roughness = clamp(roughness, 0.04, 1.0);
+
+	vec3 f0 = mix(vec3(0.04), albedo.rgb, metalness);
+	vec3 lo = vec3(0.0);
+	for(int i = 0; i < u_lights.lightCount; ++i)
+		lo += evaluate_light(u_lights.lights[i], vs_worldPosition, n, v, albedo.rgb, roughness, metalness, f0, i);
+
+	vec3 ambient = has_flag(FLAG_IBL) ? evaluate_ibl(n, v, albedo.rgb, roughness, metalness, f0, ao) : albedo.rgb * 0.03 * ao;
+	vec3 color = ambient + lo;
+	if(has_flag(FLAG_EMISSION))
+		color += texture(u_emissionMap, uv).rgb * u_material.emission.rgb * u_material.emission.w;
+	if(has_flag(FLAG_FOG))
+	{
+		float dist = length(u_camera.position.xyz - vs_worldPosition);
+		float fog = 1.0 - exp(-pow(dist * u_lights.fogDensity, 2.0));
+		color = mix(color, u_lights.fogColor.rgb, saturate(fog));
+	}
+	color *= u_lights.exposure;
+	color = color / (color + vec3(1.0));
+	color = pow(color, vec3(1.0 / 2.2));
+	fs_color = vec4(color, albedo.a);
+	fs_normal = vec4(n * 0.5 + 0.5, roughness);
+}
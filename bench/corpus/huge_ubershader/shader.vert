@@ -0,0 +1,37 @@
+#version 450
+
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec3 in_normal;
+layout(location = 2) in vec4 in_tangent;
+layout(location = 3) in vec2 in_uv;
+
+layout(set = 0, binding = 0) uniform Camera {
+	mat4 view;
+	mat4 projection;
+	vec4 position;
+} u_camera;
+
+layout(set = 1, binding = 0) uniform Instance {
+	mat4 model;
+	mat4 normalMatrix;
+} u_instance;
+
+layout(location = 0) out vec3 vs_worldPosition;
+layout(location = 1) out vec3 vs_normal;
+layout(location = 2) out vec3 vs_tangent;
+layout(location = 3) out vec3 vs_bitangent;
+layout(location = 4) out vec2 vs_uv;
+
+void main()
+{
+	vec4 worldPosition = u_instance.model * vec4(in_position, 1.0);
+	vec3 n = normalize(mat3(u_instance.normalMatrix) * in_normal);
+	vec3 t = normalize(mat3(u_instance.normalMatrix) * in_tangent.xyz);
+	t = normalize(t - dot(t, n) * n);
+	vs_worldPosition = worldPosition.xyz;
+	vs_normal = n;
+	vs_tangent = t;
+	vs_bitangent = cross(n, t) * in_tangent.w;
+	vs_uv = in_uv;
+	gl_Position = u_camera.projection * u_camera.view * worldPosition;
+}
@@ -0,0 +1,127 @@
+#version 450
+
+#define MAX_LIGHTS 4
+#define PI 3.14159265359
+
+struct Light {
+	vec4 position; // w = 0 for directional lights
+	vec4 color; // w = intensity
+	vec4 direction; // w = cosine of the outer cone angle
+	mat4 shadowMatrix;
+};
+
+layout(location = 0) in vec3 vs_worldPosition;
+layout(location = 1) in vec3 vs_normal;
+layout(location = 2) in vec3 vs_tangent;
+layout(location = 3) in vec3 vs_bitangent;
+layout(location = 4) in vec2 vs_uv;
+
+layout(set = 0, binding = 0) uniform Camera {
+	mat4 view;
+	mat4 projection;
+	vec4 position;
+} u_camera;
+
+layout(set = 2, binding = 0) uniform Lights {
+	Light lights[MAX_LIGHTS];
+	int lightCount;
+	float exposure;
+} u_lights;
+
+layout(set = 3, binding = 0) uniform sampler2D u_albedoMap;
+layout(set = 3, binding = 1) uniform sampler2D u_normalMap;
+layout(set = 3, binding = 2) uniform sampler2D u_rmaMap;
+layout(set = 3, binding = 3) uniform samplerCube u_irradianceMap;
+layout(set = 3, binding = 4) uniform sampler2DShadow u_shadowMap;
+
+layout(location = 0) out vec4 fs_color;
+
+float distribution_ggx(vec3 n, vec3 h, float roughness)
+{
+	float a = roughness * roughness;
+	float a2 = a * a;
+	float nDotH = max(dot(n, h), 0.0);
+	float denom = nDotH * nDotH * (a2 - 1.0) + 1.0;
+	return a2 / (PI * denom * denom);
+}
+
+float geometry_schlick_ggx(float nDotV, float roughness)
+{
+	float r = roughness + 1.0;
+	float k = (r * r) / 8.0;
+	return nDotV / (nDotV * (1.0 - k) + k);
+}
+
+float geometry_smith(vec3 n, vec3 v, vec3 l, float roughness)
+{
+	return geometry_schlick_ggx(max(dot(n, v), 0.0), roughness) * geometry_schlick_ggx(max(dot(n, l), 0.0), roughness);
+}
+
+vec3 fresnel_schlick(float cosTheta, vec3 f0)
+{
+	return f0 + (1.0 - f0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
+}
+
+float sample_shadow(mat4 shadowMatrix, vec3 worldPosition)
+{
+	vec4 shadowCoord = shadowMatrix * vec4(worldPosition, 1.0);
+	shadowCoord.xyz /= shadowCoord.w;
+	float shadow = 0.0;
+	for(int x = -1; x <= 1; ++x)
+	{
+		for(int y = -1; y <= 1; ++y)
+			shadow += texture(u_shadowMap, vec3(shadowCoord.xy + vec2(x, y) / 2048.0, shadowCoord.z));
+	}
+	return shadow / 9.0;
+}
+
+void main()
+{
+	vec4 albedo = texture(u_albedoMap, vs_uv);
+	vec3 rma = texture(u_rmaMap, vs_uv).rgb;
+	float roughness = rma.r;
+	float metalness = rma.g;
+	float ao = rma.b;
+
+	vec3 tangentNormal = texture(u_normalMap, vs_uv).xyz * 2.0 - 1.0;
+	mat3 tbn = mat3(normalize(vs_tangent), normalize(vs_bitangent), normalize(vs_normal));
+	vec3 n = normalize(tbn * tangentNormal);
+	vec3 v = normalize(u_camera.position.xyz - vs_worldPosition);
+	vec3 f0 = mix(vec3(0.04), albedo.rgb, metalness);
+
+	vec3 lo = vec3(0.0);
+	for(int i = 0; i < u_lights.lightCount; ++i)
+	{
+		Light light = u_lights.lights[i];
+		vec3 l;
+		float attenuation = 1.0;
+		if(light.position.w == 0.0)
+			l = normalize(-light.direction.xyz);
+		else
+		{
+			vec3 toLight = light.position.xyz - vs_worldPosition;
+			float dist = length(toLight);
+			l = toLight / dist;
+			attenuation = 1.0 / (dist * dist);
+			float cosAngle = dot(-l, normalize(light.direction.xyz));
+			attenuation *= smoothstep(light.direction.w, light.direction.w + 0.05, cosAngle);
+		}
+		vec3 h = normalize(v + l);
+		vec3 radiance = light.color.rgb * light.color.w * attenuation;
+
+		float ndf = distribution_ggx(n, h, roughness);
+		float g = geometry_smith(n, v, l, roughness);
+		vec3 f = fresnel_schlick(max(dot(h, v), 0.0), f0);
+		vec3 specular = (ndf * g * f) / (4.0 * max(dot(n, v), 0.0) * max(dot(n, l), 0.0) + 0.0001);
+		vec3 kd = (vec3(1.0) - f) * (1.0 - metalness);
+		float nDotL = max(dot(n, l), 0.0);
+		float shadow = (i == 0) ? sample_shadow(light.shadowMatrix, vs_worldPosition) : 1.0;
+		lo += (kd * albedo.rgb / PI + specular) * radiance * nDotL * shadow;
+	}
+
+	vec3 ambient = texture(u_irradianceMap, n).rgb * albedo.rgb * ao;
+	vec3 color = (ambient + lo) * u_lights.exposure;
+	color = color / (color + vec3(1.0));
+	color = pow(color, vec3(1.0 / 2.2));
+	fs_color = vec4(color, albedo.a);
+}
@@ -0,0 +1,15 @@
+#version 450
+
+layout(location = 0) in vec2 vs_uv;
+
+layout(set = 0, binding = 1) uniform sampler2D u_albedo;
+
+layout(location = 0) out vec4 fs_color;
+
+void main()
+{
+	vec4 color = texture(u_albedo, vs_uv);
+	if(color.a < 0.5)
+		discard;
+	fs_color = color;
+}
@@ -0,0 +1,16 @@
+#version 450
+
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec2 in_uv;
+
+layout(set = 0, binding = 0) uniform Instance {
+	mat4 modelViewProjection;
+} u_instance;
+
+layout(location = 0) out vec2 vs_uv;
+
+void main()
+{
+	vs_uv = in_uv;
+	gl_Position = u_instance.modelViewProjection * vec4(in_position, 1.0);
+}
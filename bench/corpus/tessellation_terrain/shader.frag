@@ -0,0 +1,25 @@
+#version 450
+
+layout(location = 0) in vec2 tes_uv;
+layout(location = 1) in vec3 tes_normal;
+layout(location = 2) in vec3 tes_worldPosition;
+
+layout(set = 0, binding = 2) uniform sampler2D u_grass;
+layout(set = 0, binding = 3) uniform sampler2D u_rock;
+layout(set = 0, binding = 4) uniform sampler2D u_snow;
+
+layout(location = 0) out vec4 fs_color;
+
+void main()
+{
+	vec3 n = normalize(tes_normal);
+	float slope = 1.0 - n.y;
+	float height = tes_worldPosition.y;
+	vec3 grass = texture(u_grass, tes_uv * 64.0).rgb;
+	vec3 rock = texture(u_rock, tes_uv * 32.0).rgb;
+	vec3 snow = texture(u_snow, tes_uv * 48.0).rgb;
+	vec3 color = mix(grass, rock, smoothstep(0.2, 0.5, slope));
+	color = mix(color, snow, smoothstep(40.0, 60.0, height) * (1.0 - smoothstep(0.4, 0.7, slope)));
+	float diffuse = max(dot(n, normalize(vec3(0.3, 1.0, 0.2))), 0.0);
+	fs_color = vec4(color * (0.2 + 0.8 * diffuse), 1.0);
+}
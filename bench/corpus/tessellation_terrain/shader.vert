@@ -0,0 +1,11 @@
+#version 450
+
+layout(location = 0) in vec2 in_position;
+
+layout(location = 0) out vec2 vs_uv;
+
+void main()
+{
+	vs_uv = in_position * 0.5 + 0.5;
+	gl_Position = vec4(in_position.x, 0.0, in_position.y, 1.0);
+}
@@ -0,0 +1,348 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#include "json_writer.hpp"
+#include "GlslTargetUtil.h"
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <array>
+#include <map>
+
+using namespace lunarglass::bench;
+
+namespace
+{
+	struct MicroConfig
+	{
+		std::string jsonPath; // stdout if empty
+		std::string filter;
+		std::chrono::milliseconds minTime {200};
+		uint32_t repetitions = 5;
+	};
+
+	struct MicroBenchmark
+	{
+		std::string name;
+		// Number of helper calls a single invocation of 'run' makes
+		size_t opsPerRun = 0;
+		std::function<void()> run;
+	};
+
+	struct MicroResult
+	{
+		std::string name;
+		uint64_t ops = 0;
+		double nsPerOp = 0.0; // Median of all repetitions
+		double minNsPerOp = 0.0;
+	};
+
+	// Results are folded into this, so that the compiler can't drop the calls
+	volatile size_t g_sink = 0;
+
+	// Fake llvm::Value addresses; They are only ever used as map keys. Spaced like heap objects
+	// of the size of an llvm::Instruction, so that the key distribution is realistic.
+	std::vector<const llvm::Value*> make_value_keys(size_t count)
+	{
+		std::vector<const llvm::Value*> keys {};
+		keys.reserve(count);
+		uintptr_t address = 0x10000;
+		for(auto i=decltype(count){0u};i<count;++i)
+		{
+			keys.push_back(reinterpret_cast<const llvm::Value*>(address));
+			address += 64 +(i %3) *16;
+		}
+		// Values are mapped in instruction order, which isn't address order
+		std::reverse(keys.begin() +keys.size() /2,keys.end());
+		return keys;
+	}
+
+	// Inputs are modeled on what the back end sees for typical fragment shaders
+	const std::vector<std::string> &get_expressions()
+	{
+		static const std::vector<std::string> expressions {
+			"a","Lg_1f","H_3kf9a1","color.xyz","uv.yx","lights[3].position.xyz","-normal.y","(H_2mq01 * 0.5)",
+			"texture(albedoMap, uv)","gl_FragCoord.xy","material.roughness","Lg_2a[i]","(a + b)","C_1v6qz.x",
+			"normalize(viewDir)","max(dot(N, L), 0.0)","shadowCoords[2].w","vec3(1.0, 0.0, 0.0)","-(H_1a2b3c)","weights[7]"
+		};
+		return expressions;
+	}
+	const std::vector<std::string> &get_llvm_names()
+	{
+		static const std::vector<std::string> names {
+			"color","color.i","color.i.i12","tmp42","lightDir","N.i5","viewDir.i","uv","uv1","albedo.i.i.i",
+			"diffuse.i87","spec","specular.i.i3","attenuation","shadow.i","roughness23","metallic","ao.i.i",
+			"tangent.0","bitangent.1","normal.lcssa","phi.i.i.i","cond.i","loop.i12","_L","i.01"
+		};
+		return names;
+	}
+	const std::vector<std::string> &get_hash_keys()
+	{
+		static const std::vector<std::string> keys {
+			"texture(albedoMap, uv)","max(dot(N, L), 0.0)","(H_2mq01 * 0.5)","normalize((lightPos - worldPos))",
+			"vec3(1.0, 0.0, 0.0)","mix(H_1a, H_2b, 0.25)","pow(clamp(H_9x, 0.0, 1.0), 2.2)","(Lg_1f + Lg_2a)",
+			"(uv * vec2(0.5, 0.5))","texture(normalMap, (uv + offset)).xyz","float[4](0.0, 0.25, 0.5, 0.75)",
+			"lights[3].color.xyz","(((H_a1 * H_b2) + H_c3) * H_d4)","inversesqrt(dot(v, v))"
+		};
+		return keys;
+	}
+	const std::vector<float> &get_floats()
+	{
+		static const std::vector<float> floats {0.0f,1.0f,0.5f,2.0f,-1.0f,3.14159265f,0.0031308f,2.2f,1e-5f,-0.25f,255.0f,0.04f,1.0f /3.0f,16.0f,0.95f};
+		return floats;
+	}
+
+	std::vector<MicroBenchmark> get_benchmarks()
+	{
+		std::vector<MicroBenchmark> benchmarks {};
+		benchmarks.push_back({"cheap_expression",get_expressions().size(),[]() {
+			size_t n = 0;
+			for(auto &expression : get_expressions())
+				n += gla::CheapExpression(expression);
+			g_sink = g_sink +n;
+		}});
+		benchmarks.push_back({"make_parseable",get_llvm_names().size(),[]() {
+			size_t n = 0;
+			std::string name;
+			for(auto &llvmName : get_llvm_names())
+			{
+				name = llvmName;
+				gla::MakeParseable(name);
+				n += name.size();
+			}
+			g_sink = g_sink +n;
+		}});
+		// Every run starts a new shader, i.e. an empty name map
+		benchmarks.push_back({"canonicalize_name",get_llvm_names().size() *8,[]() {
+			std::map<std::string,int> canonMap {};
+			size_t n = 0;
+			for(auto i=0u;i<8;++i)
+			{
+				for(auto &llvmName : get_llvm_names())
+				{
+					std::string name = llvmName;
+					gla::CanonicalizeName(name,canonMap);
+					n += name.size();
+				}
+			}
+			g_sink = g_sink +n;
+		}});
+		benchmarks.push_back({"make_hash_name",get_hash_keys().size() *8,[]() {
+			gla::HashedNameMap hashedNames {};
+			size_t n = 0;
+			for(auto i=0u;i<8;++i)
+			{
+				for(auto &key : get_hash_keys())
+				{
+					std::string name;
+					gla::MakeHashName("H_",key.c_str(),name,hashedNames);
+					n += name.size();
+				}
+			}
+			g_sink = g_sink +n;
+		}});
+		benchmarks.push_back({"emit_float_constant",get_floats().size(),[]() {
+			gla::TextBuffer out;
+			for(auto f : get_floats())
+			{
+				gla::EmitFloatConstant(out,f,true);
+				out<<", ";
+			}
+			g_sink = g_sink +out.str().size();
+		}});
+
+		constexpr size_t valueCount = 2048;
+		static const auto keys = make_value_keys(valueCount);
+		benchmarks.push_back({"map_expression_string",valueCount,[]() {
+			gla::ValueStringMap valueMap {};
+			auto &expressions = get_expressions();
+			for(auto i=decltype(keys.size()){0u};i<keys.size();++i)
+				gla::MapExpressionString(valueMap,keys[i],expressions[i %expressions.size()]);
+			g_sink = g_sink +valueMap.size();
+		}});
+		// Lookups vastly outnumber insertions; Every value is looked up once per use
+		static gla::ValueStringMap lookupMap {};
+		if(lookupMap.size() == 0)
+		{
+			auto &expressions = get_expressions();
+			for(auto i=decltype(keys.size()){0u};i<keys.size();++i)
+				gla::MapExpressionString(lookupMap,keys[i],expressions[i %expressions.size()]);
+		}
+		benchmarks.push_back({"find_expression_string",valueCount *2,[]() {
+			size_t n = 0;
+			std::string name;
+			for(auto i=0u;i<2;++i)
+			{
+				for(auto *key : keys)
+				{
+					if(gla::FindExpressionString(lookupMap,key,name))
+						n += name.size();
+				}
+			}
+			g_sink = g_sink +n;
+		}});
+		return benchmarks;
+	}
+
+	MicroResult run_benchmark(const MicroBenchmark &benchmark,const MicroConfig &config)
+	{
+		MicroResult result {};
+		result.name = benchmark.name;
+		benchmark.run(); // Warm up caches and lazily initialized inputs
+		std::vector<double> nsPerOp {};
+		for(auto r=decltype(config.repetitions){0u};r<config.repetitions;++r)
+		{
+			uint64_t runs = 0;
+			auto t0 = std::chrono::steady_clock::now();
+			auto t1 = t0;
+			do
+			{
+				benchmark.run();
+				++runs;
+				t1 = std::chrono::steady_clock::now();
+			}
+			while(t1 -t0 < config.minTime);
+			auto ops = runs *benchmark.opsPerRun;
+			result.ops += ops;
+			nsPerOp.push_back(std::chrono::duration<double,std::nano>{t1 -t0}.count() /ops);
+		}
+		std::sort(nsPerOp.begin(),nsPerOp.end());
+		result.nsPerOp = nsPerOp[nsPerOp.size() /2];
+		result.minNsPerOp = nsPerOp.front();
+		return result;
+	}
+
+	void print_usage()
+	{
+		std::cerr<<"Usage: util_lunarglass_microbench [options]\n"
+			<<"Times the string helpers of the GLSL back end in isolation.\n"
+			<<"  --filter <substring>    Only run benchmarks whose name contains the substring\n"
+			<<"  --min-time <ms>         Minimum duration of every repetition (default: 200)\n"
+			<<"  --repetitions <n>       Repetitions per benchmark, the median is reported (default: 5)\n"
+			<<"  --json <file>           Write the JSON report to a file instead of stdout\n";
+	}
+
+	bool parse_args(int argc,char *argv[],MicroConfig &config)
+	{
+		for(auto i=1;i<argc;++i)
+		{
+			std::string arg = argv[i];
+			auto next = [&](std::string &out) -> bool {
+				if(i +1 >= argc)
+				{
+					std::cerr<<"Missing value for "<<arg<<"\n";
+					return false;
+				}
+				out = argv[++i];
+				return true;
+			};
+			auto nextUint = [&](uint32_t &out) -> bool {
+				std::string value;
+				if(next(value) == false)
+					return false;
+				try
+				{
+					out = static_cast<uint32_t>(std::stoul(value));
+				}
+				catch(const std::exception&)
+				{
+					std::cerr<<"Invalid value '"<<value<<"' for "<<arg<<"\n";
+					return false;
+				}
+				return true;
+			};
+			if(arg == "--filter")
+			{
+				if(next(config.filter) == false)
+					return false;
+			}
+			else if(arg == "--json")
+			{
+				if(next(config.jsonPath) == false)
+					return false;
+			}
+			else if(arg == "--min-time")
+			{
+				uint32_t ms;
+				if(nextUint(ms) == false)
+					return false;
+				config.minTime = std::chrono::milliseconds{ms};
+			}
+			else if(arg == "--repetitions")
+			{
+				if(nextUint(config.repetitions) == false)
+					return false;
+				config.repetitions = std::max(config.repetitions,1u);
+			}
+			else if(arg == "--help" || arg == "-h")
+			{
+				print_usage();
+				return false;
+			}
+			else
+			{
+				std::cerr<<"Unknown argument '"<<arg<<"'\n";
+				print_usage();
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+int main(int argc,char *argv[])
+{
+	MicroConfig config {};
+	if(parse_args(argc,argv,config) == false)
+		return 2;
+
+	std::vector<MicroResult> results {};
+	for(auto &benchmark : get_benchmarks())
+	{
+		if(config.filter.empty() == false && benchmark.name.find(config.filter) == std::string::npos)
+			continue;
+		results.push_back(run_benchmark(benchmark,config));
+		auto &result = results.back();
+		std::cerr<<result.name<<": "<<result.nsPerOp<<" ns/op (min "<<result.minNsPerOp<<")\n";
+	}
+
+	std::ofstream jsonFile {};
+	if(config.jsonPath.empty() == false)
+	{
+		jsonFile.open(config.jsonPath,std::ios::trunc);
+		if(!jsonFile)
+		{
+			std::cerr<<"Unable to open '"<<config.jsonPath<<"' for writing\n";
+			return 2;
+		}
+	}
+	JsonWriter json {config.jsonPath.empty() ? std::cout : jsonFile};
+	json.BeginObject();
+	json.Key("config");
+	json.BeginObject();
+	json.Field("min_time_ms",static_cast<uint64_t>(config.minTime.count()));
+	json.Field("repetitions",config.repetitions);
+	json.EndObject();
+	json.Key("benchmarks");
+	json.BeginArray();
+	for(auto &result : results)
+	{
+		json.BeginObject();
+		json.Field("name",result.name);
+		json.Field("ops",result.ops);
+		json.Field("ns_per_op",result.nsPerOp);
+		json.Field("min_ns_per_op",result.minNsPerOp);
+		json.EndObject();
+	}
+	json.EndArray();
+	json.EndObject();
+	return 0;
+}
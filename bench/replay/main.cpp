@@ -0,0 +1,299 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#include "json_writer.hpp"
+#include "latency.hpp"
+#include "platform.hpp"
+#include <util_lunarglass/util_lunarglass.hpp>
+#include <util_lunarglass/capture.hpp>
+#include <util_lunarglass/result_cache.hpp>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <optional>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <vector>
+
+using namespace lunarglass;
+using namespace lunarglass::bench;
+
+namespace
+{
+	struct ReplayConfig
+	{
+		std::string capturePath;
+		std::string jsonPath; // stdout if empty
+		uint32_t iterations = 1;
+		uint32_t threadCount = 1;
+		std::optional<int> substitutionLevel {};
+		bool parallelStages = false;
+		bool useCache = false;
+	};
+
+	struct Sample
+	{
+		double latencyMs = 0.0;
+		bool success = false;
+	};
+
+	void print_usage()
+	{
+		std::cerr<<"Usage: util_lunarglass_replay [options] <capture>\n"
+			<<"Re-runs every optimize_glsl call of a capture written by lunarglass::CaptureWriter.\n"
+			<<"  --iterations <n>        Number of passes over the capture (default: 1)\n"
+			<<"  --threads <n>           Replay on n threads at once, 0 = hardware threads (default: 1)\n"
+			<<"  --substitution <level>  Override the recorded Options::substitutionLevel\n"
+			<<"  --parallel-stages       Set Options::parallelStages for every call\n"
+			<<"  --cache                 Share an in-memory ResultCache between all calls\n"
+			<<"  --json <file>           Write the JSON report to a file instead of stdout\n";
+	}
+
+	bool parse_args(int argc,char *argv[],ReplayConfig &config)
+	{
+		for(auto i=1;i<argc;++i)
+		{
+			std::string arg = argv[i];
+			auto next = [&](std::string &out) -> bool {
+				if(i +1 >= argc)
+				{
+					std::cerr<<"Missing value for "<<arg<<"\n";
+					return false;
+				}
+				out = argv[++i];
+				return true;
+			};
+			auto nextUint = [&](uint32_t &out) -> bool {
+				std::string value;
+				if(next(value) == false)
+					return false;
+				try
+				{
+					out = static_cast<uint32_t>(std::stoul(value));
+				}
+				catch(const std::exception&)
+				{
+					std::cerr<<"Invalid value '"<<value<<"' for "<<arg<<"\n";
+					return false;
+				}
+				return true;
+			};
+			if(arg == "--json")
+			{
+				if(next(config.jsonPath) == false)
+					return false;
+			}
+			else if(arg == "--iterations")
+			{
+				if(nextUint(config.iterations) == false)
+					return false;
+			}
+			else if(arg == "--threads")
+			{
+				if(nextUint(config.threadCount) == false)
+					return false;
+			}
+			else if(arg == "--substitution")
+			{
+				uint32_t level;
+				if(nextUint(level) == false)
+					return false;
+				config.substitutionLevel = static_cast<int>(level);
+			}
+			else if(arg == "--parallel-stages")
+				config.parallelStages = true;
+			else if(arg == "--cache")
+				config.useCache = true;
+			else if(arg == "--help" || arg == "-h")
+			{
+				print_usage();
+				return false;
+			}
+			else if(arg.empty() == false && arg.front() != '-' && config.capturePath.empty())
+				config.capturePath = arg;
+			else
+			{
+				std::cerr<<"Unknown argument '"<<arg<<"'\n";
+				print_usage();
+				return false;
+			}
+		}
+		if(config.capturePath.empty())
+		{
+			std::cerr<<"No capture specified\n";
+			print_usage();
+			return false;
+		}
+		if(config.threadCount == 0)
+			config.threadCount = std::max(std::thread::hardware_concurrency(),1u);
+		return true;
+	}
+};
+
+int main(int argc,char *argv[])
+{
+	ReplayConfig config {};
+	if(parse_args(argc,argv,config) == false)
+		return 2;
+
+	std::string err;
+	auto reader = CaptureReader::Open(config.capturePath,err);
+	if(!reader)
+	{
+		std::cerr<<err<<"\n";
+		return 2;
+	}
+	std::vector<CaptureRecord> records {};
+	for(;;)
+	{
+		CaptureRecord record {};
+		if(reader->ReadNext(record,err) == false)
+			break;
+		records.push_back(std::move(record));
+	}
+	// A truncated last record is expected if the recording process was killed, so keep what was read
+	if(err.empty() == false)
+		std::cerr<<"Warning: "<<err<<", replaying the "<<records.size()<<" records before it\n";
+	if(records.empty())
+	{
+		std::cerr<<"Capture '"<<config.capturePath<<"' contains no records\n";
+		return 2;
+	}
+
+	std::unique_ptr<ResultCache> cache = config.useCache ? std::make_unique<ResultCache>() : nullptr;
+	for(auto &record : records)
+	{
+		if(config.substitutionLevel.has_value())
+			record.options.substitutionLevel = *config.substitutionLevel;
+		if(config.parallelStages)
+			record.options.parallelStages = true;
+		record.options.cache = cache.get();
+	}
+
+	// Replays the records in their recorded order, spread across all threads
+	auto taskCount = records.size() *config.iterations;
+	std::vector<Sample> samples {};
+	samples.resize(taskCount);
+	std::atomic<size_t> nextTask = 0;
+	auto worker = [&]() {
+		for(;;)
+		{
+			auto task = nextTask++;
+			if(task >= taskCount)
+				break;
+			auto &record = records[task %records.size()];
+			std::string infoLog;
+			std::optional<std::unordered_map<ShaderStage,std::string>> shaders;
+			auto t0 = std::chrono::steady_clock::now();
+			try
+			{
+				shaders = optimize_glsl(record.shaders,record.options,infoLog);
+			}
+			catch(const std::exception&)
+			{}
+			auto t1 = std::chrono::steady_clock::now();
+			auto &sample = samples[task];
+			sample.latencyMs = std::chrono::duration<double,std::milli>{t1 -t0}.count();
+			sample.success = shaders.has_value();
+		}
+	};
+	auto t0 = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for(auto i=decltype(config.threadCount){1u};i<config.threadCount;++i)
+		threads.emplace_back(worker);
+	worker();
+	for(auto &t : threads)
+		t.join();
+	auto t1 = std::chrono::steady_clock::now();
+	auto wallSeconds = std::chrono::duration<double>{t1 -t0}.count();
+
+	uint64_t compiledPrograms = 0;
+	uint64_t failures = 0;
+	std::vector<double> latencies {};
+	latencies.reserve(samples.size());
+	for(auto &sample : samples)
+	{
+		latencies.push_back(sample.latencyMs);
+		if(sample.success)
+			++compiledPrograms;
+		else
+			++failures;
+	}
+	uint64_t sourceBytes = 0;
+	auto firstTimestamp = records.front().timestamp;
+	auto lastTimestamp = records.front().timestamp;
+	for(auto &record : records)
+	{
+		for(auto &pair : record.shaders)
+			sourceBytes += pair.second.size();
+		firstTimestamp = std::min(firstTimestamp,record.timestamp);
+		lastTimestamp = std::max(lastTimestamp,record.timestamp);
+	}
+
+	std::ofstream jsonFile {};
+	if(config.jsonPath.empty() == false)
+	{
+		jsonFile.open(config.jsonPath,std::ios::trunc);
+		if(!jsonFile)
+		{
+			std::cerr<<"Unable to open '"<<config.jsonPath<<"' for writing\n";
+			return 2;
+		}
+	}
+	JsonWriter json {config.jsonPath.empty() ? std::cout : jsonFile};
+	json.BeginObject();
+	json.Key("config");
+	json.BeginObject();
+	json.Field("capture",config.capturePath);
+	json.Field("iterations",config.iterations);
+	json.Field("threads",config.threadCount);
+	if(config.substitutionLevel.has_value())
+		json.Field("substitution_level",*config.substitutionLevel);
+	json.Field("parallel_stages",config.parallelStages);
+	json.Field("cache",config.useCache);
+	json.Field("hardware_threads",std::thread::hardware_concurrency());
+	json.EndObject();
+
+	json.Key("capture");
+	json.BeginObject();
+	json.Field("records",static_cast<uint64_t>(records.size()));
+	json.Field("source_bytes",sourceBytes);
+	// Time between the first and the last recorded call
+	json.Field("recorded_seconds",(lastTimestamp -firstTimestamp) /1'000'000'000.0);
+	json.EndObject();
+
+	json.Key("summary");
+	json.BeginObject();
+	json.Field("wall_seconds",wallSeconds);
+	json.Field("programs_compiled",compiledPrograms);
+	json.Field("failures",failures);
+	json.Field("programs_per_second",compiledPrograms /wallSeconds);
+	json.Key("latency_ms");
+	auto overall = summarize(latencies);
+	write_latency(json,overall);
+	json.Field("peak_rss_bytes",get_peak_rss());
+	json.EndObject();
+
+	if(cache)
+	{
+		auto statistics = cache->GetStatistics();
+		json.Key("cache");
+		json.BeginObject();
+		json.Field("hits",statistics.memoryHits);
+		json.Field("misses",statistics.misses);
+		json.Field("memory_bytes",static_cast<uint64_t>(statistics.memoryBytes));
+		json.EndObject();
+	}
+	json.EndObject();
+
+	// Recorded traffic may contain programs that failed to compile in the first place, so failures are reported but not fatal
+	std::cerr<<compiledPrograms<<" programs in "<<wallSeconds<<"s: "<<(compiledPrograms /wallSeconds)<<" programs/s, p50 "
+		<<overall.p50<<"ms, p99 "<<overall.p99<<"ms, "<<failures<<" failures\n";
+	return 0;
+}
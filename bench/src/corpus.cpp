@@ -0,0 +1,74 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#include "corpus.hpp"
+#include <filesystem>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+std::optional<lunarglass::ShaderStage> lunarglass::bench::get_stage_from_extension(const std::string &ext)
+{
+	if(ext == ".vert")
+		return ShaderStage::Vertex;
+	if(ext == ".tesc")
+		return ShaderStage::TessellationControl;
+	if(ext == ".tese")
+		return ShaderStage::TessellationEvaluation;
+	if(ext == ".geom")
+		return ShaderStage::Geometry;
+	if(ext == ".frag")
+		return ShaderStage::Fragment;
+	if(ext == ".comp")
+		return ShaderStage::Compute;
+	return {};
+}
+
+std::optional<std::vector<lunarglass::bench::CorpusProgram>> lunarglass::bench::load_corpus(const std::string &directory,const std::string &filter,std::string &outErr)
+{
+	std::error_code ec;
+	std::filesystem::directory_iterator it {directory,ec};
+	if(ec)
+	{
+		outErr = "Unable to open corpus directory '" +directory +"': " +ec.message();
+		return {};
+	}
+	std::vector<CorpusProgram> programs {};
+	for(auto &programDir : it)
+	{
+		if(programDir.is_directory() == false)
+			continue;
+		CorpusProgram program {};
+		program.name = programDir.path().filename().string();
+		if(filter.empty() == false && program.name.find(filter) == std::string::npos)
+			continue;
+		for(auto &file : std::filesystem::directory_iterator{programDir.path()})
+		{
+			auto stage = get_stage_from_extension(file.path().extension().string());
+			if(stage.has_value() == false)
+				continue;
+			if(program.shaders.find(*stage) != program.shaders.end())
+			{
+				outErr = "Program '" +program.name +"' has more than one " +get_shader_stage_name(*stage) +" shader";
+				return {};
+			}
+			std::ifstream f {file.path(),std::ios::binary};
+			if(!f)
+			{
+				outErr = "Unable to read '" +file.path().string() +"'";
+				return {};
+			}
+			auto &source = program.shaders[*stage] = std::string{std::istreambuf_iterator<char>{f},std::istreambuf_iterator<char>{}};
+			program.inputBytes += source.size();
+		}
+		if(program.shaders.empty())
+			continue;
+		programs.push_back(std::move(program));
+	}
+	std::sort(programs.begin(),programs.end(),[](const CorpusProgram &a,const CorpusProgram &b) {return a.name < b.name;});
+	return programs;
+}
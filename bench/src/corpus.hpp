@@ -0,0 +1,32 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#ifndef __UTIL_LUNARGLASS_BENCH_CORPUS_HPP__
+#define __UTIL_LUNARGLASS_BENCH_CORPUS_HPP__
+
+#include <util_lunarglass/util_lunarglass.hpp>
+#include <unordered_map>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace lunarglass::bench
+{
+	struct CorpusProgram
+	{
+		std::string name;
+		std::unordered_map<ShaderStage,std::string> shaders;
+		size_t inputBytes = 0;
+	};
+	// Every sub-directory of 'directory' is one program, its stages are identified by the file
+	// extension (.vert, .tesc, .tese, .geom, .frag, .comp). Programs are sorted by name.
+	std::optional<std::vector<CorpusProgram>> load_corpus(const std::string &directory,const std::string &filter,std::string &outErr);
+
+	std::optional<ShaderStage> get_stage_from_extension(const std::string &ext);
+};
+
+#endif
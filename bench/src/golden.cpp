@@ -0,0 +1,179 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#include "golden.hpp"
+#include <filesystem>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <iomanip>
+#include <limits>
+
+namespace
+{
+	constexpr const char *METRICS_FILE_NAME = "metrics.txt";
+	constexpr const char *OUTPUT_EXTENSION = ".glsl";
+
+	bool write_file(const std::filesystem::path &path,const std::string &contents,std::string &outErr)
+	{
+		// Binary, so that line endings are stored exactly as they were generated
+		std::ofstream f {path,std::ios::binary | std::ios::trunc};
+		if(!f || !f.write(contents.data(),contents.size()))
+		{
+			outErr = "Unable to write '" +path.string() +"'";
+			return false;
+		}
+		return true;
+	}
+
+	std::optional<std::string> read_file(const std::filesystem::path &path)
+	{
+		std::ifstream f {path,std::ios::binary};
+		if(!f)
+			return {};
+		return std::string{std::istreambuf_iterator<char>{f},std::istreambuf_iterator<char>{}};
+	}
+
+	std::optional<lunarglass::ShaderStage> get_stage_from_name(const std::string &name)
+	{
+		for(auto s=0u;s<static_cast<uint32_t>(lunarglass::ShaderStage::Count);++s)
+		{
+			if(name == lunarglass::get_shader_stage_name(static_cast<lunarglass::ShaderStage>(s)))
+				return static_cast<lunarglass::ShaderStage>(s);
+		}
+		return {};
+	}
+
+	// Line and column of the first byte that differs, so that the report points at the change
+	std::string describe_difference(const std::string &baseline,const std::string &current)
+	{
+		auto it = std::mismatch(baseline.begin(),baseline.end(),current.begin(),current.end());
+		auto offset = static_cast<size_t>(it.first -baseline.begin());
+		auto line = std::count(baseline.begin(),it.first,'\n') +1;
+		auto lineStart = baseline.rfind('\n',(offset > 0) ? offset -1 : 0);
+		auto column = (lineStart == std::string::npos || offset == 0) ? offset +1 : offset -lineStart;
+		std::stringstream ss;
+		ss<<"differs at line "<<line<<", column "<<column<<" ("<<baseline.size()<<" -> "<<current.size()<<" bytes)";
+		return ss.str();
+	}
+};
+
+bool lunarglass::bench::write_golden(const std::string &directory,const std::string &programName,const GoldenProgram &program,std::string &outErr)
+{
+	auto programDir = std::filesystem::path{directory} /programName;
+	std::error_code ec;
+	std::filesystem::create_directories(programDir,ec);
+	if(ec)
+	{
+		outErr = "Unable to create '" +programDir.string() +"': " +ec.message();
+		return false;
+	}
+	// Remove the output of stages the program no longer has
+	for(auto &file : std::filesystem::directory_iterator{programDir,ec})
+	{
+		if(file.path().extension() == OUTPUT_EXTENSION)
+			std::filesystem::remove(file.path(),ec);
+	}
+	for(auto &pair : program.output)
+	{
+		if(write_file(programDir /(std::string{get_shader_stage_name(pair.first)} +OUTPUT_EXTENSION),pair.second,outErr) == false)
+			return false;
+	}
+	std::stringstream metrics;
+	metrics<<std::setprecision(std::numeric_limits<double>::max_digits10);
+	for(auto &pair : program.metrics)
+		metrics<<pair.first<<" "<<pair.second<<"\n";
+	return write_file(programDir /METRICS_FILE_NAME,metrics.str(),outErr);
+}
+
+std::optional<lunarglass::bench::GoldenProgram> lunarglass::bench::load_golden(const std::string &directory,const std::string &programName,std::string &outErr)
+{
+	auto programDir = std::filesystem::path{directory} /programName;
+	auto metrics = read_file(programDir /METRICS_FILE_NAME);
+	if(metrics.has_value() == false)
+	{
+		outErr = "No baseline for '" +programName +"' in '" +directory +"'";
+		return {};
+	}
+	GoldenProgram program {};
+	std::stringstream ss {*metrics};
+	std::string line;
+	while(std::getline(ss,line))
+	{
+		if(line.empty())
+			continue;
+		std::stringstream lineStream {line};
+		std::string name;
+		double value;
+		if(!(lineStream>>name>>value))
+		{
+			outErr = "Malformed line '" +line +"' in '" +(programDir /METRICS_FILE_NAME).string() +"'";
+			return {};
+		}
+		program.metrics[name] = value;
+	}
+
+	std::error_code ec;
+	for(auto &file : std::filesystem::directory_iterator{programDir,ec})
+	{
+		if(file.path().extension() != OUTPUT_EXTENSION)
+			continue;
+		auto stage = get_stage_from_name(file.path().stem().string());
+		auto output = stage.has_value() ? read_file(file.path()) : std::optional<std::string>{};
+		if(output.has_value() == false)
+		{
+			outErr = "Unable to read '" +file.path().string() +"'";
+			return {};
+		}
+		program.output[*stage] = std::move(*output);
+	}
+	return program;
+}
+
+std::vector<std::string> lunarglass::bench::compare_golden(const GoldenProgram &baseline,const GoldenProgram &current,const GoldenThresholds &thresholds,std::vector<std::string> &outAdvisories)
+{
+	std::vector<std::string> regressions {};
+	for(auto s=0u;s<static_cast<uint32_t>(ShaderStage::Count);++s)
+	{
+		auto stage = static_cast<ShaderStage>(s);
+		auto itBaseline = baseline.output.find(stage);
+		auto itCurrent = current.output.find(stage);
+		std::string stageName = get_shader_stage_name(stage);
+		if(itBaseline == baseline.output.end() && itCurrent == current.output.end())
+			continue;
+		if(itBaseline == baseline.output.end())
+			regressions.push_back(stageName +" output is not part of the baseline");
+		else if(itCurrent == current.output.end())
+			regressions.push_back(stageName +" output is missing");
+		else if(itBaseline->second != itCurrent->second)
+			regressions.push_back(stageName +" output " +describe_difference(itBaseline->second,itCurrent->second));
+	}
+
+	for(auto &pair : baseline.metrics)
+	{
+		auto it = current.metrics.find(pair.first);
+		if(it == current.metrics.end())
+		{
+			regressions.push_back(pair.first +" is missing");
+			continue;
+		}
+		auto isTime = (pair.first.compare(0,5,"time.") == 0);
+		auto limit = pair.second *(1.0 +(isTime ? thresholds.time : thresholds.cost));
+		if(it->second <= limit)
+			continue;
+		std::stringstream ss;
+		ss<<pair.first<<" regressed from "<<pair.second<<" to "<<it->second;
+		if(pair.second > 0.0)
+			ss<<" (+"<<std::fixed<<std::setprecision(1)<<((it->second /pair.second -1.0) *100.0)<<"%)";
+		if(isTime && thresholds.failOnTime == false)
+			outAdvisories.push_back(ss.str());
+		else
+			regressions.push_back(ss.str());
+	}
+	return regressions;
+}
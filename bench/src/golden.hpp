@@ -0,0 +1,48 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#ifndef __UTIL_LUNARGLASS_BENCH_GOLDEN_HPP__
+#define __UTIL_LUNARGLASS_BENCH_GOLDEN_HPP__
+
+#include <util_lunarglass/util_lunarglass.hpp>
+#include <unordered_map>
+#include <optional>
+#include <string>
+#include <vector>
+#include <map>
+
+namespace lunarglass::bench
+{
+	// Stored result of a single corpus program. On disk every program is a sub-directory of the golden
+	// directory, with one '<stage>.glsl' file per generated shader and a 'metrics.txt' with one
+	// '<name> <value>' pair per line.
+	struct GoldenProgram
+	{
+		std::unordered_map<ShaderStage,std::string> output;
+		// Timing metrics are prefixed with "time.", everything else is a static cost ("<stage>.<counter>")
+		std::map<std::string,double> metrics;
+	};
+
+	struct GoldenThresholds
+	{
+		// Largest accepted relative increase of a metric, e.g. 0.25 = 25%
+		double time = 0.25;
+		double cost = 0.0;
+		// Timings only compare on the machine that recorded them, so by default a latency increase
+		// beyond 'time' is only an advisory, not a regression
+		bool failOnTime = false;
+	};
+
+	bool write_golden(const std::string &directory,const std::string &programName,const GoldenProgram &program,std::string &outErr);
+	// Returns an empty optional and sets outErr if there is no baseline for the program or it can't be read
+	std::optional<GoldenProgram> load_golden(const std::string &directory,const std::string &programName,std::string &outErr);
+	// Returns a description of every difference in the output and every metric that regressed beyond its threshold.
+	// Timing increases go to outAdvisories instead, unless thresholds.failOnTime is set.
+	std::vector<std::string> compare_golden(const GoldenProgram &baseline,const GoldenProgram &current,const GoldenThresholds &thresholds,std::vector<std::string> &outAdvisories);
+};
+
+#endif
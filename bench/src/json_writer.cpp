@@ -0,0 +1,155 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#include "json_writer.hpp"
+#include <cmath>
+#include <cstdio>
+
+lunarglass::bench::JsonWriter::JsonWriter(std::ostream &out)
+	: m_out{out}
+{}
+
+void lunarglass::bench::JsonWriter::Indent()
+{
+	m_out<<'\n';
+	for(auto i=decltype(m_scopes.size()){0u};i<m_scopes.size();++i)
+		m_out<<'\t';
+}
+
+void lunarglass::bench::JsonWriter::BeginValue()
+{
+	if(m_afterKey)
+	{
+		m_afterKey = false;
+		return;
+	}
+	if(m_scopes.empty())
+		return;
+	if(m_scopes.back())
+		m_out<<',';
+	m_scopes.back() = true;
+	Indent();
+}
+
+void lunarglass::bench::JsonWriter::BeginObject()
+{
+	BeginValue();
+	m_out<<'{';
+	m_scopes.push_back(false);
+}
+
+void lunarglass::bench::JsonWriter::EndObject()
+{
+	auto hasElements = m_scopes.back();
+	m_scopes.pop_back();
+	if(hasElements)
+		Indent();
+	m_out<<'}';
+	if(m_scopes.empty())
+		m_out<<'\n';
+}
+
+void lunarglass::bench::JsonWriter::BeginArray()
+{
+	BeginValue();
+	m_out<<'[';
+	m_scopes.push_back(false);
+}
+
+void lunarglass::bench::JsonWriter::EndArray()
+{
+	auto hasElements = m_scopes.back();
+	m_scopes.pop_back();
+	if(hasElements)
+		Indent();
+	m_out<<']';
+}
+
+void lunarglass::bench::JsonWriter::Key(std::string_view key)
+{
+	BeginValue();
+	WriteString(key);
+	m_out<<": ";
+	m_afterKey = true;
+}
+
+void lunarglass::bench::JsonWriter::WriteString(std::string_view str)
+{
+	m_out<<'"';
+	for(auto c : str)
+	{
+		switch(c)
+		{
+		case '"':
+			m_out<<"\\\"";
+			break;
+		case '\\':
+			m_out<<"\\\\";
+			break;
+		case '\n':
+			m_out<<"\\n";
+			break;
+		case '\r':
+			m_out<<"\\r";
+			break;
+		case '\t':
+			m_out<<"\\t";
+			break;
+		default:
+			if(static_cast<unsigned char>(c) < 0x20)
+			{
+				char buf[8];
+				snprintf(buf,sizeof(buf),"\\u%04x",static_cast<unsigned int>(c));
+				m_out<<buf;
+			}
+			else
+				m_out<<c;
+			break;
+		}
+	}
+	m_out<<'"';
+}
+
+void lunarglass::bench::JsonWriter::Value(std::string_view value)
+{
+	BeginValue();
+	WriteString(value);
+}
+
+void lunarglass::bench::JsonWriter::Value(const char *value) {Value(std::string_view{value});}
+
+void lunarglass::bench::JsonWriter::Value(double value)
+{
+	BeginValue();
+	// JSON has no representation for NaN or infinity
+	if(std::isfinite(value) == false)
+	{
+		m_out<<"null";
+		return;
+	}
+	char buf[32];
+	snprintf(buf,sizeof(buf),"%.6g",value);
+	m_out<<buf;
+}
+
+void lunarglass::bench::JsonWriter::Value(int64_t value)
+{
+	BeginValue();
+	m_out<<value;
+}
+
+void lunarglass::bench::JsonWriter::Value(uint64_t value)
+{
+	BeginValue();
+	m_out<<value;
+}
+
+void lunarglass::bench::JsonWriter::Value(bool value)
+{
+	BeginValue();
+	m_out<<(value ? "true" : "false");
+}
@@ -0,0 +1,52 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#ifndef __UTIL_LUNARGLASS_BENCH_JSON_WRITER_HPP__
+#define __UTIL_LUNARGLASS_BENCH_JSON_WRITER_HPP__
+
+#include <string_view>
+#include <cinttypes>
+#include <ostream>
+#include <vector>
+
+namespace lunarglass::bench
+{
+	// Minimal streaming JSON writer; Commas and indentation are handled automatically
+	class JsonWriter
+	{
+	public:
+		JsonWriter(std::ostream &out);
+		void BeginObject();
+		void EndObject();
+		void BeginArray();
+		void EndArray();
+		// Has to be followed by exactly one value, object or array
+		void Key(std::string_view key);
+
+		void Value(std::string_view value);
+		void Value(const char *value);
+		void Value(double value);
+		void Value(int64_t value);
+		void Value(uint64_t value);
+		void Value(uint32_t value) {Value(static_cast<uint64_t>(value));}
+		void Value(int32_t value) {Value(static_cast<int64_t>(value));}
+		void Value(bool value);
+
+		template<typename T>
+			void Field(std::string_view key,const T &value) {Key(key); Value(value);}
+	private:
+		void BeginValue();
+		void Indent();
+		void WriteString(std::string_view str);
+		std::ostream &m_out;
+		// One entry per open object/array; true once it has received its first element
+		std::vector<bool> m_scopes;
+		bool m_afterKey = false;
+	};
+};
+
+#endif
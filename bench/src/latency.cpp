@@ -0,0 +1,44 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#include "latency.hpp"
+#include "json_writer.hpp"
+#include <algorithm>
+#include <cmath>
+
+lunarglass::bench::LatencySummary lunarglass::bench::summarize(std::vector<double> values)
+{
+	LatencySummary summary {};
+	if(values.empty())
+		return summary;
+	std::sort(values.begin(),values.end());
+	// Nearest-rank percentiles
+	auto percentile = [&values](double p) {
+		auto rank = static_cast<size_t>(std::ceil(p /100.0 *values.size()));
+		return values[std::clamp<size_t>(rank,1,values.size()) -1];
+	};
+	summary.min = values.front();
+	summary.max = values.back();
+	double sum = 0.0;
+	for(auto v : values)
+		sum += v;
+	summary.mean = sum /values.size();
+	summary.p50 = percentile(50.0);
+	summary.p99 = percentile(99.0);
+	return summary;
+}
+
+void lunarglass::bench::write_latency(JsonWriter &json,const LatencySummary &summary)
+{
+	json.BeginObject();
+	json.Field("min",summary.min);
+	json.Field("p50",summary.p50);
+	json.Field("p99",summary.p99);
+	json.Field("mean",summary.mean);
+	json.Field("max",summary.max);
+	json.EndObject();
+}
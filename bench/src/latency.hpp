@@ -0,0 +1,28 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#ifndef __UTIL_LUNARGLASS_BENCH_LATENCY_HPP__
+#define __UTIL_LUNARGLASS_BENCH_LATENCY_HPP__
+
+#include <vector>
+
+namespace lunarglass::bench
+{
+	class JsonWriter;
+	struct LatencySummary
+	{
+		double min = 0.0;
+		double max = 0.0;
+		double mean = 0.0;
+		double p50 = 0.0;
+		double p99 = 0.0;
+	};
+	LatencySummary summarize(std::vector<double> values);
+	void write_latency(JsonWriter &json,const LatencySummary &summary);
+};
+
+#endif
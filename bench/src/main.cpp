@@ -0,0 +1,773 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#include "corpus.hpp"
+#include "golden.hpp"
+#include "json_writer.hpp"
+#include "latency.hpp"
+#include "platform.hpp"
+#include <util_lunarglass/util_lunarglass.hpp>
+#include <util_lunarglass/compiler.hpp>
+#include <util_lunarglass/compile_stats.hpp>
+#include <util_lunarglass/tracer.hpp>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <optional>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <vector>
+
+#ifndef UTIL_LUNARGLASS_BENCH_CORPUS_DIR
+#define UTIL_LUNARGLASS_BENCH_CORPUS_DIR "corpus"
+#endif
+
+using namespace lunarglass;
+using namespace lunarglass::bench;
+
+namespace
+{
+	struct BenchConfig
+	{
+		std::string corpusDirectory = UTIL_LUNARGLASS_BENCH_CORPUS_DIR;
+		std::string jsonPath; // stdout if empty
+		std::string tracePath;
+		std::string filter;
+		uint32_t iterations = 10;
+		uint32_t warmupIterations = 1;
+		uint32_t threadCount = 1;
+		bool useSessions = false;
+		bool parallelStages = false;
+		int substitutionLevel = 1;
+		bool verify = false;
+		uint32_t verifyThreadCount = 0;
+		// Skip lunarglass::initialize, so that the first compile pays for the process initialization
+		bool coldStart = false;
+		std::string goldenDirectory;
+		bool updateGolden = false;
+		GoldenThresholds goldenThresholds {};
+	};
+
+	struct Sample
+	{
+		double latencyMs = 0.0;
+		CompileStats stats {};
+		bool success = false;
+	};
+
+	struct ProgramResult
+	{
+		std::vector<Sample> samples;
+		std::unordered_map<ShaderStage,std::string> output;
+		size_t outputBytes = 0;
+		uint32_t stageCount = 0;
+		std::string error;
+	};
+
+	double to_ms(std::chrono::nanoseconds t) {return std::chrono::duration<double,std::milli>{t}.count();}
+
+	void print_usage()
+	{
+		std::cerr<<"Usage: util_lunarglass_bench [options]\n"
+			<<"  --corpus <dir>          Corpus directory (default: " UTIL_LUNARGLASS_BENCH_CORPUS_DIR ")\n"
+			<<"  --filter <substring>    Only run programs whose name contains the substring\n"
+			<<"  --iterations <n>        Timed iterations per program (default: 10)\n"
+			<<"  --warmup <n>            Untimed iterations per program (default: 1)\n"
+			<<"  --threads <n>           Compile on n threads at once, 0 = hardware threads (default: 1)\n"
+			<<"  --sessions              Use one lunarglass::Compiler session per thread\n"
+			<<"  --parallel-stages       Set Options::parallelStages\n"
+			<<"  --substitution <level>  Options::substitutionLevel (default: 1)\n"
+			<<"  --cold-start            Don't call lunarglass::initialize or Compiler::WarmUp before compiling\n"
+			<<"  --verify                Check that a concurrent batch produces the same output as serial calls\n"
+			<<"  --verify-threads <n>    Thread count for --verify, 0 = hardware threads (default: 0)\n"
+			<<"  --json <file>           Write the JSON report to a file instead of stdout\n"
+			<<"  --trace <file>          Write a Chrome trace (chrome://tracing, Perfetto) of the timed iterations\n"
+			<<"  --golden <dir>          Compare output and metrics of every program against the baselines in a directory\n"
+			<<"  --update-golden         Write the baselines for --golden instead of comparing against them\n"
+			<<"  --time-tolerance <%>    Fail on a p50 latency increase over the baseline beyond this; Otherwise\n"
+			<<"                          increases beyond 25% are only reported as advisories\n"
+			<<"  --cost-tolerance <%>    Accepted static cost increase over the baseline (default: 0)\n";
+	}
+
+	bool parse_args(int argc,char *argv[],BenchConfig &config)
+	{
+		for(auto i=1;i<argc;++i)
+		{
+			std::string arg = argv[i];
+			auto next = [&](std::string &out) -> bool {
+				if(i +1 >= argc)
+				{
+					std::cerr<<"Missing value for "<<arg<<"\n";
+					return false;
+				}
+				out = argv[++i];
+				return true;
+			};
+			auto nextUint = [&](uint32_t &out) -> bool {
+				std::string value;
+				if(next(value) == false)
+					return false;
+				try
+				{
+					out = static_cast<uint32_t>(std::stoul(value));
+				}
+				catch(const std::exception&)
+				{
+					std::cerr<<"Invalid value '"<<value<<"' for "<<arg<<"\n";
+					return false;
+				}
+				return true;
+			};
+			if(arg == "--corpus")
+			{
+				if(next(config.corpusDirectory) == false)
+					return false;
+			}
+			else if(arg == "--filter")
+			{
+				if(next(config.filter) == false)
+					return false;
+			}
+			else if(arg == "--json")
+			{
+				if(next(config.jsonPath) == false)
+					return false;
+			}
+			else if(arg == "--trace")
+			{
+				if(next(config.tracePath) == false)
+					return false;
+			}
+			else if(arg == "--golden")
+			{
+				if(next(config.goldenDirectory) == false)
+					return false;
+			}
+			else if(arg == "--time-tolerance" || arg == "--cost-tolerance")
+			{
+				uint32_t percent;
+				if(nextUint(percent) == false)
+					return false;
+				(arg == "--time-tolerance" ? config.goldenThresholds.time : config.goldenThresholds.cost) = percent /100.0;
+				if(arg == "--time-tolerance")
+					config.goldenThresholds.failOnTime = true;
+			}
+			else if(arg == "--iterations")
+			{
+				if(nextUint(config.iterations) == false)
+					return false;
+			}
+			else if(arg == "--warmup")
+			{
+				if(nextUint(config.warmupIterations) == false)
+					return false;
+			}
+			else if(arg == "--threads")
+			{
+				if(nextUint(config.threadCount) == false)
+					return false;
+			}
+			else if(arg == "--verify-threads")
+			{
+				if(nextUint(config.verifyThreadCount) == false)
+					return false;
+			}
+			else if(arg == "--substitution")
+			{
+				uint32_t level;
+				if(nextUint(level) == false)
+					return false;
+				config.substitutionLevel = static_cast<int>(level);
+			}
+			else if(arg == "--sessions")
+				config.useSessions = true;
+			else if(arg == "--parallel-stages")
+				config.parallelStages = true;
+			else if(arg == "--verify")
+				config.verify = true;
+			else if(arg == "--cold-start")
+				config.coldStart = true;
+			else if(arg == "--update-golden")
+				config.updateGolden = true;
+			else if(arg == "--help" || arg == "-h")
+			{
+				print_usage();
+				return false;
+			}
+			else
+			{
+				std::cerr<<"Unknown argument '"<<arg<<"'\n";
+				print_usage();
+				return false;
+			}
+		}
+		if(config.updateGolden && config.goldenDirectory.empty())
+		{
+			std::cerr<<"--update-golden requires --golden\n";
+			return false;
+		}
+		if(config.threadCount == 0)
+			config.threadCount = std::max(std::thread::hardware_concurrency(),1u);
+		return true;
+	}
+
+	Options get_program_options(const BenchConfig &config)
+	{
+		Options options {};
+		options.substitutionLevel = config.substitutionLevel;
+		options.parallelStages = config.parallelStages;
+		return options;
+	}
+
+	// Runs every program 'iterations' times, spread across config.threadCount threads
+	void run_programs(const BenchConfig &config,const std::vector<CorpusProgram> &programs,uint32_t iterations,std::vector<ProgramResult> &results,Tracer *tracer)
+	{
+		auto taskCount = programs.size() *iterations;
+		std::atomic<size_t> nextTask = 0;
+		auto worker = [&](uint32_t workerIndex) {
+			if(tracer)
+				tracer->SetThreadName("bench worker " +std::to_string(workerIndex));
+			CompileStats stats {};
+			auto options = get_program_options(config);
+			options.stats = &stats;
+			options.tracer = tracer;
+			// Sessions keep a copy of the options, including the stats pointer
+			std::unique_ptr<Compiler> session = config.useSessions ? std::make_unique<Compiler>(options) : nullptr;
+			if(session && config.coldStart == false)
+				session->WarmUp();
+			for(;;)
+			{
+				auto task = nextTask++;
+				if(task >= taskCount)
+					break;
+				// Iteration-major order, so that consecutive tasks hit different programs
+				auto programIndex = task %programs.size();
+				auto iteration = task /programs.size();
+				auto &program = programs[programIndex];
+				auto &result = results[programIndex];
+				// Sessions are bound to the options they were created with, so their traces can't name the program
+				options.name = program.name;
+
+				std::string infoLog;
+				std::optional<std::unordered_map<ShaderStage,std::string>> shaders;
+				auto t0 = std::chrono::steady_clock::now();
+				try
+				{
+					if(session)
+						shaders = session->Optimize(program.shaders,infoLog);
+					else
+						shaders = optimize_glsl(program.shaders,options,infoLog);
+				}
+				catch(const std::exception &e)
+				{
+					infoLog = e.what();
+				}
+				auto t1 = std::chrono::steady_clock::now();
+
+				auto &sample = result.samples[iteration];
+				sample.latencyMs = std::chrono::duration<double,std::milli>{t1 -t0}.count();
+				sample.success = shaders.has_value();
+				sample.stats = stats;
+				if(shaders.has_value() == false)
+				{
+					// Every iteration of a program fails the same way, which one reports it doesn't matter
+					if(iteration == 0)
+						result.error = infoLog;
+					continue;
+				}
+				if(iteration == 0)
+				{
+					result.stageCount = static_cast<uint32_t>(shaders->size());
+					result.outputBytes = 0;
+					for(auto &pair : *shaders)
+						result.outputBytes += pair.second.size();
+					result.output = std::move(*shaders);
+				}
+			}
+		};
+		std::vector<std::thread> threads;
+		for(auto i=decltype(config.threadCount){1u};i<config.threadCount;++i)
+			threads.emplace_back(worker,i);
+		worker(0);
+		for(auto &t : threads)
+			t.join();
+	}
+
+	// Compiles every program once serially and once as a concurrent batch and compares the output byte by byte
+	std::vector<std::string> verify_determinism(const BenchConfig &config,const std::vector<CorpusProgram> &programs)
+	{
+		auto options = get_program_options(config);
+		std::vector<std::optional<std::unordered_map<ShaderStage,std::string>>> serial {};
+		serial.reserve(programs.size());
+		for(auto &program : programs)
+		{
+			std::string infoLog;
+			serial.push_back(optimize_glsl(program.shaders,options,infoLog));
+		}
+
+		// Every program several times, so that the same program is compiled on different threads at once
+		constexpr uint32_t copies = 4;
+		std::vector<std::unordered_map<ShaderStage,std::string>> batchPrograms {};
+		batchPrograms.reserve(programs.size() *copies);
+		for(auto i=0u;i<copies;++i)
+		{
+			for(auto &program : programs)
+				batchPrograms.push_back(program.shaders);
+		}
+		BatchOptions batchOptions {};
+		for(auto i=decltype(batchPrograms.size()){0u};i<batchPrograms.size();++i)
+			batchOptions.programNames.push_back(programs[i %programs.size()].name);
+		batchOptions.threadCount = config.verifyThreadCount;
+		batchOptions.programOptions = options;
+		auto batchResults = optimize_glsl_batch(batchPrograms,batchOptions);
+
+		std::vector<std::string> mismatches {};
+		for(auto i=decltype(batchResults.size()){0u};i<batchResults.size();++i)
+		{
+			auto programIndex = i %programs.size();
+			if(batchResults[i].shaders != serial[programIndex])
+			{
+				auto &name = programs[programIndex].name;
+				if(std::find(mismatches.begin(),mismatches.end(),name) == mismatches.end())
+					mismatches.push_back(name);
+			}
+		}
+		return mismatches;
+	}
+
+	// Mean count and bytes per call, and the largest high-water mark seen in any call
+	void write_allocations(JsonWriter &json,const std::vector<Sample> &samples,const std::function<AllocationStats(const CompileStats&)> &getAllocations)
+	{
+		double count = 0.0;
+		double bytes = 0.0;
+		uint64_t highWater = 0;
+		for(auto &sample : samples)
+		{
+			auto allocations = getAllocations(sample.stats);
+			count += allocations.count;
+			bytes += allocations.bytes;
+			highWater = std::max(highWater,allocations.highWater);
+		}
+		json.BeginObject();
+		json.Field("count",count /samples.size());
+		json.Field("bytes",bytes /samples.size());
+		json.Field("high_water_bytes",highWater);
+		json.EndObject();
+	}
+
+	GoldenProgram get_golden_program(const ProgramResult &result)
+	{
+		GoldenProgram program {};
+		program.output = result.output;
+		std::vector<double> latencies {};
+		for(auto &sample : result.samples)
+			latencies.push_back(sample.latencyMs);
+		program.metrics["time.p50_ms"] = summarize(latencies).p50;
+		// Costs are the same for every iteration
+		for(auto s=0u;s<static_cast<uint32_t>(ShaderStage::Count);++s)
+		{
+			auto &stageStats = result.samples.front().stats.stages[s];
+			if(stageStats.present == false)
+				continue;
+			std::string prefix = get_shader_stage_name(static_cast<ShaderStage>(s));
+			prefix += '.';
+			auto &cost = stageStats.outputCost;
+			program.metrics[prefix +"alu"] = cost.aluOps;
+			program.metrics[prefix +"texture"] = cost.textureOps;
+			program.metrics[prefix +"loads"] = cost.loads;
+			program.metrics[prefix +"stores"] = cost.stores;
+			program.metrics[prefix +"temporaries"] = cost.temporaries;
+			program.metrics[prefix +"loops"] = cost.loops;
+			program.metrics[prefix +"branches"] = cost.branches;
+			program.metrics[prefix +"output_bytes"] = stageStats.outputBytes;
+		}
+		return program;
+	}
+
+	void write_cost(JsonWriter &json,const ShaderCost &cost)
+	{
+		json.BeginObject();
+		json.Field("alu",cost.aluOps);
+		json.Field("texture",cost.textureOps);
+		json.Field("loads",cost.loads);
+		json.Field("stores",cost.stores);
+		json.Field("temporaries",cost.temporaries);
+		json.Field("loops",cost.loops);
+		json.Field("branches",cost.branches);
+		json.Field("instructions",cost.GetInstructionCount());
+		json.EndObject();
+	}
+
+	void write_substitutions(JsonWriter &json,const SubstitutionStats &substitutions)
+	{
+		json.BeginObject();
+		json.Field("substituted",substitutions.GetSubstitutedCount());
+		json.Field("emitted",substitutions.GetEmittedCount());
+		json.Key("rules");
+		json.BeginObject();
+		for(auto r=0u;r<static_cast<uint32_t>(SubstitutionRule::Count);++r)
+			json.Field(get_substitution_rule_name(static_cast<SubstitutionRule>(r)),substitutions.decisions[r]);
+		json.EndObject();
+		json.EndObject();
+	}
+};
+
+int main(int argc,char *argv[])
+{
+	BenchConfig config {};
+	if(parse_args(argc,argv,config) == false)
+		return 2;
+
+	std::string err;
+	auto programs = load_corpus(config.corpusDirectory,config.filter,err);
+	if(programs.has_value() == false)
+	{
+		std::cerr<<err<<"\n";
+		return 2;
+	}
+	if(programs->empty())
+	{
+		std::cerr<<"No programs found in '"<<config.corpusDirectory<<"'\n";
+		return 2;
+	}
+
+	// Startup costs; Measured before anything else compiles, since they are only paid once per process
+	std::optional<InitializationStats> initStats {};
+	if(config.coldStart == false)
+		initStats = initialize();
+	double firstCompileMs = 0.0;
+	auto &firstProgram = programs->front();
+	{
+		std::string infoLog;
+		auto t0 = std::chrono::steady_clock::now();
+		try
+		{
+			optimize_glsl(firstProgram.shaders,get_program_options(config),infoLog);
+		}
+		catch(const std::exception&)
+		{}
+		firstCompileMs = std::chrono::duration<double,std::milli>{std::chrono::steady_clock::now() -t0}.count();
+	}
+
+	std::vector<ProgramResult> results {};
+	if(config.warmupIterations > 0)
+	{
+		results.resize(programs->size());
+		for(auto &result : results)
+			result.samples.resize(config.warmupIterations);
+		run_programs(config,*programs,config.warmupIterations,results,nullptr);
+	}
+	results.clear();
+	results.resize(programs->size());
+	for(auto &result : results)
+		result.samples.resize(config.iterations);
+	std::unique_ptr<Tracer> tracer = config.tracePath.empty() ? nullptr : std::make_unique<Tracer>();
+	auto t0 = std::chrono::steady_clock::now();
+	run_programs(config,*programs,config.iterations,results,tracer.get());
+	auto t1 = std::chrono::steady_clock::now();
+	auto wallSeconds = std::chrono::duration<double>{t1 -t0}.count();
+
+	if(tracer && tracer->Write(config.tracePath,err) == false)
+	{
+		std::cerr<<err<<"\n";
+		return 2;
+	}
+
+	std::vector<std::string> mismatches {};
+	if(config.verify)
+		mismatches = verify_determinism(config,*programs);
+
+	// Program name and description of every regression against the baselines
+	std::vector<std::pair<std::string,std::string>> goldenRegressions {};
+	std::vector<std::pair<std::string,std::string>> goldenAdvisories {};
+	if(config.goldenDirectory.empty() == false)
+	{
+		for(auto i=decltype(programs->size()){0u};i<programs->size();++i)
+		{
+			auto &name = (*programs)[i].name;
+			auto &result = results[i];
+			// Failed programs are reported as failures already
+			if(result.error.empty() == false)
+				continue;
+			auto current = get_golden_program(result);
+			if(config.updateGolden)
+			{
+				if(write_golden(config.goldenDirectory,name,current,err) == false)
+				{
+					std::cerr<<err<<"\n";
+					return 2;
+				}
+				continue;
+			}
+			auto baseline = load_golden(config.goldenDirectory,name,err);
+			if(baseline.has_value() == false)
+			{
+				goldenRegressions.push_back({name,err});
+				continue;
+			}
+			std::vector<std::string> advisories {};
+			for(auto &regression : compare_golden(*baseline,current,config.goldenThresholds,advisories))
+				goldenRegressions.push_back({name,regression});
+			for(auto &advisory : advisories)
+				goldenAdvisories.push_back({name,advisory});
+		}
+	}
+
+	uint64_t compiledPrograms = 0;
+	uint64_t compiledShaders = 0;
+	uint64_t failures = 0;
+	std::vector<double> allLatencies {};
+	for(auto &result : results)
+	{
+		for(auto &sample : result.samples)
+		{
+			allLatencies.push_back(sample.latencyMs);
+			if(sample.success == false)
+			{
+				++failures;
+				continue;
+			}
+			++compiledPrograms;
+			compiledShaders += result.stageCount;
+		}
+	}
+
+	std::ofstream jsonFile {};
+	if(config.jsonPath.empty() == false)
+	{
+		jsonFile.open(config.jsonPath,std::ios::trunc);
+		if(!jsonFile)
+		{
+			std::cerr<<"Unable to open '"<<config.jsonPath<<"' for writing\n";
+			return 2;
+		}
+	}
+	JsonWriter json {config.jsonPath.empty() ? std::cout : jsonFile};
+	json.BeginObject();
+	json.Key("config");
+	json.BeginObject();
+	json.Field("corpus",config.corpusDirectory);
+	json.Field("iterations",config.iterations);
+	json.Field("warmup_iterations",config.warmupIterations);
+	json.Field("threads",config.threadCount);
+	json.Field("sessions",config.useSessions);
+	json.Field("parallel_stages",config.parallelStages);
+	json.Field("substitution_level",config.substitutionLevel);
+	json.Field("hardware_threads",std::thread::hardware_concurrency());
+	json.Field("allocation_tracking",is_allocation_tracking_enabled());
+	if(config.goldenDirectory.empty() == false)
+	{
+		json.Field("golden",config.goldenDirectory);
+		json.Field("update_golden",config.updateGolden);
+	}
+	json.EndObject();
+
+	json.Key("startup");
+	json.BeginObject();
+	json.Field("initialize",initStats.has_value());
+	if(initStats.has_value())
+	{
+		json.Field("process_ms",to_ms(initStats->process));
+		json.Field("warm_up_ms",to_ms(initStats->warmUp));
+		json.Field("warm_up_ok",initStats->warmUpSucceeded);
+	}
+	// First compile of the process, of the first program of the corpus
+	json.Field("first_compile_program",firstProgram.name);
+	json.Field("first_compile_ms",firstCompileMs);
+	json.EndObject();
+
+	json.Key("summary");
+	json.BeginObject();
+	json.Field("wall_seconds",wallSeconds);
+	json.Field("programs_compiled",compiledPrograms);
+	json.Field("shaders_compiled",compiledShaders);
+	json.Field("failures",failures);
+	json.Field("programs_per_second",compiledPrograms /wallSeconds);
+	json.Field("shaders_per_second",compiledShaders /wallSeconds);
+	json.Key("latency_ms");
+	auto overall = summarize(allLatencies);
+	write_latency(json,overall);
+	json.Field("peak_rss_bytes",get_peak_rss());
+	json.EndObject();
+
+	json.Key("programs");
+	json.BeginArray();
+	for(auto i=decltype(programs->size()){0u};i<programs->size();++i)
+	{
+		auto &program = (*programs)[i];
+		auto &result = results[i];
+		json.BeginObject();
+		json.Field("name",program.name);
+		json.Key("stages");
+		json.BeginArray();
+		for(auto s=0u;s<static_cast<uint32_t>(ShaderStage::Count);++s)
+		{
+			if(program.shaders.find(static_cast<ShaderStage>(s)) != program.shaders.end())
+				json.Value(get_shader_stage_name(static_cast<ShaderStage>(s)));
+		}
+		json.EndArray();
+		json.Field("input_bytes",static_cast<uint64_t>(program.inputBytes));
+		json.Field("output_bytes",static_cast<uint64_t>(result.outputBytes));
+		json.Field("ok",result.error.empty());
+		if(result.error.empty() == false)
+			json.Field("error",result.error);
+
+		std::vector<double> latencies {};
+		for(auto &sample : result.samples)
+			latencies.push_back(sample.latencyMs);
+		json.Key("latency_ms");
+		write_latency(json,summarize(latencies));
+
+		// Mean wall time per phase, summed over all stages
+		if(result.samples.empty() == false)
+		{
+			json.Key("phases_ms");
+			json.BeginObject();
+			for(auto p=0u;p<static_cast<uint32_t>(CompilePhase::Count);++p)
+			{
+				std::chrono::nanoseconds sum {0};
+				for(auto &sample : result.samples)
+				{
+					for(auto &stage : sample.stats.stages)
+						sum += stage.phases[p].wall;
+				}
+				json.Field(get_compile_phase_name(static_cast<CompilePhase>(p)),to_ms(sum) /result.samples.size());
+			}
+			std::chrono::nanoseconds linkSum {0};
+			for(auto &sample : result.samples)
+				linkSum += sample.stats.link.wall;
+			json.Field("link",to_ms(linkSum) /result.samples.size());
+			json.EndObject();
+
+			// Costs are the same for every iteration
+			json.Key("cost");
+			json.BeginObject();
+			for(auto s=0u;s<static_cast<uint32_t>(ShaderStage::Count);++s)
+			{
+				auto &stageStats = result.samples.front().stats.stages[s];
+				if(stageStats.present == false)
+					continue;
+				json.Key(get_shader_stage_name(static_cast<ShaderStage>(s)));
+				json.BeginObject();
+				json.Key("top");
+				write_cost(json,stageStats.topCost);
+				json.Key("output");
+				write_cost(json,stageStats.outputCost);
+				// Fraction of the Top IR instructions the optimizer removed
+				auto topInstructions = stageStats.topCost.GetInstructionCount();
+				auto outputInstructions = stageStats.outputCost.GetInstructionCount();
+				json.Field("instruction_reduction",(topInstructions > 0) ? (1.0 -static_cast<double>(outputInstructions) /topInstructions) : 0.0);
+				// Which rules decided between forward substitution and a temporary for every expression
+				json.Key("substitutions");
+				write_substitutions(json,stageStats.substitutions);
+				json.EndObject();
+			}
+			json.EndObject();
+
+			if(is_allocation_tracking_enabled())
+			{
+				json.Key("allocations");
+				json.BeginObject();
+				for(auto p=0u;p<static_cast<uint32_t>(CompilePhase::Count);++p)
+				{
+					json.Key(get_compile_phase_name(static_cast<CompilePhase>(p)));
+					write_allocations(json,result.samples,[p](const CompileStats &stats) {
+						AllocationStats allocations {};
+						for(auto &stage : stats.stages)
+							allocations += stage.phases[p].allocations;
+						return allocations;
+					});
+				}
+				json.Key("link");
+				write_allocations(json,result.samples,[](const CompileStats &stats) {return stats.link.allocations;});
+				// With parallel stages, allocations of the stage threads aren't part of the total
+				json.Key("total");
+				write_allocations(json,result.samples,[](const CompileStats &stats) {return stats.total.allocations;});
+				json.EndObject();
+			}
+		}
+		json.EndObject();
+	}
+	json.EndArray();
+
+	if(config.verify)
+	{
+		json.Key("verify");
+		json.BeginObject();
+		json.Field("ok",mismatches.empty());
+		json.Key("mismatches");
+		json.BeginArray();
+		for(auto &name : mismatches)
+			json.Value(name);
+		json.EndArray();
+		json.EndObject();
+	}
+	if(config.goldenDirectory.empty() == false && config.updateGolden == false)
+	{
+		json.Key("golden");
+		json.BeginObject();
+		json.Field("ok",goldenRegressions.empty());
+		json.Field("time_tolerance",config.goldenThresholds.time);
+		json.Field("fail_on_time",config.goldenThresholds.failOnTime);
+		json.Field("cost_tolerance",config.goldenThresholds.cost);
+		json.Key("regressions");
+		json.BeginArray();
+		for(auto &pair : goldenRegressions)
+		{
+			json.BeginObject();
+			json.Field("program",pair.first);
+			json.Field("description",pair.second);
+			json.EndObject();
+		}
+		json.EndArray();
+		json.Key("advisories");
+		json.BeginArray();
+		for(auto &pair : goldenAdvisories)
+		{
+			json.BeginObject();
+			json.Field("program",pair.first);
+			json.Field("description",pair.second);
+			json.EndObject();
+		}
+		json.EndArray();
+		json.EndObject();
+	}
+	json.EndObject();
+
+	std::cerr<<compiledPrograms<<" programs ("<<compiledShaders<<" shaders) in "<<wallSeconds<<"s: "
+		<<(compiledShaders /wallSeconds)<<" shaders/s, p50 "<<overall.p50<<"ms, p99 "<<overall.p99<<"ms, "
+		<<failures<<" failures\n";
+	if(initStats.has_value())
+		std::cerr<<"Startup: initialize "<<to_ms(initStats->process +initStats->warmUp)<<"ms, first compile "<<firstCompileMs<<"ms\n";
+	else
+		std::cerr<<"Startup: first compile "<<firstCompileMs<<"ms (cold)\n";
+	if(mismatches.empty() == false)
+	{
+		std::cerr<<"Output of concurrent compilation differs from serial compilation for:";
+		for(auto &name : mismatches)
+			std::cerr<<" "<<name;
+		std::cerr<<"\n";
+		return 1;
+	}
+	if(goldenAdvisories.empty() == false)
+	{
+		std::cerr<<"Latency changes against the baselines (advisory, timings depend on the machine):\n";
+		for(auto &pair : goldenAdvisories)
+			std::cerr<<"  "<<pair.first<<": "<<pair.second<<"\n";
+	}
+	if(goldenRegressions.empty() == false)
+	{
+		std::cerr<<"Regressions against the baselines in '"<<config.goldenDirectory<<"':\n";
+		for(auto &pair : goldenRegressions)
+			std::cerr<<"  "<<pair.first<<": "<<pair.second<<"\n";
+		return 1;
+	}
+	return (failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,34 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#include "platform.hpp"
+#ifdef _WIN32
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+uint64_t lunarglass::bench::get_peak_rss()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters {};
+	if(GetProcessMemoryInfo(GetCurrentProcess(),&counters,sizeof(counters)) == FALSE)
+		return 0;
+	return counters.PeakWorkingSetSize;
+#else
+	rusage usage {};
+	if(getrusage(RUSAGE_SELF,&usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+	// Reported in kilobytes on Linux
+	return static_cast<uint64_t>(usage.ru_maxrss) *1024;
+#endif
+#endif
+}
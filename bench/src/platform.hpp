@@ -0,0 +1,19 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#ifndef __UTIL_LUNARGLASS_BENCH_PLATFORM_HPP__
+#define __UTIL_LUNARGLASS_BENCH_PLATFORM_HPP__
+
+#include <cinttypes>
+
+namespace lunarglass::bench
+{
+	// Peak resident set size of the process in bytes, or 0 if it can't be determined
+	uint64_t get_peak_rss();
+};
+
+#endif
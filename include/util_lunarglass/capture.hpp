@@ -0,0 +1,90 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#ifndef __UTIL_LUNARGLASS_CAPTURE_HPP__
+#define __UTIL_LUNARGLASS_CAPTURE_HPP__
+
+#include "util_lunarglass/lunarglass_definitions.hpp"
+#include "util_lunarglass/util_lunarglass.hpp"
+#include "util_lunarglass/resource_limits.hpp"
+#include <unordered_map>
+#include <string_view>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <map>
+
+namespace lunarglass
+{
+	// Capture file layout (all integers little-endian):
+	//   Header     magic "LGCAPTUR", version
+	//   Chunks     {type (u8), payload size (u32), payload}, in the order they were written
+	//     Limits   id, int and flag counts, then the ResourceLimitValues in declaration order
+	//     Compile  timestamp, substitution level, option flags, limits id (or ~0 for the defaults),
+	//              name, then {stage, size, source} for every stage
+	// Limits are written once per writer, the first time a compile uses them. Ids are only unique
+	// within the chunks of a single writer; A later definition with the same id replaces the earlier one.
+
+	// Appends every optimize_glsl input (sources, options and resource limits) to a capture file, so that
+	// real workloads can be replayed later on. Assign it to Options::capture. Thread-safe; Every record is
+	// flushed right away, so a capture stays readable if the process dies. A file must not be written by
+	// more than one writer at a time.
+	class DLLLUNARGLASS CaptureWriter
+	{
+	public:
+		// Appends to the file if it already is a capture, creates it otherwise
+		static std::unique_ptr<CaptureWriter> Open(const std::string &path,std::string &outErr);
+		CaptureWriter(const CaptureWriter&)=delete;
+		CaptureWriter &operator=(const CaptureWriter&)=delete;
+
+		// Returns false if the record could not be written (e.g. because the disk is full). The writer
+		// stops recording after the first failure, since the file may end in a partial record.
+		bool Record(const std::unordered_map<ShaderStage,std::string_view> &shaderStages,const Options &options);
+		// Number of compiles recorded by this writer
+		uint64_t GetRecordCount() const;
+		// optimize_glsl doesn't fail because of the capture, check this to find out whether it is complete
+		bool HasWriteFailed() const;
+	private:
+		CaptureWriter()=default;
+		mutable std::mutex m_mutex;
+		std::ofstream m_file;
+		std::map<ResourceLimits::Digest,uint32_t> m_limitIds;
+		uint64_t m_recordCount = 0;
+		bool m_writeFailed = false;
+	};
+
+	// A single recorded optimize_glsl call
+	struct DLLLUNARGLASS CaptureRecord
+	{
+		// Nanoseconds since the epoch of the system clock
+		uint64_t timestamp = 0;
+		std::unordered_map<ShaderStage,std::string> shaders;
+		// Recorded options; cache, stats, tracer and capture are never set. If the call used custom
+		// resource limits, options.resourceLimits points to 'resourceLimits'.
+		Options options {};
+		std::shared_ptr<const ResourceLimits> resourceLimits;
+	};
+
+	class DLLLUNARGLASS CaptureReader
+	{
+	public:
+		static std::unique_ptr<CaptureReader> Open(const std::string &path,std::string &outErr);
+		CaptureReader(const CaptureReader&)=delete;
+		CaptureReader &operator=(const CaptureReader&)=delete;
+
+		// Returns false once there are no more records. outErr is only set if the file is malformed.
+		bool ReadNext(CaptureRecord &outRecord,std::string &outErr);
+	private:
+		CaptureReader()=default;
+		std::ifstream m_file;
+		std::unordered_map<uint32_t,std::shared_ptr<const ResourceLimits>> m_limits;
+	};
+};
+
+#endif
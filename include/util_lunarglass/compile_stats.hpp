@@ -0,0 +1,148 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#ifndef __UTIL_LUNARGLASS_COMPILE_STATS_HPP__
+#define __UTIL_LUNARGLASS_COMPILE_STATS_HPP__
+
+#include "util_lunarglass/lunarglass_definitions.hpp"
+#include "util_lunarglass/util_lunarglass.hpp"
+#include <chrono>
+#include <array>
+
+namespace lunarglass
+{
+	enum class CompilePhase : uint8_t
+	{
+		Parse = 0, // TShader::parse; Not used for SPIR-V input
+		TranslateToTop, // GlslangToTop or SpvToTop
+		TopToBottom, // LLVM optimization passes
+		BottomToTarget, // GLSL generation
+
+		Count
+	};
+	DLLLUNARGLASS const char *get_compile_phase_name(CompilePhase phase);
+
+	// Heap allocations made by the thread that ran a phase. Only collected if the library was built
+	// with UTIL_LUNARGLASS_TRACK_ALLOCATIONS (see is_allocation_tracking_enabled), otherwise always zero.
+	struct DLLLUNARGLASS AllocationStats
+	{
+		uint64_t count = 0;
+		uint64_t bytes = 0;
+		// Largest amount of memory the phase held at once, on top of what was live when it started
+		uint64_t highWater = 0;
+		AllocationStats &operator+=(const AllocationStats &other);
+	};
+	DLLLUNARGLASS bool is_allocation_tracking_enabled();
+
+	struct DLLLUNARGLASS PhaseStats
+	{
+		std::chrono::nanoseconds wall {0};
+		// CPU time of the thread that ran the phase
+		std::chrono::nanoseconds cpu {0};
+		AllocationStats allocations {};
+		PhaseStats &operator+=(const PhaseStats &other);
+	};
+
+	// Static operation counts of a single stage. These are no GPU cycle estimates, but a comparison of
+	// the counts before and after optimization shows how much work the optimizer removed.
+	struct DLLLUNARGLASS ShaderCost
+	{
+		uint32_t aluOps = 0; // Arithmetic, logic, comparisons, conversions and built-in math functions
+		uint32_t textureOps = 0; // Texture samples, texel fetches and image accesses
+		uint32_t loads = 0;
+		uint32_t stores = 0;
+		uint32_t temporaries = 0;
+		uint32_t loops = 0;
+		uint32_t branches = 0; // if and switch statements, including conditional loop exits
+
+		// Sum of the per-instruction counters (ALU, texture, loads and stores)
+		uint32_t GetInstructionCount() const {return aluOps +textureOps +loads +stores;}
+	};
+
+	// Rules by which the GLSL back end decides whether an expression is forward-substituted into its
+	// uses or assigned to a temporary, in the order they are checked (see Options::substitutionLevel)
+	enum class SubstitutionRule : uint8_t
+	{
+		// Substituted
+		CheapExpression = 0, // Only names, members, indices and constants
+		IncreasesData, // Assigning it to a temporary would need more storage than the operands
+		SingleUse, // Used at most once and only in its own block
+
+		// Assigned to a temporary
+		SubstitutionDisabled, // substitutionLevel is 0
+		CantMap, // Partial writes and instructions without a result
+		SubstitutionLevel, // Not cheap and substitutionLevel is 1
+		TooLong, // Longer than 120 characters
+		ModifiesPrecision,
+		AlreadyMapped,
+		MultipleUses,
+
+		Count
+	};
+	DLLLUNARGLASS const char *get_substitution_rule_name(SubstitutionRule rule);
+	DLLLUNARGLASS bool is_substituting_rule(SubstitutionRule rule);
+
+	struct DLLLUNARGLASS SubstitutionStats
+	{
+		// Number of decisions made by every rule
+		std::array<uint32_t,static_cast<size_t>(SubstitutionRule::Count)> decisions {};
+
+		uint32_t GetCount(SubstitutionRule rule) const {return decisions[static_cast<size_t>(rule)];}
+		uint32_t GetSubstitutedCount() const;
+		uint32_t GetEmittedCount() const;
+		SubstitutionStats &operator+=(const SubstitutionStats &other);
+	};
+
+	struct DLLLUNARGLASS StageStats
+	{
+		bool present = false;
+		std::array<PhaseStats,static_cast<size_t>(CompilePhase::Count)> phases {};
+		size_t inputBytes = 0;
+		size_t outputBytes = 0;
+		// Counted on the Top IR, before any optimization. Temporaries are the local variables of the
+		// source, loops are back edges. Both costs are left at zero on a cache hit.
+		ShaderCost topCost {};
+		// Counted while the GLSL output was generated
+		ShaderCost outputCost {};
+		// Left empty on a cache hit
+		SubstitutionStats substitutions {};
+
+		const PhaseStats &GetPhase(CompilePhase phase) const {return phases[static_cast<size_t>(phase)];}
+		PhaseStats &GetPhase(CompilePhase phase) {return phases[static_cast<size_t>(phase)];}
+	};
+
+	// Timing and memory breakdown of a single optimize call. Assign it to Options::stats; It is reset at
+	// the start of every call.
+	struct DLLLUNARGLASS CompileStats
+	{
+		std::array<StageStats,static_cast<size_t>(ShaderStage::Count)> stages {};
+		PhaseStats link {};
+		// Whole call, including cache lookups
+		PhaseStats total {};
+		// If true, the result came from Options::cache and no phase ran
+		bool cacheHit = false;
+
+		const StageStats &GetStage(ShaderStage stage) const {return stages[static_cast<size_t>(stage)];}
+		StageStats &GetStage(ShaderStage stage) {return stages[static_cast<size_t>(stage)];}
+	};
+
+	// Returned by lunarglass::initialize. If another call already did (or is doing) a part, its duration
+	// is only the time spent waiting for that.
+	struct DLLLUNARGLASS InitializationStats
+	{
+		// glslang::InitializeProcess and switching LLVM to multithreaded mode
+		std::chrono::nanoseconds process {0};
+		// Compile of a small program, which constructs LLVM's pass registry and other lazily
+		// initialized globals as well as glslang's built-in symbol tables for GLSL 450.
+		// For calls after the first one, the time spent waiting for it.
+		std::chrono::nanoseconds warmUp {0};
+		// False if the warm-up program failed to compile, which leaves parts of the warm-up undone
+		bool warmUpSucceeded = false;
+	};
+};
+
+#endif
@@ -0,0 +1,49 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#ifndef __UTIL_LUNARGLASS_COMPILER_HPP__
+#define __UTIL_LUNARGLASS_COMPILER_HPP__
+
+#include "util_lunarglass/lunarglass_definitions.hpp"
+#include "util_lunarglass/util_lunarglass.hpp"
+#include <unordered_map>
+#include <string_view>
+#include <optional>
+#include <memory>
+#include <string>
+
+namespace lunarglass
+{
+	namespace detail {struct CompilerState;};
+	// Persistent compiler session. Unlike the free optimize_* functions, which build and tear down
+	// the GLSL back end for every stage of every call, a session keeps it alive and only resets the
+	// per-module state between shaders. That includes the LLVM context, so the output never depends
+	// on what the session compiled before.
+	// A session must only be used by one thread at a time; use one session per worker thread.
+	class DLLLUNARGLASS Compiler
+	{
+	public:
+		Compiler(const Options &options={});
+		~Compiler();
+		Compiler(const Compiler&)=delete;
+		Compiler &operator=(const Compiler&)=delete;
+
+		std::optional<std::unordered_map<ShaderStage,std::string>> Optimize(const std::unordered_map<ShaderStage,std::string> &shaderStages,std::string &outInfoLog);
+		std::optional<std::unordered_map<ShaderStage,std::string>> Optimize(const std::unordered_map<ShaderStage,std::string_view> &shaderStages,std::string &outInfoLog);
+		std::optional<std::string> OptimizeSpirv(const uint32_t *words,size_t count,std::string &outInfoLog,ShaderStage *outStage=nullptr);
+		// Compiles a small built-in program with this session, so that the back ends of its vertex and
+		// fragment stages already exist before the first real shader. Nothing is recorded into the
+		// cache, capture, stats or tracer of the session's options.
+		// Returns false if the program failed to compile.
+		bool WarmUp();
+		const Options &GetOptions() const;
+	private:
+		std::unique_ptr<detail::CompilerState> m_state;
+	};
+};
+
+#endif
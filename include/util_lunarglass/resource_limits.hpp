@@ -0,0 +1,153 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#ifndef __UTIL_LUNARGLASS_RESOURCE_LIMITS_HPP__
+#define __UTIL_LUNARGLASS_RESOURCE_LIMITS_HPP__
+
+#include "util_lunarglass/lunarglass_definitions.hpp"
+#include <cinttypes>
+#include <memory>
+#include <array>
+
+// Integer limits of glslang's TBuiltInResource with their default values (name,default)
+#define UTIL_LUNARGLASS_RESOURCE_LIMITS(F) \
+	F(maxLights,32) \
+	F(maxClipPlanes,6) \
+	F(maxTextureUnits,32) \
+	F(maxTextureCoords,32) \
+	F(maxVertexAttribs,64) \
+	F(maxVertexUniformComponents,4096) \
+	F(maxVaryingFloats,64) \
+	F(maxVertexTextureImageUnits,32) \
+	F(maxCombinedTextureImageUnits,80) \
+	F(maxTextureImageUnits,32) \
+	F(maxFragmentUniformComponents,4096) \
+	F(maxDrawBuffers,32) \
+	F(maxVertexUniformVectors,128) \
+	F(maxVaryingVectors,8) \
+	F(maxFragmentUniformVectors,16) \
+	F(maxVertexOutputVectors,16) \
+	F(maxFragmentInputVectors,15) \
+	F(minProgramTexelOffset,-8) \
+	F(maxProgramTexelOffset,7) \
+	F(maxClipDistances,8) \
+	F(maxComputeWorkGroupCountX,65535) \
+	F(maxComputeWorkGroupCountY,65535) \
+	F(maxComputeWorkGroupCountZ,65535) \
+	F(maxComputeWorkGroupSizeX,1024) \
+	F(maxComputeWorkGroupSizeY,1024) \
+	F(maxComputeWorkGroupSizeZ,64) \
+	F(maxComputeUniformComponents,1024) \
+	F(maxComputeTextureImageUnits,16) \
+	F(maxComputeImageUniforms,8) \
+	F(maxComputeAtomicCounters,8) \
+	F(maxComputeAtomicCounterBuffers,1) \
+	F(maxVaryingComponents,60) \
+	F(maxVertexOutputComponents,64) \
+	F(maxGeometryInputComponents,64) \
+	F(maxGeometryOutputComponents,128) \
+	F(maxFragmentInputComponents,128) \
+	F(maxImageUnits,8) \
+	F(maxCombinedImageUnitsAndFragmentOutputs,8) \
+	F(maxImageSamples,0) \
+	F(maxVertexImageUniforms,0) \
+	F(maxTessControlImageUniforms,0) \
+	F(maxTessEvaluationImageUniforms,0) \
+	F(maxGeometryImageUniforms,0) \
+	F(maxFragmentImageUniforms,8) \
+	F(maxCombinedImageUniforms,8) \
+	F(maxGeometryTextureImageUnits,16) \
+	F(maxGeometryOutputVertices,256) \
+	F(maxGeometryTotalOutputComponents,1024) \
+	F(maxGeometryUniformComponents,1024) \
+	F(maxGeometryVaryingComponents,64) \
+	F(maxTessControlInputComponents,128) \
+	F(maxTessControlOutputComponents,128) \
+	F(maxTessControlTextureImageUnits,16) \
+	F(maxTessControlUniformComponents,1024) \
+	F(maxTessControlTotalOutputComponents,4096) \
+	F(maxTessEvaluationInputComponents,128) \
+	F(maxTessEvaluationOutputComponents,128) \
+	F(maxTessEvaluationTextureImageUnits,16) \
+	F(maxTessEvaluationUniformComponents,1024) \
+	F(maxTessPatchComponents,120) \
+	F(maxPatchVertices,32) \
+	F(maxTessGenLevel,64) \
+	F(maxViewports,16) \
+	F(maxVertexAtomicCounters,0) \
+	F(maxTessControlAtomicCounters,0) \
+	F(maxTessEvaluationAtomicCounters,0) \
+	F(maxGeometryAtomicCounters,0) \
+	F(maxFragmentAtomicCounters,8) \
+	F(maxCombinedAtomicCounters,8) \
+	F(maxAtomicCounterBindings,1) \
+	F(maxVertexAtomicCounterBuffers,0) \
+	F(maxTessControlAtomicCounterBuffers,0) \
+	F(maxTessEvaluationAtomicCounterBuffers,0) \
+	F(maxGeometryAtomicCounterBuffers,0) \
+	F(maxFragmentAtomicCounterBuffers,1) \
+	F(maxCombinedAtomicCounterBuffers,1) \
+	F(maxAtomicCounterBufferSize,16384) \
+	F(maxTransformFeedbackBuffers,4) \
+	F(maxTransformFeedbackInterleavedComponents,64) \
+	F(maxCullDistances,8) \
+	F(maxCombinedClipAndCullDistances,8) \
+	F(maxSamples,4)
+
+// Language limits of TBuiltInResource::limits (name,default)
+#define UTIL_LUNARGLASS_RESOURCE_LIMIT_FLAGS(F) \
+	F(nonInductiveForLoops,true) \
+	F(whileLoops,true) \
+	F(doWhileLoops,true) \
+	F(generalUniformIndexing,true) \
+	F(generalAttributeMatrixVectorIndexing,true) \
+	F(generalVaryingIndexing,true) \
+	F(generalSamplerIndexing,true) \
+	F(generalVariableIndexing,true) \
+	F(generalConstantMatrixVectorIndexing,true)
+
+struct TBuiltInResource;
+namespace lunarglass
+{
+	// Plain values for a ResourceLimits object. Start from the defaults and override
+	// whatever differs on the target device.
+	struct DLLLUNARGLASS ResourceLimitValues
+	{
+#define UTIL_LUNARGLASS_RESOURCE_LIMIT_MEMBER(name,value) int name = value;
+		UTIL_LUNARGLASS_RESOURCE_LIMITS(UTIL_LUNARGLASS_RESOURCE_LIMIT_MEMBER)
+#undef UTIL_LUNARGLASS_RESOURCE_LIMIT_MEMBER
+#define UTIL_LUNARGLASS_RESOURCE_LIMIT_MEMBER(name,value) bool name = value;
+		UTIL_LUNARGLASS_RESOURCE_LIMIT_FLAGS(UTIL_LUNARGLASS_RESOURCE_LIMIT_MEMBER)
+#undef UTIL_LUNARGLASS_RESOURCE_LIMIT_MEMBER
+	};
+
+	// Immutable set of resource limits the GLSL sources are compiled against. The glslang table and
+	// the digest used for cache keys are computed once on construction, so a single object can be
+	// shared by any number of threads and calls. Assign it to Options::resourceLimits.
+	class DLLLUNARGLASS ResourceLimits
+	{
+	public:
+		using Digest = std::array<uint8_t,32>;
+		// Limits used when Options::resourceLimits is not set
+		static const ResourceLimits &GetDefault();
+
+		ResourceLimits(const ResourceLimitValues &values={});
+		~ResourceLimits();
+		ResourceLimits(const ResourceLimits&)=delete;
+		ResourceLimits &operator=(const ResourceLimits&)=delete;
+
+		const ResourceLimitValues &GetValues() const;
+		const TBuiltInResource &GetResources() const;
+		const Digest &GetDigest() const;
+	private:
+		ResourceLimitValues m_values;
+		std::unique_ptr<TBuiltInResource> m_resources;
+		Digest m_digest;
+	};
+};
+
+#endif
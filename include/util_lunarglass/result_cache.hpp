@@ -0,0 +1,95 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#ifndef __UTIL_LUNARGLASS_RESULT_CACHE_HPP__
+#define __UTIL_LUNARGLASS_RESULT_CACHE_HPP__
+
+#include "util_lunarglass/lunarglass_definitions.hpp"
+#include "util_lunarglass/util_lunarglass.hpp"
+#include <unordered_map>
+#include <string_view>
+#include <optional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <array>
+#include <mutex>
+#include <list>
+
+namespace lunarglass
+{
+	// SHA-256 over the stage sources and every option that affects the generated code
+	using CacheKey = std::array<uint8_t,32>;
+	struct DLLLUNARGLASS CacheKeyHasher
+	{
+		size_t operator()(const CacheKey &key) const;
+	};
+	DLLLUNARGLASS std::string cache_key_to_string(const CacheKey &key);
+
+	class ShaderPack;
+	// Thread-safe cache for optimize_glsl results, consisting of an in-memory LRU tier,
+	// any number of read-only shader packs and an optional on-disk tier (one file per result).
+	// Assign it to Options::cache to have optimize_glsl consult it before compiling.
+	class DLLLUNARGLASS ResultCache
+	{
+	public:
+		using ShaderMap = std::unordered_map<ShaderStage,std::string>;
+		struct DLLLUNARGLASS CreateInfo
+		{
+			// Upper bound for the accumulated source size of all results held in memory
+			size_t maxMemoryBytes = 64 *1024 *1024;
+			// Results are additionally persisted in this directory, unless it is empty
+			std::string diskDirectory;
+		};
+		struct DLLLUNARGLASS Statistics
+		{
+			uint64_t memoryHits = 0;
+			uint64_t packHits = 0;
+			uint64_t diskHits = 0;
+			uint64_t misses = 0;
+			size_t memoryEntryCount = 0;
+			size_t memoryBytes = 0;
+		};
+		static CacheKey ComputeKey(const std::unordered_map<ShaderStage,std::string> &shaderStages,const Options &options);
+		static CacheKey ComputeKey(const std::unordered_map<ShaderStage,std::string_view> &shaderStages,const Options &options);
+		static CacheKey ComputeKey(const uint32_t *spirv,size_t wordCount,const Options &options);
+
+		ResultCache();
+		ResultCache(const CreateInfo &createInfo);
+		ResultCache(const ResultCache&)=delete;
+		ResultCache &operator=(const ResultCache&)=delete;
+
+		std::optional<ShaderMap> Find(const CacheKey &key);
+		void Store(const CacheKey &key,const ShaderMap &shaders);
+		// Packs are searched after the in-memory tier and before the disk tier
+		void AddPack(const std::shared_ptr<const ShaderPack> &pack);
+		// Clears the in-memory tier, files on disk are left untouched
+		void Clear();
+		Statistics GetStatistics() const;
+	private:
+		struct Entry
+		{
+			CacheKey key;
+			ShaderMap shaders;
+			size_t size = 0;
+		};
+		void StoreInMemory(const CacheKey &key,const ShaderMap &shaders);
+		std::optional<ShaderMap> LoadFromDisk(const CacheKey &key) const;
+		void WriteToDisk(const CacheKey &key,const ShaderMap &shaders) const;
+		std::string GetDiskPath(const CacheKey &key) const;
+
+		CreateInfo m_createInfo;
+		mutable std::mutex m_mutex;
+		std::list<Entry> m_entries; // Most recently used first
+		std::unordered_map<CacheKey,std::list<Entry>::iterator,CacheKeyHasher> m_entryMap;
+		std::vector<std::shared_ptr<const ShaderPack>> m_packs;
+		size_t m_memoryBytes = 0;
+		Statistics m_statistics {};
+	};
+};
+
+#endif
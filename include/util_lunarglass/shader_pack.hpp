@@ -0,0 +1,87 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#ifndef __UTIL_LUNARGLASS_SHADER_PACK_HPP__
+#define __UTIL_LUNARGLASS_SHADER_PACK_HPP__
+
+#include "util_lunarglass/lunarglass_definitions.hpp"
+#include "util_lunarglass/util_lunarglass.hpp"
+#include "util_lunarglass/result_cache.hpp"
+#include <unordered_map>
+#include <string_view>
+#include <optional>
+#include <memory>
+#include <string>
+#include <map>
+
+namespace lunarglass
+{
+	// Read-only pack of optimized programs, keyed by CacheKey. The file is memory-mapped and
+	// entries are found by binary search over a sorted fixed-size index, so lookups neither
+	// parse nor allocate.
+	//
+	// Layout (all integers in the byte order of the machine that wrote the pack, so that they can be
+	// read in place; Packs are meant to be built for the platform they ship on):
+	//   Header     magic "LGSPACK\0", byte order marker, version, entry count, index offset, file size
+	//   Index      entryCount x {key[32], entry offset, entry size, stage count}, sorted by key
+	//   Entries    stageCount x {stage, size, offset of source}, followed by the
+	//              null-terminated sources; every entry starts 8-byte aligned
+	class DLLLUNARGLASS ShaderPack
+	{
+	public:
+		// View of a single program inside of the pack; Only valid for as long as the pack is alive
+		class DLLLUNARGLASS Entry
+		{
+		public:
+			uint32_t GetStageCount() const;
+			// Returns an empty view if the program has no such stage. The data is null-terminated.
+			std::string_view GetStage(ShaderStage stage) const;
+			bool HasStage(ShaderStage stage) const;
+			std::unordered_map<ShaderStage,std::string> ToShaderMap() const;
+		private:
+			friend ShaderPack;
+			Entry(const uint8_t *base,const uint8_t *stageRecords,uint32_t stageCount);
+			const uint8_t *m_base = nullptr;
+			const uint8_t *m_stageRecords = nullptr;
+			uint32_t m_stageCount = 0;
+		};
+		static std::unique_ptr<ShaderPack> Open(const std::string &path,std::string &outErr);
+		~ShaderPack();
+		ShaderPack(const ShaderPack&)=delete;
+		ShaderPack &operator=(const ShaderPack&)=delete;
+
+		std::optional<Entry> Find(const CacheKey &key) const;
+		uint32_t GetEntryCount() const;
+		CacheKey GetKey(uint32_t index) const;
+	private:
+		ShaderPack()=default;
+		const uint8_t *GetIndexEntry(uint32_t index) const;
+
+		const uint8_t *m_data = nullptr;
+		size_t m_size = 0;
+		uint32_t m_entryCount = 0;
+		const uint8_t *m_index = nullptr;
+#ifdef _WIN32
+		void *m_fileHandle = nullptr;
+		void *m_mappingHandle = nullptr;
+#endif
+	};
+
+	class DLLLUNARGLASS ShaderPackWriter
+	{
+	public:
+		// Adding the same key twice replaces the previous program
+		// Write fails if a program (all of its sources together) or the number of programs exceeds 4 GiB / 2^32.
+		void Add(const CacheKey &key,const std::unordered_map<ShaderStage,std::string> &shaders);
+		size_t GetEntryCount() const;
+		bool Write(const std::string &path,std::string &outErr) const;
+	private:
+		std::map<CacheKey,std::unordered_map<ShaderStage,std::string>> m_entries;
+	};
+};
+
+#endif
@@ -0,0 +1,66 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#ifndef __UTIL_LUNARGLASS_TRACER_HPP__
+#define __UTIL_LUNARGLASS_TRACER_HPP__
+
+#include "util_lunarglass/lunarglass_definitions.hpp"
+#include "util_lunarglass/util_lunarglass.hpp"
+#include <unordered_map>
+#include <string_view>
+#include <optional>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <mutex>
+
+namespace lunarglass
+{
+	// Thread-safe collector of timed spans, written out in the Chrome trace-event format, which
+	// loads directly into chrome://tracing and Perfetto. Assign it to Options::tracer (or
+	// BatchOptions::programOptions.tracer) to record every phase of every compile, with the
+	// Options::name of the program and the shader stage as span arguments.
+	class DLLLUNARGLASS Tracer
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+		Tracer();
+		Tracer(const Tracer&)=delete;
+		Tracer &operator=(const Tracer&)=delete;
+
+		// Records a span that ran on the calling thread
+		void AddSpan(std::string_view name,std::string_view category,Clock::time_point start,Clock::time_point end,std::string_view programName={},std::optional<ShaderStage> stage={});
+		// Shown instead of the numeric thread id in the trace viewer
+		void SetThreadName(std::string_view name);
+
+		size_t GetSpanCount() const;
+		void Clear();
+		std::string ToJson() const;
+		bool Write(const std::string &path,std::string &outErr) const;
+	private:
+		struct Span
+		{
+			std::string name;
+			std::string category;
+			std::string programName;
+			std::optional<ShaderStage> stage;
+			double startUs;
+			double durationUs;
+			uint32_t threadIndex;
+		};
+		uint32_t GetThreadIndex(); // Requires m_mutex to be locked
+
+		Clock::time_point m_epoch;
+		mutable std::mutex m_mutex;
+		std::vector<Span> m_spans;
+		std::unordered_map<std::thread::id,uint32_t> m_threadIndices;
+		std::unordered_map<uint32_t,std::string> m_threadNames;
+	};
+};
+
+#endif
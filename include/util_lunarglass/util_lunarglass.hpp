@@ -11,6 +11,7 @@
 #include "util_lunarglass/lunarglass_definitions.hpp"
 #include <optional>
 #include <unordered_map>
+#include <string_view>
 #include <string>
 #include <memory>
 #include <vector>
@@ -28,7 +29,91 @@ namespace lunarglass
 
 		Count
 	};
+	DLLLUNARGLASS const char *get_shader_stage_name(ShaderStage stage);
+
+	class ResultCache;
+	class ResourceLimits;
+	struct CompileStats;
+	struct InitializationStats;
+	class Tracer;
+	class CaptureWriter;
+	struct DLLLUNARGLASS Options
+	{
+		// 0 = never forward-substitute expressions, 1 = only cheap expressions, 2 = also substitute
+		// expressions with a single use where that doesn't grow the code
+		int substitutionLevel = 1;
+		bool obfuscate = false;
+		// Drop inputs and outputs that are never statically used
+		bool filterInactive = false;
+
+		// Translate the stages of a program on separate threads once the program has been linked.
+		// Reduces the latency of a single call to roughly that of its slowest stage.
+		bool parallelStages = false;
+
+		// If set, results are looked up in (and added to) this cache. A hit skips
+		// glslang and the LLVM pipeline entirely. The cache must outlive the call.
+		ResultCache *cache = nullptr;
+
+		// Limits the GLSL sources are compiled against; ResourceLimits::GetDefault() if not set.
+		// The object must outlive the call.
+		const ResourceLimits *resourceLimits = nullptr;
+
+		// If set, receives the time spent in every phase of the call (see compile_stats.hpp).
+		// Collecting them costs a few clock reads per phase.
+		CompileStats *stats = nullptr;
+
+		// If set, every phase of the call is recorded as a span (see tracer.hpp)
+		Tracer *tracer = nullptr;
+		// Identifies the program in traces
+		std::string name;
+
+		// If set, the inputs of every optimize_glsl call are appended to this capture (see capture.hpp)
+		CaptureWriter *capture = nullptr;
+	};
+
+	// Does the one-time work that otherwise makes the first optimize_glsl call of a process slow: Process-wide
+	// initialization and a warm-up compile (see InitializationStats). Meant to be called on a background
+	// thread at startup. Concurrent initialize calls wait for the first one and all return its warm-up result.
+	// optimize_* calls in the meantime only wait for the process-wide initialization, not for the warm-up.
+	// The warm-up only leaves process-wide state behind; The free optimize_* functions still construct a new
+	// GLSL back end for every stage, so use Compiler::WarmUp to have a session's back ends ready as well.
+	DLLLUNARGLASS InitializationStats initialize();
+
+	// Safe to call concurrently from any number of threads. Every call uses its own glslang and
+	// LLVM state, process-wide initialization happens exactly once on the first call.
 	DLLLUNARGLASS std::optional<std::unordered_map<ShaderStage,std::string>> optimize_glsl(const std::unordered_map<ShaderStage,std::string> &shaderStages,std::string &outInfoLog);
+	DLLLUNARGLASS std::optional<std::unordered_map<ShaderStage,std::string>> optimize_glsl(const std::unordered_map<ShaderStage,std::string> &shaderStages,const Options &options,std::string &outInfoLog);
+	// Reads the sources in place instead of copying them; The views only have to stay valid for the duration of the call.
+	// Braced initializer lists are ambiguous between this and the overload above, so name the map type when using one.
+	DLLLUNARGLASS std::optional<std::unordered_map<ShaderStage,std::string>> optimize_glsl(const std::unordered_map<ShaderStage,std::string_view> &shaderStages,const Options &options,std::string &outInfoLog);
+
+	// Optimizes a SPIR-V module with a single entry point and returns the GLSL for its stage.
+	// The words are read in place; glslang is not involved, so this skips parsing the source.
+	DLLLUNARGLASS std::optional<std::string> optimize_spirv(const uint32_t *words,size_t count,const Options &options,std::string &outInfoLog,ShaderStage *outStage=nullptr);
+
+	struct DLLLUNARGLASS BatchOptions
+	{
+		// Number of threads to compile with, including the calling thread. 0 = number of hardware threads
+		uint32_t threadCount = 0;
+		// Options used for every program of the batch. Since the batch already keeps all threads
+		// busy, parallelStages usually only adds overhead here. programOptions.stats is ignored.
+		Options programOptions {};
+		// Collect a CompileStats for every program into BatchResult::stats
+		bool collectStats = false;
+		// Optional; programNames[i] is used as the Options::name of programs[i]
+		std::vector<std::string> programNames;
+	};
+	struct DLLLUNARGLASS BatchResult
+	{
+		// Empty if the program failed to compile, in which case infoLog contains the reason
+		std::optional<std::unordered_map<ShaderStage,std::string>> shaders;
+		std::string infoLog;
+		// Only set if BatchOptions::collectStats is enabled
+		std::shared_ptr<CompileStats> stats;
+	};
+	// Optimizes every program in 'programs' on a work-stealing thread pool. Blocks until all programs
+	// have been processed; the result at index i belongs to programs[i].
+	DLLLUNARGLASS std::vector<BatchResult> optimize_glsl_batch(const std::vector<std::unordered_map<ShaderStage,std::string>> &programs,const BatchOptions &options={});
 };
 
 #endif
@@ -54,6 +54,7 @@
 #endif
 
 #include <cstdio>
+#include <cstring>
 #include <string>
 #include <sstream>
 #include <map>
@@ -72,6 +73,7 @@
 #include "Core/metadata.h"
 #include "Core/Passes/Util/ConstantUtil.h"
 #include "GlslTarget.h"
+#include "GlslTargetUtil.h"
 
 // glslang includes
 #include "glslang/Public/ShaderLang.h"
@@ -82,50 +84,12 @@
 #include "llvm/IR/Module.h"
 #pragma warning(pop)
 
+// util_lunarglass includes
+#include "shader_cost.hpp"
+
 namespace {
     bool UseLogicalIO = true;
 
-    bool ValidIdentChar(int c)
-    {
-        return c == '_' || 
-               (c >= 'a' && c <= 'z') ||
-               (c >= 'A' && c <= 'Z') ||
-               (c >= '0' && c <= '9');
-    }
-
-    // Taken from VS <function> hash:
-    unsigned int _Hash_seq(const unsigned char *_First, unsigned int _Count)
-    {
-        // FNV-1a hash function for bytes in [_First, _First+_Count)
-        const unsigned int _FNV_offset_basis = 2166136261U;
-        const unsigned int _FNV_prime = 16777619U;
-
-        unsigned int _Val = _FNV_offset_basis;
-        for (unsigned int _Next = 0; _Next < _Count; ++_Next)
-        {	// fold in another byte
-            _Val ^= (unsigned int)_First[_Next];
-            _Val *= _FNV_prime;
-        }
-
-        return (_Val);
-    }
-
-    void IntToString(unsigned int i, std::string& string)
-    {
-        char buf[2];
-        buf[1] = 0;
-        int radix = 36;
-        while (i > 0) {
-            unsigned int r = i % radix;
-            if (r < 10) 
-                buf[0] = '0' + r;
-            else
-                buf[0] = 'a' + r - 10;
-            string.append(buf);
-            i = i / radix;
-        }
-    }
-
     const char* GetBuiltInName(gla::EMdInputOutput io, EShLanguage stage, gla::EMdBuiltIn builtIn)
     {
         switch (io) {
@@ -360,7 +324,7 @@ public:
     GlslTarget(Manager* m, bool obfuscate, bool filterInactive, int substitutionLevel) :
         GlslTranslator(m, obfuscate, filterInactive, substitutionLevel),
         appendInitializers(false),
-        indentLevel(0), lastVariable(0)
+        indentLevel(0), lastVariable(0), obfuscatedLineCount(0)
     {
 		#if defined( _WIN32 ) && ( _MSC_VER < 1900 )
             unsigned int oldFormat = _set_output_format(_TWO_DIGIT_EXPONENT);
@@ -374,14 +338,7 @@ public:
             delete toDelete.back();
             toDelete.pop_back();
         }
-            
-        delete generatedShader;
-        delete indexShader;
 
-        for (std::map<const llvm::Value*, std::string*>::const_iterator it = nonConvertedMap.begin(); it != nonConvertedMap.end(); ++it)
-            delete it->second;
-        for (std::map<const llvm::Value*, std::string*>::const_iterator it = valueMap.begin(); it != valueMap.end(); ++it)
-            delete it->second;
         for (std::map<std::string, const std::string*>::const_iterator it = constMap.begin(); it != constMap.end(); ++it)
             delete it->second;
     }
@@ -418,7 +375,7 @@ public:
 
         case EShLangTessControl:
             // output vertices is not optional
-            globalStructures << "layout(vertices = " << GetMdNamedInt(module, gla::NumVerticesMdName) << ") out;" << std::endl;
+            globalStructures << "layout(vertices = " << GetMdNamedInt(module, gla::NumVerticesMdName) << ") out;\n";
             break;
 
         case EShLangTessEvaluation:
@@ -452,7 +409,7 @@ public:
                 UnsupportedFunctionality("tess eval input primitive", EATContinue);
                 break;
             }
-            globalStructures << ") in;" << std::endl;
+            globalStructures << ") in;\n";
 
             // vertex spacing is optional
             mdInt = GetMdNamedInt(module, gla::VertexSpacingMdName);
@@ -472,11 +429,11 @@ public:
                     UnsupportedFunctionality("tess eval vertex spacing", EATContinue);
                     break;
                 }
-                globalStructures << ") in;" << std::endl;
+                globalStructures << ") in;\n";
             }
 
             if (GetMdNamedInt(module, gla::PointModeMdName))
-                globalStructures << "layout(point_mode) in;" << std::endl;
+                globalStructures << "layout(point_mode) in;\n";
             break;
 
         case EShLangGeometry:
@@ -502,12 +459,12 @@ public:
                 UnsupportedFunctionality("geometry input primitive", EATContinue);
                 break;
             }
-            globalStructures << ") in;" << std::endl;
+            globalStructures << ") in;\n";
 
             // invocations is optional
             mdInt = GetMdNamedInt(module, gla::InvocationsMdName);
             if (mdInt != 1)
-                globalStructures << "layout(invocations = " << mdInt << ") in;" << std::endl;
+                globalStructures << "layout(invocations = " << mdInt << ") in;\n";
 
             // output primitives are not optional
             globalStructures << "layout(";
@@ -525,18 +482,18 @@ public:
                 UnsupportedFunctionality("geometry output primitive", EATContinue);
                 break;
             }
-            globalStructures << ") out;" << std::endl;
+            globalStructures << ") out;\n";
 
             // max_vertices is not optional
-            globalStructures << "layout(max_vertices = " << GetMdNamedInt(module, gla::NumVerticesMdName) << ") out;" << std::endl;
+            globalStructures << "layout(max_vertices = " << GetMdNamedInt(module, gla::NumVerticesMdName) << ") out;\n";
             break;
 
         case EShLangFragment:
             if (GetMdNamedInt(module, PixelCenterIntegerMdName))
-                globalStructures << "layout(pixel_center_integer) in;" << std::endl;
+                globalStructures << "layout(pixel_center_integer) in;\n";
 
             if (GetMdNamedInt(module, OriginUpperLeftMdName) && (version >= 150))
-                globalStructures << "layout(origin_upper_left) in;" << std::endl;
+                globalStructures << "layout(origin_upper_left) in;\n";
 
             if (GetMdNamedInt(module, BlendEquationMdName)) {
                 int blendEquations = GetMdNamedInt(module, BlendEquationMdName);
@@ -562,7 +519,7 @@ public:
                         case EmeAllEquations:  globalStructures << "blend_support_all_equations";   break;
                         default:               globalStructures << "bad_blend";                     break;
                         }
-                        globalStructures << ") out;" << std::endl;
+                        globalStructures << ") out;\n";
                     }
                 }
             }
@@ -576,7 +533,7 @@ public:
                 globalStructures << "layout(local_size_x=" << sizes[0];
                 globalStructures << ", local_size_y=" << sizes[1];
                 globalStructures << ", local_size_z=" << sizes[2];
-                globalStructures << ") in; " << std::endl;
+                globalStructures << ") in; \n";
             }
             break;
         }
@@ -629,7 +586,7 @@ public:
     void newScope();
     void leaveScope();
 
-    void addStructType(std::ostringstream& out, std::string& name, const llvm::Type* structType, const llvm::MDNode* mdAggregate, bool block, bool runtimeArrayed);
+    void addStructType(TextBuffer& out, std::string& name, const llvm::Type* structType, const llvm::MDNode* mdAggregate, bool block, bool runtimeArrayed);
     void mapVariableName(const llvm::Value* value, std::string& name);
     void mapExpressionString(const llvm::Value* value, const std::string& name);
     bool getExpressionString(const llvm::Value* value, std::string& name) const;
@@ -642,41 +599,41 @@ public:
     void makeExtractElementStr(const llvm::Instruction* llvmInstruction, std::string& str);
     void mapPointerExpression(const llvm::Value* ptr, const llvm::Value* additionalToMap = 0);
 
-    void emitGlaIntrinsic(std::ostringstream&, const llvm::IntrinsicInst*);
-    void emitGlaCall(std::ostringstream&, const llvm::CallInst*);
-    void emitGlaPrecision(std::ostringstream&, EMdPrecision precision);
-    void emitComponentCountToSwizzle(std::ostringstream&, int numComponents);
-    void emitComponentToSwizzle(std::ostringstream&, int component);
-    void emitMaskToSwizzle(std::ostringstream&, int mask);
-    void emitGlaSamplerFunction(std::ostringstream&, const llvm::IntrinsicInst* llvmInstruction, int texFlags);
+    void emitGlaIntrinsic(TextBuffer&, const llvm::IntrinsicInst*);
+    void emitGlaCall(TextBuffer&, const llvm::CallInst*);
+    void emitGlaPrecision(TextBuffer&, EMdPrecision precision);
+    void emitComponentCountToSwizzle(TextBuffer&, int numComponents);
+    void emitComponentToSwizzle(TextBuffer&, int component);
+    void emitMaskToSwizzle(TextBuffer&, int mask);
+    void emitGlaSamplerFunction(TextBuffer&, const llvm::IntrinsicInst* llvmInstruction, int texFlags);
     void emitNamelessConstDeclaration(const llvm::Value*, const llvm::Constant*);
     void emitVariableDeclaration(EMdPrecision precision, llvm::Type* type, const std::string& name, EVariableQualifier qualifier, 
                                  const llvm::Constant* constant = 0, const llvm::MDNode* mdIoNode = 0);
-    int emitGlaType(std::ostringstream& out, EMdPrecision precision, EVariableQualifier qualifier, llvm::Type* type, 
+    int emitGlaType(TextBuffer& out, EMdPrecision precision, EVariableQualifier qualifier, llvm::Type* type, 
                     bool ioRoot = false, const llvm::MDNode* mdNode = 0, int count = -1, bool araryChild = false);
-    bool decodeMdTypesEmitMdQualifiers(std::ostringstream& out, bool ioRoot, const llvm::MDNode* mdNode, llvm::Type*& type, bool arrayChild, MetaType&);
-    void emitGlaArraySize(std::ostringstream&, int arraySize);
-    void emitGlaSamplerType(std::ostringstream&, const llvm::MDNode* mdSamplerNode);
+    bool decodeMdTypesEmitMdQualifiers(TextBuffer& out, bool ioRoot, const llvm::MDNode* mdNode, llvm::Type*& type, bool arrayChild, MetaType&);
+    void emitGlaArraySize(TextBuffer&, int arraySize);
+    void emitGlaSamplerType(TextBuffer&, const llvm::MDNode* mdSamplerNode);
     void emitGlaInterpolationQualifier(EVariableQualifier qualifier, EInterpolationMethod interpMethod, EInterpolationLocation interpLocation);
-    void emitGlaLayout(std::ostringstream&, gla::EMdTypeLayout layout, int location, int binding, int offset);
-    void emitGlaMdQualifiers(std::ostringstream&, unsigned qualifiers);
-    void emitGlaConstructor(std::ostringstream&, llvm::Type* type, int count = -1);
+    void emitGlaLayout(TextBuffer&, gla::EMdTypeLayout layout, int location, int binding, int offset);
+    void emitGlaMdQualifiers(TextBuffer&, unsigned qualifiers);
+    void emitGlaConstructor(TextBuffer&, llvm::Type* type, int count = -1);
     void emitGlaValueDeclaration(const llvm::Value* value, const char* rhs, bool forceGlobal = false);
-    void emitGlaValue(std::ostringstream&, const llvm::Value* value, const char* rhs);
-    void emitGlaOperand(std::ostringstream&, const llvm::Value* value);
-    void emitNonconvertedGlaValue(std::ostringstream&, const llvm::Value* value);
+    void emitGlaValue(TextBuffer&, const llvm::Value* value, const char* rhs);
+    void emitGlaOperand(TextBuffer&, const llvm::Value* value);
+    void emitNonconvertedGlaValue(TextBuffer&, const llvm::Value* value);
     void propagateNonconvertedGlaValue(const llvm::Value* dst, const llvm::Value* src);
-    std::string* mapGlaValueAndEmitDeclaration(const llvm::Value* value);
-    void emitFloatConstant(std::ostringstream& out, float f);
-    void emitConstantInitializer(std::ostringstream&, const llvm::Constant* constant, llvm::Type* type);
-    void emitInitializeAggregate(std::ostringstream&, std::string name, const llvm::Constant* constant);
-    void emitGlaSwizzle(std::ostringstream&, int glaSwizzle, int width, llvm::Value* source = 0);
-    void emitGlaSwizzle(std::ostringstream&, const llvm::SmallVectorImpl<llvm::Constant*>& elts);
-    void emitGlaWriteMask(std::ostringstream&, const llvm::SmallVectorImpl<llvm::Constant*>& elts);
+    const char* mapGlaValueAndEmitDeclaration(const llvm::Value* value);
+    void emitFloatConstant(TextBuffer& out, float f);
+    void emitConstantInitializer(TextBuffer&, const llvm::Constant* constant, llvm::Type* type);
+    void emitInitializeAggregate(TextBuffer&, std::string name, const llvm::Constant* constant);
+    void emitGlaSwizzle(TextBuffer&, int glaSwizzle, int width, llvm::Value* source = 0);
+    void emitGlaSwizzle(TextBuffer&, const llvm::SmallVectorImpl<llvm::Constant*>& elts);
+    void emitGlaWriteMask(TextBuffer&, const llvm::SmallVectorImpl<llvm::Constant*>& elts);
     int getDefinedCount(const llvm::SmallVectorImpl<llvm::Constant*>& elts);
-    void emitVectorArguments(std::ostringstream&, bool &firstArg, const llvm::IntrinsicInst *inst, int operand);
-    void emitGlaMultiInsertRHS(std::ostringstream& out, const llvm::IntrinsicInst* inst);
-    void emitGlaMultiInsert(std::ostringstream& out, const llvm::IntrinsicInst* inst);
+    void emitVectorArguments(TextBuffer&, bool &firstArg, const llvm::IntrinsicInst *inst, int operand);
+    void emitGlaMultiInsertRHS(TextBuffer& out, const llvm::IntrinsicInst* inst);
+    void emitGlaMultiInsert(TextBuffer& out, const llvm::IntrinsicInst* inst);
     void emitMapGlaIOIntrinsic(const llvm::IntrinsicInst* llvmInstruction, bool input);
     void emitInvariantDeclarations(llvm::Module&);
     void buildFullShader();
@@ -692,9 +649,16 @@ public:
 
         const llvm::ConstantExpr *constantGep = llvm::dyn_cast<const llvm::ConstantExpr>(gep);
         if (constantGep) {
+            // Materialize each constant expression only once; the same one is typically
+            // referenced from many places (e.g., every access to a uniform block member)
+            std::map<const llvm::ConstantExpr*, llvm::Instruction*>::const_iterator it = constantExprInstMap.find(constantGep);
+            if (it != constantExprInstMap.end())
+                return llvm::dyn_cast<llvm::GetElementPtrInst>(it->second);
+
             // seems LLVM's "Instruction *ConstantExpr::getAsInstruction()" is declared wrong that constantGEP can't be const
             llvm::Instruction *instruction = const_cast<llvm::ConstantExpr*>(constantGep)->getAsInstruction();
             toDelete.push_back(instruction);
+            constantExprInstMap[constantGep] = instruction;
             gepInst = llvm::dyn_cast<llvm::GetElementPtrInst>(instruction);
         }
 
@@ -711,6 +675,7 @@ public:
     bool isaGEPLoad(const llvm::Value*);
     void remapGEPs(const llvm::Value*);
     int getSubstitutionLevel() const { return substitutionLevel; }
+    void recordSubstitution(lunarglass::SubstitutionRule rule) { ++substitutions.decisions[static_cast<size_t>(rule)]; }
 
     // set of all IO mdNodes in the noStaticUse list
     std::set<const llvm::MDNode*> noStaticUseSet;
@@ -721,14 +686,17 @@ public:
     // list of llvm Values to free on exit
     std::vector<llvm::Value*> toDelete;
 
-    // mapping from LLVM values to Glsl variables
-    std::map<const llvm::Value*, std::string*> valueMap;
+    // constant expressions materialized by getGepAsInst(), each owned by toDelete
+    std::map<const llvm::ConstantExpr*, llvm::Instruction*> constantExprInstMap;
+
+    // mapping from LLVM values to Glsl variables; the text lives as long as the target
+    ValueStringMap valueMap;
 
     // mapping of the string representation of a constant's initializer to a const variable name;
     std::map<std::string, const std::string*> constMap;
 
     // all names that came from hashing, to ensure uniqueness
-    std::set<std::string> hashedNames;
+    HashedNameMap hashedNames;
 
     std::map<std::string, int> canonMap;
 
@@ -736,7 +704,7 @@ public:
     std::map<std::string, const llvm::MDNode*> mdMap;
 
     // For uint/matrix I/O names that need conversion, preserve the non-converted expression.
-    std::map<const llvm::Value*, std::string*> nonConvertedMap;
+    ValueStringMap nonConvertedMap;
 
     // map to track block names tracked in the module
     std::map<const llvm::Type*, std::string> blockNameMap;
@@ -763,14 +731,14 @@ public:
     // map from name in metadata to the actual built-in variable name in GLSL
     std::map<std::string, std::string> builtInMap;
 
-    std::ostringstream globalStructures;
-    std::ostringstream globalDeclarations;
-    std::ostringstream globalInitializers;
-    std::ostringstream fullShader;
+    TextBuffer globalStructures;
+    TextBuffer globalDeclarations;
+    TextBuffer globalInitializers;
     bool appendInitializers;
-    std::ostringstream shader;
+    TextBuffer shader;
     int indentLevel;
     int lastVariable;
+    int obfuscatedLineCount;
     int version;
     EProfile profile;
     EShLanguage stage;
@@ -785,7 +753,7 @@ public:
 // based on the entire statement.  Or, the entire right-hand side could just be 
 // mapped as a forward substitution.
 //
-class Assignment : public std::ostringstream {
+class Assignment : public TextBuffer {
 public:
     Assignment(gla::GlslTarget* target, const llvm::Instruction* instruction) : target(*target), instruction(instruction), lvalue(true) { }
 
@@ -793,7 +761,7 @@ public:
     {
         if (member.size() > 0) {
             // emit a declaration, no assignment
-            if (target.valueMap.find(instruction) == target.valueMap.end()) {
+            if (! target.valueMap.contains(instruction)) {
                 target.newLine();
                 target.emitGlaValue(target.shader, instruction, str().c_str());
                 target.shader << ";";
@@ -843,31 +811,34 @@ public:
     void mapOrEmit(bool increasesData, bool needsParens)
     {
         if (target.getSubstitutionLevel() == 0 || cantMap()) {
+            target.recordSubstitution(target.getSubstitutionLevel() == 0 ? lunarglass::SubstitutionRule::SubstitutionDisabled : lunarglass::SubstitutionRule::CantMap);
             emit();
             return;
         }
 
-        bool doSubstitute = true;
+        // The first rule that decides is the one that gets counted
+        lunarglass::SubstitutionRule rule = lunarglass::SubstitutionRule::CheapExpression;
 
         if (! target.cheapExpression(str())) {
 
             if (target.getSubstitutionLevel() < 2)
-                doSubstitute = false;
-
-            if (doSubstitute && str().size() > 120)
-                doSubstitute = false;
-
-            if (doSubstitute && target.modifiesPrecision(instruction))
-                doSubstitute = false;
-
-            if (doSubstitute && target.valueMap.find(instruction) != target.valueMap.end())
-                doSubstitute = false;
-
-            if (doSubstitute && ! increasesData && ! target.shouldSubstitute(instruction))
-                doSubstitute = false;
+                rule = lunarglass::SubstitutionRule::SubstitutionLevel;
+            else if (str().size() > 120)
+                rule = lunarglass::SubstitutionRule::TooLong;
+            else if (target.modifiesPrecision(instruction))
+                rule = lunarglass::SubstitutionRule::ModifiesPrecision;
+            else if (target.valueMap.contains(instruction))
+                rule = lunarglass::SubstitutionRule::AlreadyMapped;
+            else if (increasesData)
+                rule = lunarglass::SubstitutionRule::IncreasesData;
+            else if (target.shouldSubstitute(instruction))
+                rule = lunarglass::SubstitutionRule::SingleUse;
+            else
+                rule = lunarglass::SubstitutionRule::MultipleUses;
         }
 
-        if (doSubstitute)
+        target.recordSubstitution(rule);
+        if (lunarglass::is_substituting_rule(rule))
             map(needsParens);
         else
             emit();
@@ -927,7 +898,7 @@ bool IsIdentitySwizzle(const llvm::SmallVectorImpl<llvm::Constant*>& elts)
 }
 
 // Create the start of a scalar/vector conversion, but not for matrices.
-void ConversionStart(std::ostringstream& out, llvm::Type* type, bool toIO)
+void ConversionStart(TextBuffer& out, llvm::Type* type, bool toIO)
 {
     // an l-value argument still needs converting, but we need to dereference
     // its pointer first
@@ -950,7 +921,7 @@ void ConversionStart(std::ostringstream& out, llvm::Type* type, bool toIO)
     }
 }
 
-void ConversionStop(std::ostringstream& out, llvm::Type* type)
+void ConversionStop(TextBuffer& out, llvm::Type* type)
 {
     // an l-value argument still needs converting, but we need to dereference
     // its pointer first
@@ -968,7 +939,7 @@ void ConversionStop(std::ostringstream& out, llvm::Type* type)
 // integer means doing unsigned/signed conversion, if false, then doing matrix/array conversion
 void ConversionWrap(std::string& name, llvm::Type* type, bool toIO)
 {
-    std::ostringstream wrapped;
+    TextBuffer wrapped;
 
     if (IsInteger(type)) {
         ConversionStart(wrapped, type, toIO);
@@ -1491,33 +1462,6 @@ bool NeedsComponentArg(const llvm::IntrinsicInst* llvmInstruction)
     return (texFlags & ETFComponentArg) != 0;
 }
 
-void MakeParseable(std::string& name)
-{
-    // LLVM uses "." for phi'd symbols, change to _ so it's parseable by GLSL
-    // Also, glslang uses @ for an internal name.
-    // If the name changes, add a "__goo" so that it's not coincidentally a user name.
-
-    bool changed = false;
-    // bool hasDoubleUnderscore = false; // use this once "__" is accepted everywhere
-    for (int c = 0; c < (int)name.length(); ++c) {
-        if (name[c] == '.' || name[c] == '-' || name[c] == '@') {
-            name[c] = '_';
-            changed = true;
-        }
-
-        if (c > 0 && name[c-1] == '_' && name[c] == '_') {
-            // TODO: cleanliness: want to only say:  hasDoubleUnderscore = true;
-            // but, for now change things because not all compilers accept "__".
-            // Use "_" when possible, because it is much more readable.
-            name[c] = 'u';
-        }
-    }
-
-    // use this once "__" is accepted everywhere
-    //if (changed && ! hasDoubleUnderscore)
-    //    name.append("_goo");
-}
-
 void MakeNonbuiltinName(std::string& name)
 {
     // TODO: cleanliness: switch to using "__" when all compilers accept it.
@@ -1775,7 +1719,7 @@ void gla::GlslTarget::addIoDeclaration(gla::EVariableQualifier qualifier, const
     int arraySize = emitGlaType(globalDeclarations, EMpCount, qualifier, 0, true, mdNode);
     globalDeclarations << " " << instanceName;
     emitGlaArraySize(globalDeclarations, arraySize);
-    globalDeclarations << ";" << std::endl;
+    globalDeclarations << ";\n";
 }
 
 void gla::GlslTarget::startFunctionDeclaration(const llvm::Type* type, llvm::StringRef name)
@@ -1826,11 +1770,19 @@ void gla::GlslTarget::addInstruction(const llvm::Instruction* llvmInstruction, b
     std::string charOp;
     int unaryOperand = -1;
 
+    // Operands may have been added already by the recursion below, count each instruction once.
+    // Texture operations are counted in emitGlaSamplerFunction.
+    if (! valueMap.contains(llvmInstruction)) {
+        lunarglass::detail::CostCategory category = lunarglass::detail::get_cost_category(*llvmInstruction);
+        if (category != lunarglass::detail::CostCategory::Texture)
+            lunarglass::detail::add_cost(cost, category);
+    }
+
     // TODO: loops: This loop will disappear when conditional loops in BottomToGLSL properly updates valueMap
     for (llvm::Instruction::const_op_iterator i = llvmInstruction->op_begin(), e = llvmInstruction->op_end(); i != e; ++i) {
         llvm::Instruction* inst = llvm::dyn_cast<llvm::Instruction>(*i);
         if (inst) {
-            if (valueMap.find(*i) == valueMap.end())
+            if (! valueMap.contains(*i))
                 addInstruction(inst, lastBlock);
         }
     }
@@ -2042,7 +1994,7 @@ void gla::GlslTarget::addInstruction(const llvm::Instruction* llvmInstruction, b
     {
         // We want phis to use the same variable name created during phi declaration
         if (llvm::isa<llvm::PHINode>(llvmInstruction->getOperand(0))) {
-            mapExpressionString(llvmInstruction, *valueMap[llvmInstruction->getOperand(0)]);
+            valueMap.alias(llvmInstruction, llvmInstruction->getOperand(0));
 
             return;
         }
@@ -2068,20 +2020,23 @@ void gla::GlslTarget::addInstruction(const llvm::Instruction* llvmInstruction, b
         assert(llvm::isa<llvm::PointerType>(target->getType()));
 
         const llvm::GetElementPtrInst* gepInstr = getGepAsInst(target);
+        // The instruction of a constant GEP is shared by every access through it, so whatever an earlier
+        // store mapped it to must not be picked up here; rebuild its expression each time instead
+        bool constantGep = gepInstr && gepInstr != target;
         if (gepInstr)
             target = gepInstr;
         std::string dummyExpression;  // The expression could be conversion wrapped, so we won't actually use it
-        if (! getExpressionString(target, dummyExpression)) {
+        if (constantGep || ! getExpressionString(target, dummyExpression)) {
             // it could be an embedded GEP
             mapPointerExpression(target);
         }
 
-        std::ostringstream expression;
-        std::map<const llvm::Value*, std::string*>::const_iterator it = nonConvertedMap.find(target);
-        if (it != nonConvertedMap.end())
+        TextBuffer expression;
+        const char* nonConverted = nonConvertedMap.find(target);
+        if (nonConverted)
             ConversionStart(expression, target->getType()->getContainedType(0), true);
         emitGlaOperand(expression, llvmInstruction->getOperand(0));
-        if (it != nonConvertedMap.end())
+        if (nonConverted)
             ConversionStop(expression, target->getType()->getContainedType(0));
 
         const llvm::Value* src = llvmInstruction->getOperand(0);
@@ -2094,8 +2049,8 @@ void gla::GlslTarget::addInstruction(const llvm::Instruction* llvmInstruction, b
             newLine();
             // If uint/matrix IO conversions are needed, they actually have to have the
             // opposite conversion applied to the rhs.
-            if (it != nonConvertedMap.end())
-                shader << it->second->c_str();
+            if (nonConverted)
+                shader << nonConverted;
             else
                 emitGlaValue(shader, target, 0);
 
@@ -2135,7 +2090,7 @@ void gla::GlslTarget::addInstruction(const llvm::Instruction* llvmInstruction, b
             copy.emit();
 
             // second, overwrite the element being inserted
-            std::ostringstream member;
+            TextBuffer member;
             llvm::Value* element = llvmInstruction->getOperand(2);
             if (llvm::isa<llvm::Constant>(element)) {
                 member << ".";
@@ -2150,7 +2105,7 @@ void gla::GlslTarget::addInstruction(const llvm::Instruction* llvmInstruction, b
             assignment.emit();
         } else {
             newLine();
-            if (valueMap.find(llvmInstruction->getOperand(0)) == valueMap.end()) {
+            if (! valueMap.contains(llvmInstruction->getOperand(0))) {
                 emitGlaValueDeclaration(llvmInstruction->getOperand(0), 0);
                 shader << ";";
                 newLine();
@@ -2171,7 +2126,7 @@ void gla::GlslTarget::addInstruction(const llvm::Instruction* llvmInstruction, b
             emitGlaOperand(shader, llvmInstruction->getOperand(1));
             shader << ";";
 
-            mapExpressionString(llvmInstruction, *valueMap[llvmInstruction->getOperand(0)]);
+            valueMap.alias(llvmInstruction, llvmInstruction->getOperand(0));
         }
 
         return;
@@ -2238,7 +2193,7 @@ void gla::GlslTarget::addInstruction(const llvm::Instruction* llvmInstruction, b
 
         // propagate aggregate name
         // TODO: generated code correctness: probably not safe, if the partial struct has another use elsewhere
-        mapExpressionString(llvmInstruction, *valueMap[llvmInstruction->getOperand(0)]);
+        valueMap.alias(llvmInstruction, llvmInstruction->getOperand(0));
 
         return;
     }
@@ -2318,13 +2273,13 @@ bool gla::GlslTarget::needCanonicalSwap(const llvm::Instruction* instr) const
         return false;
     }
 
-    std::map<const llvm::Value*, std::string*>::const_iterator it0 = valueMap.find(instr->getOperand(0));
-    std::map<const llvm::Value*, std::string*>::const_iterator it1 = valueMap.find(instr->getOperand(1));
+    const char* operand0 = valueMap.find(instr->getOperand(0));
+    const char* operand1 = valueMap.find(instr->getOperand(1));
 
-    if (it0 == valueMap.end() || it1 == valueMap.end())
+    if (operand0 == 0 || operand1 == 0)
         return false;
 
-    return *it0->second > *it1->second;
+    return strcmp(operand0, operand1) > 0;
 }
 
 void gla::GlslTarget::declarePhiCopy(const llvm::Value* dst)
@@ -2355,6 +2310,7 @@ void gla::GlslTarget::addPhiAlias(const llvm::Value* dst, const llvm::Value* src
 
 void gla::GlslTarget::addIf(const llvm::Value* cond, bool invert)
 {
+    ++cost.branches;
     newLine();
     shader << "if (";
 
@@ -2381,6 +2337,7 @@ void gla::GlslTarget::addEndif()
 
 void gla::GlslTarget::addSwitch(const llvm::Value* cond)
 {
+    ++cost.branches;
     newLine();
     shader << "switch (";
     emitGlaOperand(shader, cond);
@@ -2427,6 +2384,7 @@ void gla::GlslTarget::beginConditionalLoop()
 
 void gla::GlslTarget::beginSimpleConditionalLoop(const llvm::CmpInst* cmp, const llvm::Value* op1, const llvm::Value* op2, bool invert)
 {
+    ++cost.loops;
     newLine();
     std::string str;
     std::string opStr;
@@ -2479,6 +2437,7 @@ void gla::GlslTarget::beginSimpleConditionalLoop(const llvm::CmpInst* cmp, const
 
 void gla::GlslTarget::beginForLoop(const llvm::PHINode* phi, llvm::ICmpInst::Predicate predicate, unsigned bound, unsigned increment)
 {
+    ++cost.loops;
     newLine();
 
     shader << "for ( ; ";
@@ -2508,6 +2467,7 @@ void gla::GlslTarget::beginForLoop(const llvm::PHINode* phi, llvm::ICmpInst::Pre
 
 void gla::GlslTarget::beginSimpleInductiveLoop(const llvm::PHINode* phi, const llvm::Value* count)
 {
+    ++cost.loops;
     newLine();
 
     shader << "for (";
@@ -2533,6 +2493,7 @@ void gla::GlslTarget::beginInductiveLoop()
 
 void gla::GlslTarget::beginLoop()
 {
+    ++cost.loops;
     newLine();
     shader << "while (true) ";
 
@@ -2581,17 +2542,15 @@ void gla::GlslTarget::end(llvm::Module& module)
     emitInvariantDeclarations(module);
 
     buildFullShader();
-    delete generatedShader;
-    generatedShader = new char[fullShader.str().size() + 1];
-    strcpy(generatedShader, fullShader.str().c_str());
-
-    delete indexShader;
-    indexShader = new char[shader.str().size() + 1];
-    strcpy(indexShader, shader.str().c_str());
+    hasShader = true;
 }
 
 void gla::GlslTarget::buildFullShader()
 {
+    // The body is only materialized once (as the index shader) and the full shader is
+    // assembled in place, rather than going through another stream and copying it out
+    TextBuffer fullShader;
+
     // #version...
     fullShader << "#version " << version;
     if (version >= 150 && profile != ENoProfile) {
@@ -2604,7 +2563,7 @@ void gla::GlslTarget::buildFullShader()
             break;
         }
     }
-    fullShader << std::endl;
+    fullShader << "\n";
 
     // Comment line about LunarGOO
     fullShader << "// LunarGOO output";
@@ -2614,19 +2573,25 @@ void gla::GlslTarget::buildFullShader()
     //    fullShader << " (r" << GLA_REVISION << ")", GLA_REVISION;
     if (obfuscate)
         fullShader << " obuscated";
-    fullShader << std::endl;
+    fullShader << "\n";
 
     // Extensions
     for (std::set<std::string>::const_iterator extIt  = manager->getRequestedExtensions().begin(); 
                                                extIt != manager->getRequestedExtensions().end(); ++extIt)
-           fullShader << "#extension " << *extIt << " : enable" << std::endl;
+           fullShader << "#extension " << *extIt << " : enable\n";
 
     // Default precision    
     if (stage == EShLangFragment && profile == EEsProfile)
-        fullShader << "precision mediump float; // this will be almost entirely overridden by individual declarations" << std::endl;
-
-    // Body of shader
-    fullShader << globalStructures.str().c_str() << globalDeclarations.str().c_str() << shader.str().c_str();
+        fullShader << "precision mediump float; // this will be almost entirely overridden by individual declarations\n";
+
+    // Body of shader; every segment is copied exactly once, straight into the result
+    indexShader = shader.take();
+    const std::string& header = fullShader.str();
+    const std::string& structures = globalStructures.str();
+    const std::string& declarations = globalDeclarations.str();
+    generatedShader.clear();
+    generatedShader.reserve(header.size() + structures.size() + declarations.size() + indexShader.size());
+    generatedShader.append(header).append(structures).append(declarations).append(indexShader);
 }
 
 void gla::GlslTarget::print()
@@ -2641,15 +2606,14 @@ bool gla::GlslTarget::filteringIoNode(const llvm::MDNode* mdNode)
 
 void gla::GlslTarget::newLine()
 {
-    static int count = 0;
     if (obfuscate) {
-        ++count;
-        if (count > 4) {
-            shader << std::endl;
-            count = 0;
+        ++obfuscatedLineCount;
+        if (obfuscatedLineCount > 4) {
+            shader << "\n";
+            obfuscatedLineCount = 0;
         }
     } else {
-        shader << std::endl;
+        shader << "\n";
         for (int i = 0; i < indentLevel; ++i)
             shader << indentString;
     }
@@ -2668,7 +2632,7 @@ void gla::GlslTarget::leaveScope()
     shader << "}";
 }
 
-void gla::GlslTarget::addStructType(std::ostringstream& out, std::string& name, const llvm::Type* structType, const llvm::MDNode* mdAggregate, bool block, bool runtimeArrayed)
+void gla::GlslTarget::addStructType(TextBuffer& out, std::string& name, const llvm::Type* structType, const llvm::MDNode* mdAggregate, bool block, bool runtimeArrayed)
 {
     // this is mutually recursive with emitGlaType
 
@@ -2699,7 +2663,7 @@ void gla::GlslTarget::addStructType(std::ostringstream& out, std::string& name,
     // before the containing one.  So, make the current on the side
     // and add it to the global results after its contents are
     // declared.
-    std::ostringstream tempStructure;
+    TextBuffer tempStructure;
 
     if (! block)
         tempStructure << "struct ";
@@ -2707,7 +2671,7 @@ void gla::GlslTarget::addStructType(std::ostringstream& out, std::string& name,
         tempStructure << std::string(mdAggregate->getOperand(0)->getName());
     else
         tempStructure << name;
-    tempStructure << " {" << std::endl;
+    tempStructure << " {\n";
 
     int lastIndex = (int)structType->getNumContainedTypes() - 1;
     for (int index = 0; index <= lastIndex; ++index) {
@@ -2724,12 +2688,12 @@ void gla::GlslTarget::addStructType(std::ostringstream& out, std::string& name,
             tempStructure << " " << MapGlaStructField(structType, index);
             emitGlaArraySize(tempStructure, arraySize);
         }
-        tempStructure << ";" << std::endl;
+        tempStructure << ";\n";
     }
 
     tempStructure << "}";
     if (! block && name.size() > 0)
-        tempStructure << ";" << std::endl;
+        tempStructure << ";\n";
 
     if (block)
         globalDeclarations << tempStructure.str();
@@ -2754,18 +2718,7 @@ void gla::GlslTarget::mapVariableName(const llvm::Value* value, std::string& nam
 // expected to be a legal variable name.
 void gla::GlslTarget::mapExpressionString(const llvm::Value* value, const std::string& name)
 {
-    std::map<const llvm::Value*, std::string*>::const_iterator it = valueMap.find(value);
-    if (it != valueMap.end()) {
-        // If the mapping is already established, don't do anything
-        if (*it->second == name)
-            return;
-
-        // There are a few places that want to replace the mapping
-        delete it->second;
-    }
-
-    // Make a copy so caller can pass in temporary variables
-    valueMap[value] = new std::string(name);
+    MapExpressionString(valueMap, value, name);
 }
 
 // Look up a previous (supposedly) mapping from Value to string.
@@ -2773,11 +2726,8 @@ void gla::GlslTarget::mapExpressionString(const llvm::Value* value, const std::s
 // Return true if found, false if guessing.
 bool gla::GlslTarget::getExpressionString(const llvm::Value* value, std::string& name) const
 {
-    std::map<const llvm::Value*, std::string*>::const_iterator it = valueMap.find(value);
-    if (it != valueMap.end()) {
-        name = *it->second;
+    if (FindExpressionString(valueMap, value, name))
         return true;
-    }
 
     // Emulate the missing name.
     name = value->getName();
@@ -2860,12 +2810,8 @@ void gla::GlslTarget::makeNewVariableName(const char* base, std::string& name)
 
 void gla::GlslTarget::makeHashName(const char* prefix, const char* key, std::string& name)
 {
-    name.append(prefix);
-    IntToString(_Hash_seq((const unsigned char*)key, strlen(key)), name);
-    while (hashedNames.find(name) != hashedNames.end())
-        name.append("r");
-    hashedNames.insert(name);
-} 
+    MakeHashName(prefix, key, name, hashedNames);
+}
 
 void gla::GlslTarget::makeObfuscatedName(std::string& name)
 {
@@ -2893,27 +2839,7 @@ void gla::GlslTarget::makeObfuscatedName(std::string& name)
 // and always getting the same name now (replacing numbers added by LLVM).
 void gla::GlslTarget::canonicalizeName(std::string& name)
 {
-    // throw away starting from the first '.'
-    int dotPos = name.find('.');
-    if (dotPos != std::string::npos)
-        name.resize(dotPos);
-
-    // remove any existing end counting and .i type things
-    int pos = name.size() - 1;
-    while (pos > 0 && name[pos] >= '0' && name[pos] <= '9')
-        --pos;
-
-    name.resize(pos + 1);
-    if (name.size() == 0)
-        name = "_L";
-
-    std::map<std::string, int>::iterator it = canonMap.find(name);
-    if (it  == canonMap.end())
-        canonMap[name] = 0;
-    else {
-        ++it->second;
-        IntToString(it->second, name);
-    }
+    CanonicalizeName(name, canonMap);
 }
 
 // Makes a string representation for the given swizzling ExtractElement
@@ -2924,12 +2850,12 @@ void gla::GlslTarget::makeExtractElementStr(const llvm::Instruction* llvmInstruc
     if (! llvm::isa<llvm::ExtractElementInst>(llvmInstruction))
         return;
 
-    str.assign(*valueMap[llvmInstruction->getOperand(0)]);
+    str.assign(valueMap.get(llvmInstruction->getOperand(0)));
     llvm::Value* element = llvmInstruction->getOperand(1);
     if (llvm::isa<llvm::Constant>(element))
         str.append(".").append(MapComponentToSwizzleChar(GetConstantInt(llvmInstruction->getOperand(1))));
     else
-        str.append("[").append(*valueMap[element]).append("]");
+        str.append("[").append(valueMap.get(element)).append("]");
 }
 
 // Turn a gep instruction or pointer for load operand into a full GLSL expression
@@ -3000,9 +2926,9 @@ void gla::GlslTarget::mapPointerExpression(const llvm::Value* ptr, const llvm::V
         // Keep the non-converted version.  L-values need this.  Also useful as an optimization if
         // at a future point we can tell the non-converted one is okay; e.g., a matrix
         // dereference never had to be constructed into an array of arrays
-        nonConvertedMap[ptr] = new std::string(expression);
+        nonConvertedMap.set(ptr, expression);
         if (additionalToMap)
-            nonConvertedMap[additionalToMap] = new std::string(expression);
+            nonConvertedMap.alias(additionalToMap, ptr);
         ConversionWrap(expression, ptr->getType()->getContainedType(0), false);
     }
 
@@ -3014,7 +2940,7 @@ void gla::GlslTarget::mapPointerExpression(const llvm::Value* ptr, const llvm::V
 //
 // Handle the subcase of an LLVM instruction being an intrinsic call.
 //
-void gla::GlslTarget::emitGlaIntrinsic(std::ostringstream& out, const llvm::IntrinsicInst* llvmInstruction)
+void gla::GlslTarget::emitGlaIntrinsic(TextBuffer& out, const llvm::IntrinsicInst* llvmInstruction)
 {
     // Handle pipeline read/write, array length, and non-gla intrinsics
     switch (llvmInstruction->getIntrinsicID()) {
@@ -3267,7 +3193,7 @@ void gla::GlslTarget::emitGlaIntrinsic(std::ostringstream& out, const llvm::Intr
                     llvm::Constant* offset = llvm::dyn_cast<llvm::Constant>(llvmInstruction->getOperand(GetTextureOpIndex(ETOOffset) + i));
                     emitConstantInitializer(globalDeclarations, offset, offset->getType());
                 }
-                globalDeclarations << ");" << std::endl;
+                globalDeclarations << ");\n";
 
                 // consume the new const
                 assignment << ", ";
@@ -3308,7 +3234,7 @@ void gla::GlslTarget::emitGlaIntrinsic(std::ostringstream& out, const llvm::Intr
 
         int dstVectorWidth = 0;
         if (! AreAllDefined(mask)) {
-            std::ostringstream mask;
+            TextBuffer mask;
             emitGlaWriteMask(mask, elts);
             assignment.setMember(mask.str().c_str());
             dstVectorWidth = getDefinedCount(elts);
@@ -3687,10 +3613,10 @@ void gla::GlslTarget::emitGlaIntrinsic(std::ostringstream& out, const llvm::Intr
         newLine();
         emitGlaValue(out, llvmInstruction, 0);
         out << "; ";
-        out << valueMap[llvmInstruction]->c_str() << ".member0";
+        out << valueMap.get(llvmInstruction) << ".member0";
         out << " = " << callString << "(";
         emitGlaOperand(out, llvmInstruction->getOperand(0));
-        out << ", " << valueMap[llvmInstruction]->c_str() << ".member1" << ");";
+        out << ", " << valueMap.get(llvmInstruction) << ".member1" << ");";
         return;
         
     case llvm::Intrinsic::gla_addCarry:
@@ -3698,12 +3624,12 @@ void gla::GlslTarget::emitGlaIntrinsic(std::ostringstream& out, const llvm::Intr
         newLine();
         emitGlaValue(out, llvmInstruction, 0);
         out << "; ";
-        out << valueMap[llvmInstruction]->c_str() << ".member0";
+        out << valueMap.get(llvmInstruction) << ".member0";
         out << " = " << callString << "(";
         emitGlaOperand(out, llvmInstruction->getOperand(0));
         out << ", ";
         emitGlaOperand(out, llvmInstruction->getOperand(1));
-        out << ", " << valueMap[llvmInstruction]->c_str() << ".member1" << ");";
+        out << ", " << valueMap.get(llvmInstruction) << ".member1" << ");";
         return;
 
     case llvm::Intrinsic::gla_umulExtended:
@@ -3715,8 +3641,8 @@ void gla::GlslTarget::emitGlaIntrinsic(std::ostringstream& out, const llvm::Intr
         emitGlaOperand(out, llvmInstruction->getOperand(0));
         out << ", ";
         emitGlaOperand(out, llvmInstruction->getOperand(1));
-        out << ", " << valueMap[llvmInstruction]->c_str() << ".member0";
-        out << ", " << valueMap[llvmInstruction]->c_str() << ".member1" << ");";
+        out << ", " << valueMap.get(llvmInstruction) << ".member0";
+        out << ", " << valueMap.get(llvmInstruction) << ".member1" << ");";
         return;
     }
 
@@ -3766,7 +3692,7 @@ void gla::GlslTarget::emitGlaIntrinsic(std::ostringstream& out, const llvm::Intr
 //
 // Handle real function calls.
 //
-void gla::GlslTarget::emitGlaCall(std::ostringstream& out, const llvm::CallInst* call)
+void gla::GlslTarget::emitGlaCall(TextBuffer& out, const llvm::CallInst* call)
 {
     newLine();
     emitGlaValue(out, call, 0);
@@ -3780,7 +3706,7 @@ void gla::GlslTarget::emitGlaCall(std::ostringstream& out, const llvm::CallInst*
     out << ");";
 }
 
-void gla::GlslTarget::emitGlaPrecision(std::ostringstream& out, EMdPrecision precision)
+void gla::GlslTarget::emitGlaPrecision(TextBuffer& out, EMdPrecision precision)
 {
     switch (precision) {
     case EMpLow:
@@ -3798,7 +3724,7 @@ void gla::GlslTarget::emitGlaPrecision(std::ostringstream& out, EMdPrecision pre
     }   
 }
 
-void gla::GlslTarget::emitComponentCountToSwizzle(std::ostringstream& out, int numComponents)
+void gla::GlslTarget::emitComponentCountToSwizzle(TextBuffer& out, int numComponents)
 {
     out << ".";
 
@@ -3813,12 +3739,12 @@ void gla::GlslTarget::emitComponentCountToSwizzle(std::ostringstream& out, int n
     }
 }
 
-void gla::GlslTarget::emitComponentToSwizzle(std::ostringstream& out, int component)
+void gla::GlslTarget::emitComponentToSwizzle(TextBuffer& out, int component)
 {
     out << MapComponentToSwizzleChar(component);
 }
 
-void gla::GlslTarget::emitMaskToSwizzle(std::ostringstream& out, int mask)
+void gla::GlslTarget::emitMaskToSwizzle(TextBuffer& out, int mask)
 {
     out << ".";
 
@@ -3827,8 +3753,10 @@ void gla::GlslTarget::emitMaskToSwizzle(std::ostringstream& out, int mask)
             out << MapComponentToSwizzleChar(component);
 }
 
-void gla::GlslTarget::emitGlaSamplerFunction(std::ostringstream& out, const llvm::IntrinsicInst* llvmInstruction, int texFlags)
+void gla::GlslTarget::emitGlaSamplerFunction(TextBuffer& out, const llvm::IntrinsicInst* llvmInstruction, int texFlags)
 {
+    ++cost.textureOps;
+
     const llvm::Value* samplerType = llvmInstruction->getOperand(0);
 
     // TODO: uint functionality: See if it's a uint sampler, requiring a constructor to convert it
@@ -3903,7 +3831,7 @@ void gla::GlslTarget::emitGlaSamplerFunction(std::ostringstream& out, const llvm
 
 void gla::GlslTarget::emitNamelessConstDeclaration(const llvm::Value* value, const llvm::Constant* constant)
 {
-    std::ostringstream constString;
+    TextBuffer constString;
     emitConstantInitializer(constString, constant, constant->getType());
     
     std::string name;
@@ -3941,7 +3869,7 @@ void gla::GlslTarget::emitNamelessConstDeclaration(const llvm::Value* value, con
     emitGlaArraySize(globalDeclarations, arraySize);
     globalDeclarations << " = ";
     globalDeclarations << constString.str();
-    globalDeclarations << ";" << std::endl;
+    globalDeclarations << ";\n";
 }
 
 void gla::GlslTarget::emitVariableDeclaration(EMdPrecision precision, llvm::Type* type, const std::string& name, EVariableQualifier qualifier, 
@@ -3962,7 +3890,7 @@ void gla::GlslTarget::emitVariableDeclaration(EMdPrecision precision, llvm::Type
         emitGlaArraySize(globalDeclarations, arraySize);
         globalDeclarations << " = ";
         emitConstantInitializer(globalDeclarations, constant, constant->getType());
-        globalDeclarations << ";" << std::endl;
+        globalDeclarations << ";\n";
 
         return;
     }
@@ -3982,7 +3910,7 @@ void gla::GlslTarget::emitVariableDeclaration(EMdPrecision precision, llvm::Type
         arraySize = emitGlaType(globalDeclarations, precision, qualifier, type);
         globalDeclarations << " " << name;
         emitGlaArraySize(globalDeclarations, arraySize);
-        globalDeclarations << ";" << std::endl;
+        globalDeclarations << ";\n";
         break;
     case EVQTemporary:
         arraySize = emitGlaType(shader, precision, qualifier, type);
@@ -3993,14 +3921,14 @@ void gla::GlslTarget::emitVariableDeclaration(EMdPrecision precision, llvm::Type
         arraySize = emitGlaType(globalDeclarations, precision, qualifier, type);
         globalDeclarations << " " << name;
         emitGlaArraySize(globalDeclarations, arraySize);
-        globalDeclarations << ";" << std::endl;
+        globalDeclarations << ";\n";
         break;
     }
 }
 
 // Emits the type.  Done recursively, either directly or indirectly through addStructType().
 // Returns the array size of the type.
-int gla::GlslTarget::emitGlaType(std::ostringstream& out, EMdPrecision precision, EVariableQualifier qualifier, llvm::Type* type, 
+int gla::GlslTarget::emitGlaType(TextBuffer& out, EMdPrecision precision, EVariableQualifier qualifier, llvm::Type* type, 
                                  bool ioRoot, const llvm::MDNode* mdNode, int count, bool arrayChild)
 {
     MetaType metaType;
@@ -4117,7 +4045,7 @@ int gla::GlslTarget::emitGlaType(std::ostringstream& out, EMdPrecision precision
 
 // Process the mdNode, decoding all type information and emitting qualifiers.
 // Returning false means there was a problem.
-bool gla::GlslTarget::decodeMdTypesEmitMdQualifiers(std::ostringstream& out, bool ioRoot, const llvm::MDNode* mdNode, llvm::Type*& type, bool arrayChild, MetaType& metaType)
+bool gla::GlslTarget::decodeMdTypesEmitMdQualifiers(TextBuffer& out, bool ioRoot, const llvm::MDNode* mdNode, llvm::Type*& type, bool arrayChild, MetaType& metaType)
 {
     EMdTypeLayout typeLayout;
     int location;
@@ -4200,13 +4128,13 @@ bool gla::GlslTarget::decodeMdTypesEmitMdQualifiers(std::ostringstream& out, boo
     return true;
 }
 
-void gla::GlslTarget::emitGlaArraySize(std::ostringstream& out, int arraySize)
+void gla::GlslTarget::emitGlaArraySize(TextBuffer& out, int arraySize)
 {
     if (arraySize > 0)
         out << "[" << arraySize << "]";
 }
 
-void gla::GlslTarget::emitGlaSamplerType(std::ostringstream& out, const llvm::MDNode* mdSamplerNode)
+void gla::GlslTarget::emitGlaSamplerType(TextBuffer& out, const llvm::MDNode* mdSamplerNode)
 {
     EMdSampler mdSampler;
     llvm::Type* type;
@@ -4276,7 +4204,7 @@ void gla::GlslTarget::emitGlaInterpolationQualifier(EVariableQualifier qualifier
     }
 }
 
-void gla::GlslTarget::emitGlaLayout(std::ostringstream& out, gla::EMdTypeLayout layout, int location, int binding, int offset)
+void gla::GlslTarget::emitGlaLayout(TextBuffer& out, gla::EMdTypeLayout layout, int location, int binding, int offset)
 {
     const char* layoutStr = 0;
 
@@ -4340,7 +4268,7 @@ void gla::GlslTarget::emitGlaLayout(std::ostringstream& out, gla::EMdTypeLayout
     out << ") ";
 }
 
-void gla::GlslTarget::emitGlaMdQualifiers(std::ostringstream& out, unsigned qualifiers)
+void gla::GlslTarget::emitGlaMdQualifiers(TextBuffer& out, unsigned qualifiers)
 {
     if (qualifiers == 0)
         return;
@@ -4358,7 +4286,7 @@ void gla::GlslTarget::emitGlaMdQualifiers(std::ostringstream& out, unsigned qual
     }
 }
 
-void gla::GlslTarget::emitGlaConstructor(std::ostringstream& out, llvm::Type* type, int count)
+void gla::GlslTarget::emitGlaConstructor(TextBuffer& out, llvm::Type* type, int count)
 {
     int arraySize = emitGlaType(out, EMpNone, EVQNone, type, false, 0, count);
     emitGlaArraySize(out, arraySize);
@@ -4368,7 +4296,7 @@ void gla::GlslTarget::emitGlaConstructor(std::ostringstream& out, llvm::Type* ty
 // If forceGlobal is true, then it will make the declaration occur as a global.
 void gla::GlslTarget::emitGlaValueDeclaration(const llvm::Value* value, const char* rhs, bool forceGlobal)
 {
-    if (valueMap.find(value) != valueMap.end())
+    if (valueMap.contains(value))
         return;
 
     // Figure out where our declaration should go
@@ -4387,6 +4315,9 @@ void gla::GlslTarget::emitGlaValueDeclaration(const llvm::Value* value, const ch
         return;
     }
 
+    if (evq == gla::EVQTemporary || forceGlobal)
+        ++cost.temporaries;
+
     std::string newName;
     makeNewVariableName(value, newName, rhs);
     mapVariableName(value, newName);
@@ -4404,29 +4335,30 @@ void gla::GlslTarget::emitGlaValueDeclaration(const llvm::Value* value, const ch
     }
 }
 
-void gla::GlslTarget::emitGlaValue(std::ostringstream& out, const llvm::Value* value, const char* rhs)
+void gla::GlslTarget::emitGlaValue(TextBuffer& out, const llvm::Value* value, const char* rhs)
 {
     assert(! llvm::isa<llvm::ConstantExpr>(value));
     emitGlaValueDeclaration(value, rhs);
-    out << valueMap[value]->c_str();
+    out << valueMap.get(value);
 }
 
-void gla::GlslTarget::emitGlaOperand(std::ostringstream& out, const llvm::Value* value)
+void gla::GlslTarget::emitGlaOperand(TextBuffer& out, const llvm::Value* value)
 {
     // If an operand needs a declaration, it can only be something declared elsewhere,
     // not in line here.
     emitGlaValueDeclaration(value, 0);
-    out << valueMap[value]->c_str();
+    out << valueMap.get(value);
 }
 
 // Called when it is known safe to emit a name that has not been converted
 // (converted from I/O types to internal types).
 // If there is a non-converted version, emit it, otherwise just emit
 // the normal one.
-void gla::GlslTarget::emitNonconvertedGlaValue(std::ostringstream& out, const llvm::Value* value)
+void gla::GlslTarget::emitNonconvertedGlaValue(TextBuffer& out, const llvm::Value* value)
 {
-    if (nonConvertedMap.find(value) != nonConvertedMap.end())
-        out << nonConvertedMap[value]->c_str();
+    const char* nonConverted = nonConvertedMap.find(value);
+    if (nonConverted)
+        out << nonConverted;
     else
         emitGlaValue(out, value, 0);
 }
@@ -4434,31 +4366,28 @@ void gla::GlslTarget::emitNonconvertedGlaValue(std::ostringstream& out, const ll
 // Propagate a nonconverted form from one value to another
 void gla::GlslTarget::propagateNonconvertedGlaValue(const llvm::Value* dst, const llvm::Value* src)
 {
-    if (nonConvertedMap.find(src) != nonConvertedMap.end())
-        nonConvertedMap[dst] = new std::string(*nonConvertedMap[src]);  // rare enough to not worry about sharing the pointer (they all get deleted)
+    if (nonConvertedMap.contains(src))
+        nonConvertedMap.alias(dst, src);
 }
 
-std::string* gla::GlslTarget::mapGlaValueAndEmitDeclaration(const llvm::Value* value)
+const char* gla::GlslTarget::mapGlaValueAndEmitDeclaration(const llvm::Value* value)
 {
     emitGlaValueDeclaration(value, 0);
 
-    return valueMap[value];
+    return valueMap.get(value);
 }
 
-void gla::GlslTarget::emitFloatConstant(std::ostringstream& out, float f)
+void gla::GlslTarget::emitFloatConstant(TextBuffer& out, float f)
 {
-    if (floor(f) == f) {
-        out << static_cast<int>(floor(f));
-        out << ".0";
-    } else
-        out << f;
+    // uintBitsToFloat came with GLSL 3.30 and ESSL 3.00
+    EmitFloatConstant(out, f, profile == EEsProfile ? version >= 300 : version >= 330);
 }
 
 // emitConstantInitializer will be called recursively for aggregate types.
 // If the aggregate is zero initialized, sub-elements will not have a
 // constant associated with them. For that case, and for ConstantAggregateZero,
 // we only use the type to generate correct initializers.
-void gla::GlslTarget::emitConstantInitializer(std::ostringstream& out, const llvm::Constant* constant, llvm::Type* type)
+void gla::GlslTarget::emitConstantInitializer(TextBuffer& out, const llvm::Constant* constant, llvm::Type* type)
 {
     bool isZero;
 
@@ -4499,6 +4428,15 @@ void gla::GlslTarget::emitConstantInitializer(std::ostringstream& out, const llv
             break;
         }
 
+    case llvm::Type::DoubleTyID:
+        {
+            if (isZero)
+                EmitDoubleConstant(out, 0.0);
+            else
+                EmitDoubleConstant(out, llvm::cast<llvm::ConstantFP>(constant)->getValueAPF().convertToDouble());
+            break;
+        }
+
     case llvm::Type::VectorTyID:
     case llvm::Type::ArrayTyID:
     case llvm::Type::StructTyID:
@@ -4568,34 +4506,34 @@ void gla::GlslTarget::emitConstantInitializer(std::ostringstream& out, const llv
     }
 }
 
-void gla::GlslTarget::emitInitializeAggregate(std::ostringstream& out, std::string name, const llvm::Constant* constant)
+void gla::GlslTarget::emitInitializeAggregate(TextBuffer& out, std::string name, const llvm::Constant* constant)
 {
     if (constant && IsDefined(constant) && ! IsScalar(constant) && ! AreAllDefined(constant)) {
         // For a vector or array with undefined elements, propagate the defined elements
         if (const llvm::ConstantVector* constVec = llvm::dyn_cast<llvm::ConstantVector>(constant)) {
             for (int op = 0; op < (int)constVec->getNumOperands(); ++op) {
                 if (IsDefined(constVec->getOperand(op))) {
-                    out << std::endl << indentString << name;
+                    out << "\n" << indentString << name;
                     out << "." << MapComponentToSwizzleChar(op) << " = ";
-                    out << *mapGlaValueAndEmitDeclaration(constVec->getOperand(op));
+                    out << mapGlaValueAndEmitDeclaration(constVec->getOperand(op));
                     out << ";";
                 }
             }
         } else if (const llvm::ConstantArray* constArray = llvm::dyn_cast<llvm::ConstantArray>(constant)) {
             for (int op = 0; op < (int)constArray->getNumOperands(); ++op) {
                 if (IsDefined(constArray->getOperand(op))) {
-                    out << std::endl << indentString << name;
+                    out << "\n" << indentString << name;
                     out << "[" << op << "] = ";
-                    out << *mapGlaValueAndEmitDeclaration(constArray->getOperand(op));
+                    out << mapGlaValueAndEmitDeclaration(constArray->getOperand(op));
                     out << ";";
                 }
             }
         } else if (const llvm::ConstantStruct* constStruct = llvm::dyn_cast<llvm::ConstantStruct>(constant)) {
             for (int op = 0; op < (int)constStruct->getNumOperands(); ++op) {
                 if (IsDefined(constStruct->getOperand(op))) {
-                    out << std::endl << indentString << name;
+                    out << "\n" << indentString << name;
                     out << "." << MapGlaStructField(constant->getType(), op) << " = ";
-                    out << *mapGlaValueAndEmitDeclaration(constStruct->getOperand(op));
+                    out << mapGlaValueAndEmitDeclaration(constStruct->getOperand(op));
                     out << ";";
                 }
             }
@@ -4607,7 +4545,7 @@ void gla::GlslTarget::emitInitializeAggregate(std::ostringstream& out, std::stri
     }
 }
 
-void gla::GlslTarget::emitGlaSwizzle(std::ostringstream& out, int glaSwizzle, int width, llvm::Value* source)
+void gla::GlslTarget::emitGlaSwizzle(TextBuffer& out, int glaSwizzle, int width, llvm::Value* source)
 {
     if (source && gla::IsScalar(source))
         return;
@@ -4619,7 +4557,7 @@ void gla::GlslTarget::emitGlaSwizzle(std::ostringstream& out, int glaSwizzle, in
 }
 
 // Emit the swizzle represented by the vector of channel selections
-void gla::GlslTarget::emitGlaSwizzle(std::ostringstream& out, const llvm::SmallVectorImpl<llvm::Constant*>& elts)
+void gla::GlslTarget::emitGlaSwizzle(TextBuffer& out, const llvm::SmallVectorImpl<llvm::Constant*>& elts)
 {
     out << ".";
 
@@ -4634,7 +4572,7 @@ void gla::GlslTarget::emitGlaSwizzle(std::ostringstream& out, const llvm::SmallV
 
 // Emit a writemask. Emits a component for each defined element of the
 // passed vector.
-void gla::GlslTarget::emitGlaWriteMask(std::ostringstream& out, const llvm::SmallVectorImpl<llvm::Constant*>& elts)
+void gla::GlslTarget::emitGlaWriteMask(TextBuffer& out, const llvm::SmallVectorImpl<llvm::Constant*>& elts)
 {
     out << ".";
 
@@ -4661,7 +4599,7 @@ int gla::GlslTarget::getDefinedCount(const llvm::SmallVectorImpl<llvm::Constant*
 
 // Writes out the vector arguments for the RHS of a multiInsert. Sets its
 // first argument to false upon first execution
-void gla::GlslTarget::emitVectorArguments(std::ostringstream& out, bool &firstArg, const llvm::IntrinsicInst *inst, int operand)
+void gla::GlslTarget::emitVectorArguments(TextBuffer& out, bool &firstArg, const llvm::IntrinsicInst *inst, int operand)
 {
     if (firstArg)
         firstArg = false;
@@ -4677,7 +4615,7 @@ void gla::GlslTarget::emitVectorArguments(std::ostringstream& out, bool &firstAr
     }
 }
 
-void gla::GlslTarget::emitGlaMultiInsertRHS(std::ostringstream& out, const llvm::IntrinsicInst* inst)
+void gla::GlslTarget::emitGlaMultiInsertRHS(TextBuffer& out, const llvm::IntrinsicInst* inst)
 {
     int wmask = GetConstantInt(inst->getOperand(1));
     assert(wmask <= 0xF);
@@ -4723,7 +4661,7 @@ void gla::GlslTarget::emitGlaMultiInsertRHS(std::ostringstream& out, const llvm:
     }
 }
 
-void gla::GlslTarget::emitGlaMultiInsert(std::ostringstream& out, const llvm::IntrinsicInst* inst)
+void gla::GlslTarget::emitGlaMultiInsert(TextBuffer& out, const llvm::IntrinsicInst* inst)
 {
     int wmask = GetConstantInt(inst->getOperand(1));
 
@@ -4747,7 +4685,7 @@ void gla::GlslTarget::emitGlaMultiInsert(std::ostringstream& out, const llvm::In
     Assignment expression(this, inst);
 
     // Add the lhs swizzle    
-    std::ostringstream lhsSwizzle;
+    TextBuffer lhsSwizzle;
     emitMaskToSwizzle(lhsSwizzle, wmask);
     expression.setMember(lhsSwizzle.str().c_str());
 
@@ -4809,7 +4747,7 @@ void gla::GlslTarget::emitMapGlaIOIntrinsic(const llvm::IntrinsicInst* llvmInstr
     {
         llvm::Value* value = llvmInstruction->getOperand(2);
         emitGlaValueDeclaration(value, 0);
-        std::string wrapped = *valueMap[value];
+        std::string wrapped = valueMap.get(value);
         if (notSigned)
             ConversionWrap(wrapped, value->getType(), true);
         newLine();
@@ -4939,7 +4877,7 @@ void gla::GlslTarget::dereferenceGep(const llvm::Type*& type, std::string& name,
             snprintf(buf, bufSize, "%d", index);
             name.append(buf);
         } else
-            name.append(*mapGlaValueAndEmitDeclaration(operand));
+            name.append(mapGlaValueAndEmitDeclaration(operand));
 
         name.append("]");
 
@@ -4975,7 +4913,7 @@ void gla::GlslTarget::dereferenceGep(const llvm::Type*& type, std::string& name,
             name.append(buf);
         } else {
             name.append("[");
-            name.append(*mapGlaValueAndEmitDeclaration(operand));
+            name.append(mapGlaValueAndEmitDeclaration(operand));
             name.append("]");
         }
         break;
@@ -4990,52 +4928,7 @@ void gla::GlslTarget::dereferenceGep(const llvm::Type*& type, std::string& name,
 // can be forward substituted.
 bool gla::GlslTarget::cheapExpression(const std::string& expression)
 {
-    int c = expression[0];
-
-    // Skip over unary stuff...
-    int pos;
-    for (pos = 0; pos < (int)expression.size(); ++pos) {
-        int c = expression[pos];
-        bool breakLoop = false;
-        switch (c) {
-        case '+':
-        case '-':
-        case '(':
-        case '_':
-            break;
-        default:
-            breakLoop = true;
-            break;
-        }
-        if (breakLoop)
-            break;
-    }
-
-    int startPos;
-    do {
-        startPos = pos;
-
-        // Skip over name
-        for (; pos < (int)expression.size(); ++pos) {
-            int c = expression[pos];
-            if (ValidIdentChar(c))
-                continue;
-            else
-                break;
-        }
-
-        // Skip over indexes/members/etc., but not more opening expressions (constructors, etc.)
-        for (; pos < (int)expression.size(); ++pos) {
-            int c = expression[pos];
-            if (c == '.' || c == '[' || c == ']' || c == ')' ||
-                (c > '0' && c < '9'))
-                continue;
-            else
-                break;
-        }
-    } while (pos > startPos);
-
-    return pos == expression.size();
+    return CheapExpression(expression);
 }
 
 // Heuristically decide if this is something that should be 
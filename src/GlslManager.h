@@ -64,6 +64,9 @@ public:
         gla::ReleaseGlslBackEnd(backEnd);
     }
 
+    // Resets the per-module state, including the LLVM context: named struct types are
+    // uniqued per context ("Light", "Light.0", ...), so a shared context would make the
+    // output of a module depend on the modules translated before it.  The back end survives.
     virtual void clear()
     {
         freeNonreusable();
@@ -78,6 +81,10 @@ public:
 
     const char* getGeneratedShader() { return glslBackEndTranslator->getGeneratedShader(); }
     const char* getIndexShader() { return glslBackEndTranslator->getIndexShader(); }
+    // Hands over the generated shader without copying it; getGeneratedShader() returns 0 afterwards
+    std::string takeGeneratedShader() { return glslBackEndTranslator->takeGeneratedShader(); }
+    const lunarglass::ShaderCost& getCost() const { return glslBackEndTranslator->getCost(); }
+    const lunarglass::SubstitutionStats& getSubstitutionStats() const { return glslBackEndTranslator->getSubstitutionStats(); }
 
 protected:
     void createNonreusable()
@@ -0,0 +1,467 @@
+//===- GlslTargetUtil.cpp - String helpers of the GLSL back end -------------===//
+//
+// LunarGLASS: An Open Modular Shader Compiler Architecture
+// Copyright (C) 2010-2014 LunarG, Inc.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 
+//     Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//     Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials provided
+//     with the distribution.
+// 
+//     Neither the name of LunarG Inc. nor the names of its
+//     contributors may be used to endorse or promote products derived
+//     from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//===----------------------------------------------------------------------===//
+//
+// Author: John Kessenich, LunarG
+//
+//===----------------------------------------------------------------------===//
+
+#include "GlslTargetUtil.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <cassert>
+
+bool gla::ValidIdentChar(int c)
+{
+    return c == '_' || 
+           (c >= 'a' && c <= 'z') ||
+           (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9');
+}
+
+namespace {
+
+// 64x64 -> 128 bit multiply, with both halves folded back into 64 bits
+unsigned long long MultiplyFold(unsigned long long a, unsigned long long b)
+{
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 product = (unsigned __int128)a * b;
+
+    return (unsigned long long)product ^ (unsigned long long)(product >> 64);
+#else
+    unsigned long long aLow = a & 0xffffffffull, aHigh = a >> 32;
+    unsigned long long bLow = b & 0xffffffffull, bHigh = b >> 32;
+    unsigned long long lowLow = aLow * bLow;
+    unsigned long long highLow = aHigh * bLow;
+    unsigned long long cross = (lowLow >> 32) + (highLow & 0xffffffffull) + aLow * bHigh;
+    unsigned long long high = aHigh * bHigh + (highLow >> 32) + (cross >> 32);
+    unsigned long long low = (cross << 32) | (lowLow & 0xffffffffull);
+
+    return low ^ high;
+#endif
+}
+
+// Up to 8 bytes as a little-endian word, so hashes don't depend on the host
+unsigned long long ReadWord(const unsigned char* bytes, size_t count)
+{
+    unsigned long long word = 0;
+    for (size_t i = 0; i < count; ++i)
+        word |= (unsigned long long)bytes[i] << (8 * i);
+
+    return word;
+}
+
+};
+
+// Multiply-fold hash in the style of wyhash, consuming 16 bytes per step
+unsigned long long gla::HashSequence(const unsigned char* first, size_t count)
+{
+    const unsigned long long secret0 = 0xa0761d6478bd642full;
+    const unsigned long long secret1 = 0xe7037ed1a0b428dbull;
+    const unsigned long long secret2 = 0x8ebc6af09c88c6e3ull;
+    const unsigned long long secret3 = 0x589965cc75374cc3ull;
+
+    unsigned long long seed = secret0 ^ count;
+    size_t remaining = count;
+    while (remaining > 16) {
+        seed = MultiplyFold(ReadWord(first, 8) ^ secret1, ReadWord(first + 8, 8) ^ seed);
+        first += 16;
+        remaining -= 16;
+    }
+
+    unsigned long long a = ReadWord(first, remaining < 8 ? remaining : 8);
+    unsigned long long b = remaining > 8 ? ReadWord(first + 8, remaining - 8) : 0;
+
+    return MultiplyFold(secret1 ^ count, MultiplyFold(a ^ secret2, b ^ seed ^ secret3));
+}
+
+void gla::IntToString(unsigned long long i, std::string& string)
+{
+    // 13 base-36 digits cover 64 bits
+    char buf[16];
+    int length = 0;
+    const unsigned int radix = 36;
+    while (i > 0) {
+        unsigned int r = (unsigned int)(i % radix);
+        if (r < 10)
+            buf[length++] = '0' + r;
+        else
+            buf[length++] = 'a' + r - 10;
+        i = i / radix;
+    }
+    string.append(buf, length);
+}
+
+void gla::MakeParseable(std::string& name)
+{
+    // LLVM uses "." for phi'd symbols, change to _ so it's parseable by GLSL
+    // Also, glslang uses @ for an internal name.
+    // If the name changes, add a "__goo" so that it's not coincidentally a user name.
+
+    bool changed = false;
+    // bool hasDoubleUnderscore = false; // use this once "__" is accepted everywhere
+    for (int c = 0; c < (int)name.length(); ++c) {
+        if (name[c] == '.' || name[c] == '-' || name[c] == '@') {
+            name[c] = '_';
+            changed = true;
+        }
+
+        if (c > 0 && name[c-1] == '_' && name[c] == '_') {
+            // TODO: cleanliness: want to only say:  hasDoubleUnderscore = true;
+            // but, for now change things because not all compilers accept "__".
+            // Use "_" when possible, because it is much more readable.
+            name[c] = 'u';
+        }
+    }
+
+    // use this once "__" is accepted everywhere
+    //if (changed && ! hasDoubleUnderscore)
+    //    name.append("_goo");
+}
+
+// See if an expression string does not contain any operations
+// that would be expensive to replicate, to aid in identifying what
+// can be forward substituted.
+bool gla::CheapExpression(const std::string& expression)
+{
+    int c = expression[0];
+
+    // Skip over unary stuff...
+    int pos;
+    for (pos = 0; pos < (int)expression.size(); ++pos) {
+        int c = expression[pos];
+        bool breakLoop = false;
+        switch (c) {
+        case '+':
+        case '-':
+        case '(':
+        case '_':
+            break;
+        default:
+            breakLoop = true;
+            break;
+        }
+        if (breakLoop)
+            break;
+    }
+
+    int startPos;
+    do {
+        startPos = pos;
+
+        // Skip over name
+        for (; pos < (int)expression.size(); ++pos) {
+            int c = expression[pos];
+            if (ValidIdentChar(c))
+                continue;
+            else
+                break;
+        }
+
+        // Skip over indexes/members/etc., but not more opening expressions (constructors, etc.)
+        for (; pos < (int)expression.size(); ++pos) {
+            int c = expression[pos];
+            if (c == '.' || c == '[' || c == ']' || c == ')' ||
+                (c > '0' && c < '9'))
+                continue;
+            else
+                break;
+        }
+    } while (pos > startPos);
+
+    return pos == expression.size();
+}
+
+// Make variable names more predictable across runs, compromising
+// between preserving the original name (which might have included a number)
+// and always getting the same name now (replacing numbers added by LLVM).
+void gla::CanonicalizeName(std::string& name, std::map<std::string, int>& canonMap)
+{
+    // throw away starting from the first '.'
+    int dotPos = name.find('.');
+    if (dotPos != std::string::npos)
+        name.resize(dotPos);
+
+    // remove any existing end counting and .i type things
+    int pos = name.size() - 1;
+    while (pos > 0 && name[pos] >= '0' && name[pos] <= '9')
+        --pos;
+
+    name.resize(pos + 1);
+    if (name.size() == 0)
+        name = "_L";
+
+    std::map<std::string, int>::iterator it = canonMap.find(name);
+    if (it  == canonMap.end())
+        canonMap[name] = 0;
+    else {
+        ++it->second;
+        IntToString(it->second, name);
+    }
+}
+
+void gla::MakeHashName(const char* prefix, const char* key, std::string& name, HashedNameMap& hashedNames)
+{
+    name.append(prefix);
+    IntToString(HashSequence((const unsigned char*)key, strlen(key)), name);
+    MakeUniqueName(name, hashedNames);
+}
+
+void gla::MakeUniqueName(std::string& name, HashedNameMap& hashedNames)
+{
+    // The same (or a colliding) name was made before: number the repeats in the
+    // order they are requested, which keeps the names deterministic.  A prefix may
+    // contain '_' and digits itself, so a numbered name can still match one made
+    // from another prefix; skip numbers until it is unique, and record it so that
+    // a later name can't take it either.
+    std::pair<HashedNameMap::iterator, bool> inserted = hashedNames.insert(HashedNameMap::value_type(name, 0));
+    if (! inserted.second) {
+        // references to elements stay valid when the map rehashes
+        unsigned int& repeats = inserted.first->second;
+        const size_t baseLength = name.size();
+
+        // GLSL reserves "__", so a name that already ends in '_' (the prefix, when
+        // the hash text is empty) takes the number without another separator
+        const bool separate = baseLength == 0 || name[baseLength - 1] != '_';
+        do {
+            name.resize(baseLength);
+            if (separate)
+                name.append("_");
+            IntToString(++repeats, name);
+        } while (! hashedNames.insert(HashedNameMap::value_type(name, 0)).second);
+    }
+}
+
+namespace {
+
+// Shortest text that reads back as exactly 'value' (std::to_chars without a
+// precision), so downstream compilers see the same bits the optimizer produced
+template<typename T>
+void EmitShortestFloat(gla::TextBuffer& out, T value, const char* suffix)
+{
+    char digits[64];
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+    out.append(digits, result.ptr - digits);
+
+    // Whole numbers come out as "2" or "-0", which would be integer literals
+    bool isInteger = true;
+    for (const char* c = digits; c != result.ptr; ++c) {
+        if (*c == '.' || *c == 'e') {
+            isInteger = false;
+            break;
+        }
+    }
+    if (isInteger)
+        out << ".0";
+    out << suffix;
+}
+
+};
+
+// GLSL has no literals for infinity and NaN, so they are built from their bit
+// patterns. Division by zero is undefined in GLSL, some drivers fold 1.0/0.0 to 0.
+void gla::EmitFloatConstant(TextBuffer& out, float f, bool bitCasts)
+{
+    if (std::isinf(f) || std::isnan(f)) {
+        if (bitCasts) {
+            out << "uintBitsToFloat(" << (std::isnan(f) ? "0x7fc00000u" : (f < 0 ? "0xff800000u" : "0x7f800000u")) << ")";
+            return;
+        }
+
+        // Without uintBitsToFloat, the divisions are the only way to spell them
+        out << (std::isnan(f) ? "(0.0/0.0)" : (f < 0 ? "(-1.0/0.0)" : "(1.0/0.0)"));
+        return;
+    }
+
+    EmitShortestFloat(out, f, "");
+}
+
+void gla::EmitDoubleConstant(TextBuffer& out, double d)
+{
+    // Every version with doubles has packDouble2x32; The high word comes second
+    if (std::isinf(d) || std::isnan(d)) {
+        out << "packDouble2x32(uvec2(0u, " << (std::isnan(d) ? "0x7ff80000u" : (d < 0 ? "0xfff00000u" : "0x7ff00000u")) << "))";
+        return;
+    }
+
+    EmitShortestFloat(out, d, "lf");
+}
+
+void gla::TextBuffer::appendSigned(long long i)
+{
+    char digits[24];
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), i);
+    text.append(digits, result.ptr - digits);
+}
+
+void gla::TextBuffer::appendUnsigned(unsigned long long i)
+{
+    char digits[24];
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), i);
+    text.append(digits, result.ptr - digits);
+}
+
+void gla::TextBuffer::appendFloat(double d)
+{
+    // std::to_chars is locale independent and, given a precision, formats like printf
+    char digits[32];
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), d, std::chars_format::general, 6);
+    text.append(digits, result.ptr - digits);
+}
+
+gla::ValueStringMap::ValueStringMap() : slots(64), count(0), chunkUsed(0), chunkSize(0)
+{
+    for (size_t i = 0; i < slots.size(); ++i)
+        slots[i].key = 0;
+}
+
+gla::ValueStringMap::~ValueStringMap()
+{
+    for (size_t i = 0; i < chunks.size(); ++i)
+        delete[] chunks[i];
+}
+
+// Returns the slot holding 'key', or the free slot it would go into
+gla::ValueStringMap::Entry* gla::ValueStringMap::findSlot(const llvm::Value* key) const
+{
+    // Fibonacci hashing; the low bits of heap addresses carry little information
+    const size_t mask = slots.size() - 1;
+    size_t index = static_cast<size_t>((reinterpret_cast<unsigned long long>(key) * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+    for (;;) {
+        const Entry& entry = slots[index];
+        if (entry.key == key || entry.key == 0)
+            return const_cast<Entry*>(&entry);
+        index = (index + 1) & mask;
+    }
+}
+
+const char* gla::ValueStringMap::find(const llvm::Value* value) const
+{
+    const Entry* entry = findSlot(value);
+
+    return entry->key ? entry->text : 0;
+}
+
+const char* gla::ValueStringMap::get(const llvm::Value* value) const
+{
+    const Entry* entry = findSlot(value);
+    assert(entry->key);
+
+    return entry->text;
+}
+
+void gla::ValueStringMap::insert(const llvm::Value* key, const char* text, size_t length)
+{
+    Entry* entry = findSlot(key);
+    if (entry->key == 0) {
+        // Keep the load factor at or below one half, so probe sequences stay short
+        if ((count + 1) * 2 > slots.size()) {
+            grow();
+            entry = findSlot(key);
+        }
+        entry->key = key;
+        ++count;
+    }
+    entry->text = text;
+    entry->length = length;
+}
+
+void gla::ValueStringMap::grow()
+{
+    std::vector<Entry> oldSlots(slots.size() * 2);
+    oldSlots.swap(slots);
+    for (size_t i = 0; i < slots.size(); ++i)
+        slots[i].key = 0;
+    for (size_t i = 0; i < oldSlots.size(); ++i) {
+        if (oldSlots[i].key)
+            *findSlot(oldSlots[i].key) = oldSlots[i];
+    }
+}
+
+const char* gla::ValueStringMap::copyText(const char* text, size_t length)
+{
+    if (chunks.empty() || chunkUsed + length + 1 > chunkSize) {
+        // Chunks double up to 64KB; longer text gets a chunk of its own
+        size_t size = chunks.empty() ? 8192 : chunkSize * 2;
+        if (size > 65536)
+            size = 65536;
+        if (size < length + 1)
+            size = length + 1;
+        chunks.push_back(new char[size]);
+        chunkSize = size;
+        chunkUsed = 0;
+    }
+    char* copy = chunks.back() + chunkUsed;
+    memcpy(copy, text, length);
+    copy[length] = 0;
+    chunkUsed += length + 1;
+
+    return copy;
+}
+
+void gla::ValueStringMap::set(const llvm::Value* value, const char* text, size_t length)
+{
+    insert(value, copyText(text, length), length);
+}
+
+void gla::ValueStringMap::alias(const llvm::Value* dst, const llvm::Value* src)
+{
+    const Entry* entry = findSlot(src);
+    assert(entry->key);
+    insert(dst, entry->text, entry->length);
+}
+
+void gla::MapExpressionString(ValueStringMap& valueMap, const llvm::Value* value, const std::string& name)
+{
+    // If the mapping is already established, don't do anything
+    const char* existing = valueMap.find(value);
+    if (existing && name.compare(existing) == 0)
+        return;
+
+    // Make a copy so caller can pass in temporary variables
+    valueMap.set(value, name);
+}
+
+bool gla::FindExpressionString(const ValueStringMap& valueMap, const llvm::Value* value, std::string& name)
+{
+    const char* text = valueMap.find(value);
+    if (text == 0)
+        return false;
+
+    name = text;
+    return true;
+}
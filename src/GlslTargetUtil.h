@@ -0,0 +1,203 @@
+//===- GlslTargetUtil.h - String helpers of the GLSL back end ---------------===//
+//
+// LunarGLASS: An Open Modular Shader Compiler Architecture
+// Copyright (C) 2010-2014 LunarG, Inc.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+// 
+//     Redistributions of source code must retain the above copyright
+//     notice, this list of conditions and the following disclaimer.
+// 
+//     Redistributions in binary form must reproduce the above
+//     copyright notice, this list of conditions and the following
+//     disclaimer in the documentation and/or other materials provided
+//     with the distribution.
+// 
+//     Neither the name of LunarG Inc. nor the names of its
+//     contributors may be used to endorse or promote products derived
+//     from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//===----------------------------------------------------------------------===//
+//
+// Author: John Kessenich, LunarG
+//
+// String and naming helpers of the GLSL back end that run per instruction
+// or per name.  They don't depend on LLVM, so they can be driven directly
+// (e.g. by micro-benchmarks) without building any IR.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef GlslTargetUtil_H
+#define GlslTargetUtil_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstddef>
+#include <map>
+
+namespace llvm {
+    class Value;
+};
+
+namespace gla {
+
+// Growable text buffer the back end emits into, in place of std::ostringstream.
+// There is no locale, stream state or virtual dispatch involved, and str()
+// returns a reference rather than a copy.  Numbers are formatted exactly like
+// a default-constructed std::ostream would (floating point like "%g"), so the
+// generated text doesn't change.
+class TextBuffer {
+public:
+    TextBuffer() { }
+
+    TextBuffer& operator<<(const char* s) { text.append(s); return *this; }
+    TextBuffer& operator<<(const std::string& s) { text.append(s); return *this; }
+    TextBuffer& operator<<(const TextBuffer& other) { text.append(other.text); return *this; }
+    TextBuffer& operator<<(char c) { text.push_back(c); return *this; }
+    TextBuffer& operator<<(signed char c) { text.push_back(static_cast<char>(c)); return *this; }
+    TextBuffer& operator<<(unsigned char c) { text.push_back(static_cast<char>(c)); return *this; }
+    TextBuffer& operator<<(int i) { appendSigned(i); return *this; }
+    TextBuffer& operator<<(long i) { appendSigned(i); return *this; }
+    TextBuffer& operator<<(long long i) { appendSigned(i); return *this; }
+    TextBuffer& operator<<(unsigned int i) { appendUnsigned(i); return *this; }
+    TextBuffer& operator<<(unsigned long i) { appendUnsigned(i); return *this; }
+    TextBuffer& operator<<(unsigned long long i) { appendUnsigned(i); return *this; }
+    TextBuffer& operator<<(float f) { appendFloat(f); return *this; }
+    TextBuffer& operator<<(double d) { appendFloat(d); return *this; }
+
+    void append(const char* s, size_t length) { text.append(s, length); }
+    void reserve(size_t size) { text.reserve(size); }
+    void clear() { text.clear(); }
+    size_t size() const { return text.size(); }
+    bool empty() const { return text.empty(); }
+    const std::string& str() const { return text; }
+
+    // Hand over the text without copying it; the buffer is empty afterwards
+    std::string take()
+    {
+        std::string taken;
+        taken.swap(text);
+        return taken;
+    }
+
+protected:
+    void appendSigned(long long i);
+    void appendUnsigned(unsigned long long i);
+    // Six significant digits, like "%g"
+    void appendFloat(double d);
+
+    std::string text;
+};
+
+// Mapping from LLVM values to Glsl text; the values are only used as keys.
+//
+// Open addressing with linear probing, since lookups (one per operand of every
+// instruction) vastly outnumber insertions and nothing is ever removed.  The
+// text is copied into chunks owned by the map and released all at once with
+// the map, instead of one heap string per value.  Returned text stays valid
+// for the lifetime of the map, even if the mapping is replaced later on.
+class ValueStringMap {
+public:
+    ValueStringMap();
+    ~ValueStringMap();
+
+    // Return the null-terminated text mapped to 'value', or 0 if there is none
+    const char* find(const llvm::Value* value) const;
+    bool contains(const llvm::Value* value) const { return find(value) != 0; }
+    // Return the text mapped to 'value', which has to be mapped
+    const char* get(const llvm::Value* value) const;
+
+    // Map 'value' to a copy of 'text', replacing an existing mapping
+    void set(const llvm::Value* value, const char* text, size_t length);
+    void set(const llvm::Value* value, const std::string& text) { set(value, text.c_str(), text.size()); }
+
+    // Map 'dst' to the text of 'src' without copying it; 'src' has to be mapped
+    void alias(const llvm::Value* dst, const llvm::Value* src);
+
+    size_t size() const { return count; }
+
+protected:
+    struct Entry {
+        const llvm::Value* key;    // 0 for free slots
+        const char* text;
+        size_t length;
+    };
+
+    Entry* findSlot(const llvm::Value* key) const;
+    void insert(const llvm::Value* key, const char* text, size_t length);
+    void grow();
+    const char* copyText(const char* text, size_t length);
+
+    std::vector<Entry> slots;      // size is a power of two
+    size_t count;
+
+    // arena of the copied text
+    std::vector<char*> chunks;
+    size_t chunkUsed;
+    size_t chunkSize;
+
+private:
+    ValueStringMap(const ValueStringMap&);
+    ValueStringMap& operator=(const ValueStringMap&);
+};
+
+bool ValidIdentChar(int c);
+
+// 64-bit hash of the bytes in [first, first+count); the same on every host
+unsigned long long HashSequence(const unsigned char* first, size_t count);
+
+// Appends 'i' in base 36, least significant digit first
+void IntToString(unsigned long long i, std::string& string);
+
+// Replaces characters GLSL doesn't accept in identifiers
+void MakeParseable(std::string& name);
+
+// See if an expression string does not contain any operations
+// that would be expensive to replicate
+bool CheapExpression(const std::string& expression);
+
+// Strips LLVM's numbering from 'name' and makes it unique with respect to the
+// names already in 'canonMap'
+void CanonicalizeName(std::string& name, std::map<std::string, int>& canonMap);
+
+// every name MakeHashName() has handed out, with the number of times each was requested again
+typedef std::unordered_map<std::string, unsigned int> HashedNameMap;
+
+// Appends 'prefix' and a hash of 'key' to 'name', unique with respect to 'hashedNames'
+void MakeHashName(const char* prefix, const char* key, std::string& name, HashedNameMap& hashedNames);
+
+// Numbers 'name' if it was made before, without forming "__", and records it in 'hashedNames'
+void MakeUniqueName(std::string& name, HashedNameMap& hashedNames);
+
+// Shortest text that reads back as exactly 'f', always with a decimal point or exponent.
+// 'bitCasts' tells whether the target has uintBitsToFloat for infinity and NaN.
+void EmitFloatConstant(TextBuffer& out, float f, bool bitCasts);
+
+// Same for doubles, with the "lf" suffix
+void EmitDoubleConstant(TextBuffer& out, double d);
+
+// Add mapping for value -> expression-string; an existing mapping is replaced
+void MapExpressionString(ValueStringMap& valueMap, const llvm::Value* value, const std::string& name);
+
+// Return true and set 'name' if there is a mapping for 'value'
+bool FindExpressionString(const ValueStringMap& valueMap, const llvm::Value* value, std::string& name);
+
+} // end namespace gla
+
+#endif // GlslTargetUtil_H
@@ -44,24 +44,45 @@
 #include "Core/PrivateManager.h"
 #include "Core/Backend.h"
 
+// util_lunarglass includes
+#include "util_lunarglass/compile_stats.hpp"
+
+#include <string>
+
 namespace gla {
 
 class GlslTranslator : public BackEndTranslator {
 public:
     GlslTranslator(Manager* m, bool obfuscate, bool filterInactive, int substitutionLevel) :
         BackEndTranslator(m), obfuscate(obfuscate), filterInactive(filterInactive), substitutionLevel(substitutionLevel),
-        generatedShader(0), indexShader(0) { }
+        hasShader(false) { }
     virtual ~GlslTranslator() { }
 
-    const char* getGeneratedShader() const { return generatedShader; }
-    const char* getIndexShader() const     { return indexShader; }
+    const char* getGeneratedShader() const { return hasShader ? generatedShader.c_str() : 0; }
+    const char* getIndexShader() const     { return hasShader ? indexShader.c_str() : 0; }
+
+    // Moves the generated shader out of the translator, leaving getGeneratedShader() empty
+    std::string takeGeneratedShader()
+    {
+        hasShader = false;
+        return std::move(generatedShader);
+    }
+
+    // Operation counts of the generated shader, gathered while it was emitted
+    const lunarglass::ShaderCost& getCost() const { return cost; }
+
+    // How often each rule decided between forward substitution and a temporary
+    const lunarglass::SubstitutionStats& getSubstitutionStats() const { return substitutions; }
 
 protected:
     bool obfuscate;
     bool filterInactive;
     int substitutionLevel;
-    char* generatedShader;
-    char* indexShader;
+    bool hasShader;
+    std::string generatedShader;
+    std::string indexShader;
+    lunarglass::ShaderCost cost;
+    lunarglass::SubstitutionStats substitutions;
 };
 
 } // end namespace gla
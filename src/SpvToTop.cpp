@@ -66,6 +66,7 @@
 #include <iomanip>
 #include <stack>
 #include <list>
+#include <atomic>
 
 // Glslang includes
 #include "SPIRV/spirv.hpp"
@@ -151,7 +152,7 @@ const char* NonNullName(const char* name)
 //
 class SpvToTopTranslator {
 public:
-    SpvToTopTranslator(const std::vector<unsigned int>& spirv, gla::Manager& manager);
+    SpvToTopTranslator(const unsigned int* spirv, size_t spirvSize, gla::Manager& manager);
     virtual ~SpvToTopTranslator();
 
     void makeTop();
@@ -252,7 +253,8 @@ protected:
     llvm::MDNode* makeInputMetadata(spv::Id resultId, int slot);
 
     // class data
-    const std::vector<unsigned int>& spirv; // the SPIR-V stream of words
+    const unsigned int* spirv;              // the SPIR-V stream of words
+    size_t spirvSize;                       // number of words in the stream
     int word;                               // next word to read from spirv
     int nextInst;                           // beginning of the next instruction
     gla::Manager& manager;                  // LunarGLASS manager
@@ -296,8 +298,8 @@ protected:
     std::vector<CommonAnnotations> commonMap;
 };
 
-SpvToTopTranslator::SpvToTopTranslator(const std::vector<unsigned int>& spirv, gla::Manager& manager)
-    : spirv(spirv), word(0),
+SpvToTopTranslator::SpvToTopTranslator(const unsigned int* spirv, size_t spirvSize, gla::Manager& manager)
+    : spirv(spirv), spirvSize(spirvSize), word(0),
       manager(manager), context(manager.getModule()->getContext()),
       shaderEntry(0), llvmBuilder(context),
       module(manager.getModule()), metadata(context, module),
@@ -336,7 +338,7 @@ void SpvToTopTranslator::bumpMemberMetaData(std::vector<MetaType>*& memberMetaDa
 //
 void SpvToTopTranslator::makeTop()
 {
-    int size = (int)spirv.size();
+    int size = (int)spirvSize;
 
     // Sanity check size
     if (size < 5)
@@ -578,11 +580,9 @@ void SpvToTopTranslator::addMetaTypeDecoration(spv::Decoration decoration, MetaT
         break;
     case spv::DecorationOffset:
     {
-        static bool once = false;
-        if (! once) {
+        static std::atomic<bool> once(false);
+        if (! once.exchange(true))
             gla::UnsupportedFunctionality("member offset", gla::EATContinue);
-            once = true;
-        }
         break;
     }
 
@@ -1204,7 +1204,7 @@ const char* SpvToTopTranslator::findAName(spv::Id choice1, spv::Id choice2)
         spv::Id chain = choice1;
         int trialInst = nextInst;
         for (int i = 0; i < 200; i++) {
-            if (trialInst + 5 >= (int)spirv.size())
+            if (trialInst + 5 >= (int)spirvSize)
                 break;
             spv::Op opcode = GetOpCode(spirv[trialInst]);
             switch (opcode) {
@@ -1910,7 +1910,7 @@ spv::Id SpvToTopTranslator::getNextLabelId()
         if ((spirv[searchWord] & spv::OpCodeMask) == spv::OpLabel)
             return spirv[searchWord + 1];
         searchWord += spirv[searchWord] >> spv::WordCountShift;
-        assert(searchWord < spirv.size());
+        assert(searchWord < spirvSize);
     } while (true);
 }
 
@@ -2902,12 +2902,18 @@ namespace gla {
 
 // Translate SPIR-V to LunarGLASS Top IR
 void SpvToTop(const std::vector<unsigned int>& spirv, gla::Manager& manager)
+{
+    SpvToTop(spirv.data(), spirv.size(), manager);
+}
+
+// Same as above, but reads the words in place from caller-owned memory
+void SpvToTop(const unsigned int* spirv, size_t wordCount, gla::Manager& manager)
 {
     manager.createContext();
     llvm::Module* topModule = new llvm::Module("SPIR-V", manager.getContext());
     manager.setModule(topModule);
 
-    SpvToTopTranslator translator(spirv, manager);
+    SpvToTopTranslator translator(spirv, wordCount, manager);
     translator.makeTop();
 }
 
@@ -35,5 +35,6 @@
 namespace gla {
 
     void SpvToTop(const std::vector<unsigned int>& spirv, gla::Manager& manager);
+    void SpvToTop(const unsigned int* spirv, size_t wordCount, gla::Manager& manager);
 
 };
@@ -0,0 +1,126 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#ifdef UTIL_LUNARGLASS_TRACK_ALLOCATIONS
+
+#include "allocation_tracker.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstddef>
+#include <limits>
+#include <new>
+
+// Replaces the global allocation functions, so that LLVM, glslang and the GLSL back end are all
+// accounted for. Every block is prefixed with a header that records its size for the deallocation.
+// This is instrumentation only; It makes every allocation a little larger and slower. The build
+// links the library statically when this is enabled, since the replacement would otherwise take
+// over the allocator of every process that loads the shared library.
+
+namespace
+{
+	// Constant-initialized, so that accessing it never allocates by itself
+	thread_local lunarglass::detail::AllocationCounters g_counters {};
+
+	struct alignas(alignof(std::max_align_t)) BlockHeader
+	{
+		size_t size;
+		size_t offset; // Distance between the start of the underlying allocation and the user pointer
+	};
+
+	void on_allocate(size_t size)
+	{
+		auto &counters = g_counters;
+		++counters.count;
+		counters.bytes += size;
+		counters.current += static_cast<int64_t>(size);
+		counters.peak = std::max(counters.peak,counters.current);
+	}
+
+	// The header is placed directly in front of the user pointer, which has to keep its alignment
+	size_t get_header_offset(size_t alignment) {return ((sizeof(BlockHeader) +alignment -1) /alignment) *alignment;}
+
+	// Whether the underlying allocation of 'size' bytes, including header and padding, fits into a size_t
+	bool is_size_representable(size_t size,size_t alignment)
+	{
+		constexpr auto maxSize = std::numeric_limits<size_t>::max();
+		alignment = std::max(alignment,alignof(BlockHeader));
+		if(alignment > maxSize /4)
+			return false;
+		return size <= maxSize -get_header_offset(alignment) -(alignment -1);
+	}
+
+	void *allocate(size_t size,size_t alignment)
+	{
+		if(is_size_representable(size,alignment) == false)
+			return nullptr;
+		alignment = std::max(alignment,alignof(BlockHeader));
+		auto offset = get_header_offset(alignment);
+		auto *base = static_cast<uint8_t*>(std::malloc(size +offset +alignment -1));
+		if(base == nullptr)
+			return nullptr;
+		auto address = reinterpret_cast<uintptr_t>(base) +offset;
+		address = (address +alignment -1) &~static_cast<uintptr_t>(alignment -1);
+		auto *ptr = reinterpret_cast<uint8_t*>(address);
+		auto *header = reinterpret_cast<BlockHeader*>(ptr) -1;
+		header->size = size;
+		header->offset = static_cast<size_t>(ptr -base);
+		on_allocate(size);
+		return ptr;
+	}
+
+	void *allocate_or_throw(size_t size,size_t alignment)
+	{
+		// The size would wrap around once the header and padding are added; No new_handler can fix that
+		if(is_size_representable(size,alignment) == false)
+			throw std::bad_alloc{};
+		for(;;)
+		{
+			auto *ptr = allocate(size,alignment);
+			if(ptr)
+				return ptr;
+			auto handler = std::get_new_handler();
+			if(handler == nullptr)
+				throw std::bad_alloc{};
+			handler();
+		}
+	}
+
+	void deallocate(void *ptr)
+	{
+		if(ptr == nullptr)
+			return;
+		auto *header = static_cast<BlockHeader*>(ptr) -1;
+		g_counters.current -= static_cast<int64_t>(header->size);
+		std::free(static_cast<uint8_t*>(ptr) -header->offset);
+	}
+};
+
+lunarglass::detail::AllocationCounters &lunarglass::detail::get_thread_allocation_counters() {return g_counters;}
+
+void *operator new(size_t size) {return allocate_or_throw(size,alignof(std::max_align_t));}
+void *operator new[](size_t size) {return allocate_or_throw(size,alignof(std::max_align_t));}
+void *operator new(size_t size,const std::nothrow_t&) noexcept {return allocate(size,alignof(std::max_align_t));}
+void *operator new[](size_t size,const std::nothrow_t&) noexcept {return allocate(size,alignof(std::max_align_t));}
+void *operator new(size_t size,std::align_val_t alignment) {return allocate_or_throw(size,static_cast<size_t>(alignment));}
+void *operator new[](size_t size,std::align_val_t alignment) {return allocate_or_throw(size,static_cast<size_t>(alignment));}
+void *operator new(size_t size,std::align_val_t alignment,const std::nothrow_t&) noexcept {return allocate(size,static_cast<size_t>(alignment));}
+void *operator new[](size_t size,std::align_val_t alignment,const std::nothrow_t&) noexcept {return allocate(size,static_cast<size_t>(alignment));}
+
+void operator delete(void *ptr) noexcept {deallocate(ptr);}
+void operator delete[](void *ptr) noexcept {deallocate(ptr);}
+void operator delete(void *ptr,size_t) noexcept {deallocate(ptr);}
+void operator delete[](void *ptr,size_t) noexcept {deallocate(ptr);}
+void operator delete(void *ptr,const std::nothrow_t&) noexcept {deallocate(ptr);}
+void operator delete[](void *ptr,const std::nothrow_t&) noexcept {deallocate(ptr);}
+void operator delete(void *ptr,std::align_val_t) noexcept {deallocate(ptr);}
+void operator delete[](void *ptr,std::align_val_t) noexcept {deallocate(ptr);}
+void operator delete(void *ptr,size_t,std::align_val_t) noexcept {deallocate(ptr);}
+void operator delete[](void *ptr,size_t,std::align_val_t) noexcept {deallocate(ptr);}
+void operator delete(void *ptr,std::align_val_t,const std::nothrow_t&) noexcept {deallocate(ptr);}
+void operator delete[](void *ptr,std::align_val_t,const std::nothrow_t&) noexcept {deallocate(ptr);}
+
+#endif
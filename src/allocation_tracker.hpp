@@ -0,0 +1,29 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#ifndef __UTIL_LUNARGLASS_ALLOCATION_TRACKER_HPP__
+#define __UTIL_LUNARGLASS_ALLOCATION_TRACKER_HPP__
+
+#include <cinttypes>
+
+namespace lunarglass::detail
+{
+	// Per-thread counters of the global operator new/delete replacement. Memory that is freed on
+	// another thread than it was allocated on is subtracted from that thread's 'current'.
+	struct AllocationCounters
+	{
+		uint64_t count = 0;
+		uint64_t bytes = 0;
+		int64_t current = 0;
+		int64_t peak = 0;
+	};
+#ifdef UTIL_LUNARGLASS_TRACK_ALLOCATIONS
+	AllocationCounters &get_thread_allocation_counters();
+#endif
+};
+
+#endif
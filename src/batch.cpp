@@ -0,0 +1,74 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#include "util_lunarglass/util_lunarglass.hpp"
+#include "util_lunarglass/compiler.hpp"
+#include "util_lunarglass/compile_stats.hpp"
+#include "util_lunarglass/tracer.hpp"
+#include "lunarglass_internal.hpp"
+#include "work_stealing_pool.hpp"
+#include <algorithm>
+#include <exception>
+
+std::vector<lunarglass::BatchResult> lunarglass::optimize_glsl_batch(const std::vector<std::unordered_map<ShaderStage,std::string>> &programs,const BatchOptions &options)
+{
+	std::vector<BatchResult> results {};
+	results.resize(programs.size());
+	if(programs.empty())
+		return results;
+
+	// Initialize up front, so that the workers don't race each other for it
+	detail::initialize_process();
+
+	auto threadCount = options.threadCount;
+	if(threadCount == 0)
+		threadCount = std::max(std::thread::hardware_concurrency(),1u);
+	if(threadCount > programs.size())
+		threadCount = static_cast<uint32_t>(programs.size());
+
+	WorkStealingPool pool {threadCount};
+	// Every worker keeps a compiler session, so that the back end is reused for all programs it processes
+	std::vector<std::unique_ptr<detail::CompilerState>> sessions {};
+	sessions.reserve(pool.GetThreadCount());
+	for(auto i=decltype(pool.GetThreadCount()){0u};i<pool.GetThreadCount();++i)
+		sessions.push_back(std::make_unique<detail::CompilerState>(options.programOptions));
+	// Only ever accessed by the worker with the same index
+	std::vector<uint8_t> threadNamed(pool.GetThreadCount(),0);
+	pool.Run(programs.size(),[&programs,&options,&results,&sessions,&threadNamed](uint32_t workerIndex,size_t programIndex) {
+		auto &result = results[programIndex];
+		// A single stats object would be written to by all workers at once
+		auto programOptions = options.programOptions;
+		programOptions.stats = nullptr;
+		if(programIndex < options.programNames.size())
+			programOptions.name = options.programNames[programIndex];
+		if(programOptions.tracer && threadNamed[workerIndex] == 0)
+		{
+			programOptions.tracer->SetThreadName("lunarglass worker " +std::to_string(workerIndex));
+			threadNamed[workerIndex] = 1;
+		}
+		if(options.collectStats)
+		{
+			result.stats = std::make_shared<CompileStats>();
+			programOptions.stats = result.stats.get();
+		}
+		try
+		{
+			result.shaders = detail::optimize_glsl(detail::to_source_views(programs[programIndex]),programOptions,result.infoLog,sessions[workerIndex].get());
+		}
+		catch(const std::exception &e)
+		{
+			result.shaders = {};
+			result.infoLog = e.what();
+		}
+		catch(...)
+		{
+			result.shaders = {};
+			result.infoLog = "Unknown exception during shader optimization";
+		}
+	});
+	return results;
+}
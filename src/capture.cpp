@@ -0,0 +1,384 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#include "util_lunarglass/capture.hpp"
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <array>
+#include <type_traits>
+
+namespace
+{
+	constexpr std::array<char,8> CAPTURE_MAGIC = {'L','G','C','A','P','T','U','R'};
+	constexpr uint32_t CAPTURE_VERSION = 1;
+	constexpr uint32_t DEFAULT_LIMITS_ID = ~0u;
+
+	enum class ChunkType : uint8_t
+	{
+		Limits = 0,
+		Compile
+	};
+	enum class OptionFlags : uint8_t
+	{
+		None = 0,
+		Obfuscate = 1,
+		FilterInactive = Obfuscate<<1,
+		ParallelStages = FilterInactive<<1
+	};
+	constexpr size_t CHUNK_HEADER_SIZE = sizeof(ChunkType) +sizeof(uint32_t);
+
+#define UTIL_LUNARGLASS_COUNT_LIMIT(name,value) +1
+	constexpr uint32_t LIMIT_COUNT = 0 UTIL_LUNARGLASS_RESOURCE_LIMITS(UTIL_LUNARGLASS_COUNT_LIMIT);
+	constexpr uint32_t LIMIT_FLAG_COUNT = 0 UTIL_LUNARGLASS_RESOURCE_LIMIT_FLAGS(UTIL_LUNARGLASS_COUNT_LIMIT);
+#undef UTIL_LUNARGLASS_COUNT_LIMIT
+
+	// Integers (and enums) are stored little-endian regardless of the host, so captures can be replayed elsewhere
+	template<typename T>
+		using unsigned_integer_t = std::make_unsigned_t<typename std::conditional_t<std::is_enum_v<T>,std::underlying_type<T>,std::common_type<T>>::type>;
+	template<typename T>
+		void encode_value(uint8_t *out,const T &value)
+	{
+		auto v = static_cast<uint64_t>(static_cast<unsigned_integer_t<T>>(value));
+		for(auto i=decltype(sizeof(T)){0u};i<sizeof(T);++i)
+			out[i] = static_cast<uint8_t>(v >>(i *8));
+	}
+	template<typename T>
+		T decode_value(const uint8_t *in)
+	{
+		uint64_t v = 0;
+		for(auto i=decltype(sizeof(T)){0u};i<sizeof(T);++i)
+			v |= static_cast<uint64_t>(in[i]) <<(i *8);
+		return static_cast<T>(static_cast<unsigned_integer_t<T>>(v));
+	}
+	template<typename T>
+		void write_value(std::vector<uint8_t> &data,const T &value)
+	{
+		auto offset = data.size();
+		data.resize(offset +sizeof(value));
+		encode_value(data.data() +offset,value);
+	}
+	template<typename T>
+		bool read_value(std::istream &stream,T &outValue)
+	{
+		std::array<uint8_t,sizeof(T)> bytes;
+		if(!stream.read(reinterpret_cast<char*>(bytes.data()),bytes.size()))
+			return false;
+		outValue = decode_value<T>(bytes.data());
+		return true;
+	}
+	void write_string(std::vector<uint8_t> &data,std::string_view str)
+	{
+		write_value(data,static_cast<uint32_t>(str.size()));
+		data.insert(data.end(),str.begin(),str.end());
+	}
+	template<typename T>
+		bool read_value(const std::vector<uint8_t> &data,size_t &offset,T &outValue)
+	{
+		if(offset > data.size() || sizeof(outValue) > data.size() -offset)
+			return false;
+		outValue = decode_value<T>(data.data() +offset);
+		offset += sizeof(outValue);
+		return true;
+	}
+	bool read_string(const std::vector<uint8_t> &data,size_t &offset,std::string &outStr)
+	{
+		uint32_t size;
+		if(read_value(data,offset,size) == false || size > data.size() -offset)
+			return false;
+		outStr.assign(reinterpret_cast<const char*>(data.data() +offset),size);
+		offset += size;
+		return true;
+	}
+
+	// Reserves the chunk header, which is filled in by end_chunk once the payload is known
+	size_t begin_chunk(std::vector<uint8_t> &data,ChunkType type)
+	{
+		auto offset = data.size();
+		write_value(data,type);
+		write_value(data,uint32_t{0});
+		return offset;
+	}
+	void end_chunk(std::vector<uint8_t> &data,size_t chunkOffset)
+	{
+		auto payloadSize = static_cast<uint32_t>(data.size() -chunkOffset -CHUNK_HEADER_SIZE);
+		encode_value(data.data() +chunkOffset +sizeof(ChunkType),payloadSize);
+	}
+};
+
+std::unique_ptr<lunarglass::CaptureWriter> lunarglass::CaptureWriter::Open(const std::string &path,std::string &outErr)
+{
+	std::error_code ec;
+	auto exists = std::filesystem::exists(path,ec) && std::filesystem::file_size(path,ec) > 0;
+	if(exists)
+	{
+		// Only ever append to something that already is a capture
+		std::ifstream file {path,std::ios::binary};
+		std::array<char,8> magic {};
+		uint32_t version = 0;
+		file.read(magic.data(),magic.size());
+		if(!file || magic != CAPTURE_MAGIC || read_value(file,version) == false)
+		{
+			outErr = "File '" +path +"' exists, but is not a capture";
+			return nullptr;
+		}
+		if(version != CAPTURE_VERSION)
+		{
+			outErr = "Capture '" +path +"' has unsupported version " +std::to_string(version);
+			return nullptr;
+		}
+	}
+
+	auto writer = std::unique_ptr<CaptureWriter>{new CaptureWriter{}};
+	writer->m_file.open(path,std::ios::binary | std::ios::app);
+	if(!writer->m_file)
+	{
+		outErr = "Unable to open file '" +path +"' for writing";
+		return nullptr;
+	}
+	if(exists == false)
+	{
+		std::vector<uint8_t> header {CAPTURE_MAGIC.begin(),CAPTURE_MAGIC.end()};
+		write_value(header,CAPTURE_VERSION);
+		writer->m_file.write(reinterpret_cast<const char*>(header.data()),header.size());
+		writer->m_file.flush();
+		if(!writer->m_file)
+		{
+			outErr = "Unable to write to file '" +path +"'";
+			return nullptr;
+		}
+	}
+	return writer;
+}
+
+bool lunarglass::CaptureWriter::Record(const std::unordered_map<ShaderStage,std::string_view> &shaderStages,const Options &options)
+{
+	// Encode the compile outside of the lock; Only the limits id has to be filled in afterwards
+	std::vector<uint8_t> compileChunk {};
+	size_t sourceSize = 0;
+	for(auto &pair : shaderStages)
+		sourceSize += pair.second.size();
+	compileChunk.reserve(CHUNK_HEADER_SIZE +64 +options.name.size() +shaderStages.size() *8 +sourceSize);
+	auto chunkOffset = begin_chunk(compileChunk,ChunkType::Compile);
+	auto timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	write_value(compileChunk,static_cast<uint64_t>(timestamp));
+	write_value(compileChunk,static_cast<int32_t>(options.substitutionLevel));
+	auto flags = static_cast<uint8_t>(OptionFlags::None);
+	if(options.obfuscate)
+		flags |= static_cast<uint8_t>(OptionFlags::Obfuscate);
+	if(options.filterInactive)
+		flags |= static_cast<uint8_t>(OptionFlags::FilterInactive);
+	if(options.parallelStages)
+		flags |= static_cast<uint8_t>(OptionFlags::ParallelStages);
+	write_value(compileChunk,flags);
+	auto limitsIdOffset = compileChunk.size();
+	write_value(compileChunk,DEFAULT_LIMITS_ID);
+	write_string(compileChunk,options.name);
+	// Stages in enum order, so that identical calls produce identical records
+	write_value(compileChunk,static_cast<uint8_t>(shaderStages.size()));
+	for(auto i=0u;i<static_cast<uint32_t>(ShaderStage::Count);++i)
+	{
+		auto it = shaderStages.find(static_cast<ShaderStage>(i));
+		if(it == shaderStages.end())
+			continue;
+		write_value(compileChunk,static_cast<uint8_t>(i));
+		write_string(compileChunk,it->second);
+	}
+	end_chunk(compileChunk,chunkOffset);
+
+	std::scoped_lock lock {m_mutex};
+	// After a failed write the file may end in a partial chunk, anything appended to it would be unreadable
+	if(m_writeFailed)
+		return false;
+	if(options.resourceLimits)
+	{
+		auto &digest = options.resourceLimits->GetDigest();
+		auto it = m_limitIds.find(digest);
+		if(it == m_limitIds.end())
+		{
+			auto id = static_cast<uint32_t>(m_limitIds.size());
+			it = m_limitIds.insert({digest,id}).first;
+
+			std::vector<uint8_t> limitsChunk {};
+			auto limitsOffset = begin_chunk(limitsChunk,ChunkType::Limits);
+			write_value(limitsChunk,id);
+			write_value(limitsChunk,LIMIT_COUNT);
+			write_value(limitsChunk,LIMIT_FLAG_COUNT);
+			auto &values = options.resourceLimits->GetValues();
+#define UTIL_LUNARGLASS_WRITE_LIMIT(name,value) write_value(limitsChunk,static_cast<int32_t>(values.name));
+			UTIL_LUNARGLASS_RESOURCE_LIMITS(UTIL_LUNARGLASS_WRITE_LIMIT)
+#undef UTIL_LUNARGLASS_WRITE_LIMIT
+#define UTIL_LUNARGLASS_WRITE_LIMIT(name,value) write_value(limitsChunk,static_cast<uint8_t>(values.name));
+			UTIL_LUNARGLASS_RESOURCE_LIMIT_FLAGS(UTIL_LUNARGLASS_WRITE_LIMIT)
+#undef UTIL_LUNARGLASS_WRITE_LIMIT
+			end_chunk(limitsChunk,limitsOffset);
+			m_file.write(reinterpret_cast<const char*>(limitsChunk.data()),limitsChunk.size());
+		}
+		encode_value(compileChunk.data() +limitsIdOffset,it->second);
+	}
+	m_file.write(reinterpret_cast<const char*>(compileChunk.data()),compileChunk.size());
+	m_file.flush();
+	if(!m_file)
+	{
+		m_writeFailed = true;
+		return false;
+	}
+	++m_recordCount;
+	return true;
+}
+
+uint64_t lunarglass::CaptureWriter::GetRecordCount() const
+{
+	std::scoped_lock lock {m_mutex};
+	return m_recordCount;
+}
+
+bool lunarglass::CaptureWriter::HasWriteFailed() const
+{
+	std::scoped_lock lock {m_mutex};
+	return m_writeFailed;
+}
+
+std::unique_ptr<lunarglass::CaptureReader> lunarglass::CaptureReader::Open(const std::string &path,std::string &outErr)
+{
+	auto reader = std::unique_ptr<CaptureReader>{new CaptureReader{}};
+	reader->m_file.open(path,std::ios::binary);
+	if(!reader->m_file)
+	{
+		outErr = "Unable to open file '" +path +"'";
+		return nullptr;
+	}
+	std::array<char,8> magic {};
+	uint32_t version = 0;
+	reader->m_file.read(magic.data(),magic.size());
+	if(!reader->m_file || magic != CAPTURE_MAGIC || read_value(reader->m_file,version) == false)
+	{
+		outErr = "File '" +path +"' is not a capture";
+		return nullptr;
+	}
+	if(version != CAPTURE_VERSION)
+	{
+		outErr = "Capture '" +path +"' has unsupported version " +std::to_string(version);
+		return nullptr;
+	}
+	return reader;
+}
+
+bool lunarglass::CaptureReader::ReadNext(CaptureRecord &outRecord,std::string &outErr)
+{
+	std::vector<uint8_t> payload {};
+	for(;;)
+	{
+		ChunkType type;
+		uint32_t payloadSize;
+		if(m_file.peek() == std::char_traits<char>::eof())
+			return false; // End of the capture
+		auto complete = read_value(m_file,type) && read_value(m_file,payloadSize);
+		if(complete)
+		{
+			payload.resize(payloadSize);
+			complete = static_cast<bool>(m_file.read(reinterpret_cast<char*>(payload.data()),payloadSize));
+		}
+		if(complete == false)
+		{
+			// Most likely the recording process died while writing the last record
+			outErr = "Capture ends with a truncated record";
+			return false;
+		}
+
+		size_t offset = 0;
+		switch(type)
+		{
+		case ChunkType::Limits:
+		{
+			uint32_t id;
+			uint32_t limitCount;
+			uint32_t flagCount;
+			if(read_value(payload,offset,id) == false || read_value(payload,offset,limitCount) == false || read_value(payload,offset,flagCount) == false)
+			{
+				outErr = "Malformed resource limits record";
+				return false;
+			}
+			if(limitCount != LIMIT_COUNT || flagCount != LIMIT_FLAG_COUNT)
+			{
+				outErr = "Capture was recorded with a different set of resource limits";
+				return false;
+			}
+			ResourceLimitValues values {};
+			auto valid = true;
+#define UTIL_LUNARGLASS_READ_LIMIT(name,value) \
+			{ \
+				int32_t v = 0; \
+				valid = valid && read_value(payload,offset,v); \
+				values.name = v; \
+			}
+			UTIL_LUNARGLASS_RESOURCE_LIMITS(UTIL_LUNARGLASS_READ_LIMIT)
+#undef UTIL_LUNARGLASS_READ_LIMIT
+#define UTIL_LUNARGLASS_READ_LIMIT(name,value) \
+			{ \
+				uint8_t v = 0; \
+				valid = valid && read_value(payload,offset,v); \
+				values.name = (v != 0); \
+			}
+			UTIL_LUNARGLASS_RESOURCE_LIMIT_FLAGS(UTIL_LUNARGLASS_READ_LIMIT)
+#undef UTIL_LUNARGLASS_READ_LIMIT
+			if(valid == false)
+			{
+				outErr = "Malformed resource limits record";
+				return false;
+			}
+			m_limits[id] = std::make_shared<ResourceLimits>(values);
+			break;
+		}
+		case ChunkType::Compile:
+		{
+			CaptureRecord record {};
+			int32_t substitutionLevel;
+			uint8_t flags;
+			uint32_t limitsId;
+			uint8_t stageCount;
+			if(read_value(payload,offset,record.timestamp) == false || read_value(payload,offset,substitutionLevel) == false || read_value(payload,offset,flags) == false ||
+				read_value(payload,offset,limitsId) == false || read_string(payload,offset,record.options.name) == false || read_value(payload,offset,stageCount) == false)
+			{
+				outErr = "Malformed compile record";
+				return false;
+			}
+			record.options.substitutionLevel = substitutionLevel;
+			record.options.obfuscate = (flags &static_cast<uint8_t>(OptionFlags::Obfuscate)) != 0;
+			record.options.filterInactive = (flags &static_cast<uint8_t>(OptionFlags::FilterInactive)) != 0;
+			record.options.parallelStages = (flags &static_cast<uint8_t>(OptionFlags::ParallelStages)) != 0;
+			if(limitsId != DEFAULT_LIMITS_ID)
+			{
+				auto it = m_limits.find(limitsId);
+				if(it == m_limits.end())
+				{
+					outErr = "Compile record refers to unknown resource limits " +std::to_string(limitsId);
+					return false;
+				}
+				record.resourceLimits = it->second;
+				record.options.resourceLimits = record.resourceLimits.get();
+			}
+			for(auto i=decltype(stageCount){0u};i<stageCount;++i)
+			{
+				uint8_t stage;
+				std::string source;
+				if(read_value(payload,offset,stage) == false || stage >= static_cast<uint8_t>(ShaderStage::Count) || read_string(payload,offset,source) == false)
+				{
+					outErr = "Malformed compile record";
+					return false;
+				}
+				record.shaders[static_cast<ShaderStage>(stage)] = std::move(source);
+			}
+			outRecord = std::move(record);
+			return true;
+		}
+		default:
+			// Skip chunk types of newer versions
+			break;
+		}
+	}
+}
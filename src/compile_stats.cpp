@@ -0,0 +1,191 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#include "util_lunarglass/compile_stats.hpp"
+#include "scoped_phase.hpp"
+#include "allocation_tracker.hpp"
+#include "util_lunarglass/tracer.hpp"
+#include <algorithm>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+
+const char *lunarglass::get_compile_phase_name(CompilePhase phase)
+{
+	switch(phase)
+	{
+	case CompilePhase::Parse:
+		return "parse";
+	case CompilePhase::TranslateToTop:
+		return "translate_to_top";
+	case CompilePhase::TopToBottom:
+		return "top_to_bottom";
+	case CompilePhase::BottomToTarget:
+		return "bottom_to_target";
+	case CompilePhase::Count:
+		break;
+	}
+	return "unknown";
+}
+
+const char *lunarglass::get_substitution_rule_name(SubstitutionRule rule)
+{
+	switch(rule)
+	{
+	case SubstitutionRule::CheapExpression:
+		return "cheap_expression";
+	case SubstitutionRule::IncreasesData:
+		return "increases_data";
+	case SubstitutionRule::SingleUse:
+		return "single_use";
+	case SubstitutionRule::SubstitutionDisabled:
+		return "substitution_disabled";
+	case SubstitutionRule::CantMap:
+		return "cant_map";
+	case SubstitutionRule::SubstitutionLevel:
+		return "substitution_level";
+	case SubstitutionRule::TooLong:
+		return "too_long";
+	case SubstitutionRule::ModifiesPrecision:
+		return "modifies_precision";
+	case SubstitutionRule::AlreadyMapped:
+		return "already_mapped";
+	case SubstitutionRule::MultipleUses:
+		return "multiple_uses";
+	case SubstitutionRule::Count:
+		break;
+	}
+	return "unknown";
+}
+
+bool lunarglass::is_substituting_rule(SubstitutionRule rule) {return rule < SubstitutionRule::SubstitutionDisabled;}
+
+uint32_t lunarglass::SubstitutionStats::GetSubstitutedCount() const
+{
+	uint32_t count = 0;
+	for(auto i=0u;i<decisions.size();++i)
+	{
+		if(is_substituting_rule(static_cast<SubstitutionRule>(i)))
+			count += decisions[i];
+	}
+	return count;
+}
+
+uint32_t lunarglass::SubstitutionStats::GetEmittedCount() const
+{
+	uint32_t count = 0;
+	for(auto i=0u;i<decisions.size();++i)
+	{
+		if(is_substituting_rule(static_cast<SubstitutionRule>(i)) == false)
+			count += decisions[i];
+	}
+	return count;
+}
+
+lunarglass::SubstitutionStats &lunarglass::SubstitutionStats::operator+=(const SubstitutionStats &other)
+{
+	for(auto i=0u;i<decisions.size();++i)
+		decisions[i] += other.decisions[i];
+	return *this;
+}
+
+lunarglass::AllocationStats &lunarglass::AllocationStats::operator+=(const AllocationStats &other)
+{
+	count += other.count;
+	bytes += other.bytes;
+	highWater = std::max(highWater,other.highWater);
+	return *this;
+}
+
+bool lunarglass::is_allocation_tracking_enabled()
+{
+#ifdef UTIL_LUNARGLASS_TRACK_ALLOCATIONS
+	return true;
+#else
+	return false;
+#endif
+}
+
+lunarglass::PhaseStats &lunarglass::PhaseStats::operator+=(const PhaseStats &other)
+{
+	wall += other.wall;
+	cpu += other.cpu;
+	allocations += other.allocations;
+	return *this;
+}
+
+std::chrono::nanoseconds lunarglass::detail::get_thread_cpu_time()
+{
+#ifdef _WIN32
+	FILETIME creationTime,exitTime,kernelTime,userTime;
+	if(GetThreadTimes(GetCurrentThread(),&creationTime,&exitTime,&kernelTime,&userTime) == FALSE)
+		return std::chrono::nanoseconds{0};
+	auto toTicks = [](const FILETIME &t) {return (static_cast<uint64_t>(t.dwHighDateTime) <<32) | t.dwLowDateTime;};
+	// FILETIME is in units of 100 nanoseconds
+	return std::chrono::nanoseconds{(toTicks(kernelTime) +toTicks(userTime)) *100};
+#else
+	timespec ts;
+	if(clock_gettime(CLOCK_THREAD_CPUTIME_ID,&ts) != 0)
+		return std::chrono::nanoseconds{0};
+	return std::chrono::seconds{ts.tv_sec} +std::chrono::nanoseconds{ts.tv_nsec};
+#endif
+}
+
+lunarglass::detail::PhaseTrace lunarglass::detail::get_phase_trace(const Options &options,const char *name,std::optional<ShaderStage> stage)
+{
+	PhaseTrace trace {};
+	trace.tracer = options.tracer;
+	trace.name = name;
+	trace.programName = options.name;
+	trace.stage = stage;
+	return trace;
+}
+
+lunarglass::detail::ScopedPhase::ScopedPhase(PhaseStats *target,const PhaseTrace &trace)
+	: m_target{target},m_trace{trace}
+{
+	if(!m_target && !m_trace.tracer)
+		return;
+	m_wallStart = std::chrono::steady_clock::now();
+	if(!m_target)
+		return;
+#ifdef UTIL_LUNARGLASS_TRACK_ALLOCATIONS
+	auto &counters = get_thread_allocation_counters();
+	m_allocationStart = counters;
+	// Track the peak of this phase separately; The enclosing phase gets it back on destruction
+	counters.peak = counters.current;
+#endif
+	m_cpuStart = get_thread_cpu_time();
+}
+
+lunarglass::detail::ScopedPhase::ScopedPhase(const Options &options,ShaderStage stage,CompilePhase phase)
+	: ScopedPhase{options.stats ? &options.stats->GetStage(stage).GetPhase(phase) : nullptr,get_phase_trace(options,get_compile_phase_name(phase),stage)}
+{}
+
+lunarglass::detail::ScopedPhase::~ScopedPhase()
+{
+	if(!m_target && !m_trace.tracer)
+		return;
+	auto wallEnd = std::chrono::steady_clock::now();
+	if(m_trace.tracer)
+		m_trace.tracer->AddSpan(m_trace.name,"lunarglass",m_wallStart,wallEnd,m_trace.programName,m_trace.stage);
+	if(!m_target)
+		return;
+	m_target->cpu += get_thread_cpu_time() -m_cpuStart;
+	m_target->wall += std::chrono::duration_cast<std::chrono::nanoseconds>(wallEnd -m_wallStart);
+#ifdef UTIL_LUNARGLASS_TRACK_ALLOCATIONS
+	auto &counters = get_thread_allocation_counters();
+	AllocationStats allocations {};
+	allocations.count = counters.count -m_allocationStart.count;
+	allocations.bytes = counters.bytes -m_allocationStart.bytes;
+	allocations.highWater = static_cast<uint64_t>(std::max<int64_t>(counters.peak -m_allocationStart.current,0));
+	m_target->allocations += allocations;
+	counters.peak = std::max(counters.peak,m_allocationStart.peak);
+#endif
+}
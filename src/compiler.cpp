@@ -0,0 +1,34 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#include "util_lunarglass/compiler.hpp"
+#include "lunarglass_internal.hpp"
+
+lunarglass::Compiler::Compiler(const Options &options)
+	: m_state{std::make_unique<detail::CompilerState>(options)}
+{}
+
+lunarglass::Compiler::~Compiler() {}
+
+std::optional<std::unordered_map<lunarglass::ShaderStage,std::string>> lunarglass::Compiler::Optimize(const std::unordered_map<ShaderStage,std::string> &shaderStages,std::string &outInfoLog)
+{
+	return detail::optimize_glsl(detail::to_source_views(shaderStages),m_state->options,outInfoLog,m_state.get());
+}
+
+std::optional<std::unordered_map<lunarglass::ShaderStage,std::string>> lunarglass::Compiler::Optimize(const std::unordered_map<ShaderStage,std::string_view> &shaderStages,std::string &outInfoLog)
+{
+	return detail::optimize_glsl(shaderStages,m_state->options,outInfoLog,m_state.get());
+}
+
+std::optional<std::string> lunarglass::Compiler::OptimizeSpirv(const uint32_t *words,size_t count,std::string &outInfoLog,ShaderStage *outStage)
+{
+	return detail::optimize_spirv(words,count,m_state->options,outInfoLog,outStage,m_state.get());
+}
+
+bool lunarglass::Compiler::WarmUp() {return detail::warm_up(m_state.get());}
+
+const lunarglass::Options &lunarglass::Compiler::GetOptions() const {return m_state->options;}
@@ -0,0 +1,53 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#ifndef __UTIL_LUNARGLASS_INTERNAL_HPP__
+#define __UTIL_LUNARGLASS_INTERNAL_HPP__
+
+#include "util_lunarglass/util_lunarglass.hpp"
+#include <unordered_map>
+#include <string_view>
+#include <optional>
+#include <memory>
+#include <string>
+#include <array>
+
+namespace gla {class GlslManager;};
+namespace lunarglass::detail
+{
+	// Process-wide glslang initialization; Has to run before any TShader/TProgram is created
+	void initialize_process();
+
+	// Long-lived translation state of a lunarglass::Compiler session
+	struct CompilerState
+	{
+		// One slot per ShaderStage, plus one for SPIR-V modules (whose stage isn't known up front)
+		static constexpr uint32_t SPIRV_SLOT = static_cast<uint32_t>(ShaderStage::Count);
+		static constexpr uint32_t SLOT_COUNT = SPIRV_SLOT +1;
+
+		CompilerState(const Options &options);
+		~CompilerState();
+		// Returns the manager of the given slot, reset and ready to translate a new module
+		gla::GlslManager &AcquireManager(uint32_t slot);
+
+		Options options;
+		std::array<std::unique_ptr<gla::GlslManager>,SLOT_COUNT> managers;
+	};
+
+	// Compiles a small built-in program, with the session's managers if state is set.
+	// Returns false if it failed to compile.
+	bool warm_up(CompilerState *state);
+
+	// Views of the sources in 'shaderStages', the map itself only holds pointers
+	std::unordered_map<ShaderStage,std::string_view> to_source_views(const std::unordered_map<ShaderStage,std::string> &shaderStages);
+
+	// state may be null, in which case every stage is translated with a fresh manager
+	std::optional<std::unordered_map<ShaderStage,std::string>> optimize_glsl(const std::unordered_map<ShaderStage,std::string_view> &shaderStages,const Options &options,std::string &outInfoLog,CompilerState *state);
+	std::optional<std::string> optimize_spirv(const uint32_t *words,size_t count,const Options &options,std::string &outInfoLog,ShaderStage *outStage,CompilerState *state);
+};
+
+#endif
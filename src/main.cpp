@@ -6,9 +6,26 @@
 */
 
 #include "util_lunarglass/util_lunarglass.hpp"
+#include "util_lunarglass/result_cache.hpp"
+#include "util_lunarglass/resource_limits.hpp"
+#include "util_lunarglass/compile_stats.hpp"
+#include "util_lunarglass/capture.hpp"
+#include "lunarglass_internal.hpp"
+#include "scoped_phase.hpp"
+#include "shader_cost.hpp"
 #include "GlslangToTop.h"
 #include "SpvToTop.h"
 #include "GlslManager.h"
+#include "SPIRV/spirv.hpp"
+
+// LLVM includes
+#include "llvm/Support/Threading.h"
+
+#include <system_error>
+#include <exception>
+#include <climits>
+#include <thread>
+#include <mutex>
 
 #pragma comment(lib,"LLVMJIT.lib")
 #pragma comment(lib,"LLVMInterpreter.lib")
@@ -45,110 +62,151 @@
 #pragma comment(lib,"OSDependent.lib")
 #pragma comment(lib,"OGLCompiler.lib")
 
+void lunarglass::detail::initialize_process()
+{
+	static std::once_flag initFlag;
+	std::call_once(initFlag,[]() {
+		// LLVM's lazily constructed globals (pass registry, ManagedStatics) are only
+		// guarded by locks once multithreading has been switched on
+		llvm::llvm_start_multithreaded();
+		glslang::InitializeProcess();
+	});
+}
+
+bool lunarglass::detail::warm_up(CompilerState *state)
+{
+	// Small, but covers both the vertex and the fragment path as well as a texture sample
+	static const std::string_view vertexShader =
+		"#version 450\n"
+		"layout(location = 0) in vec3 in_position;\n"
+		"layout(location = 0) out vec2 vs_uv;\n"
+		"void main()\n"
+		"{\n"
+		"	vs_uv = in_position.xy;\n"
+		"	gl_Position = vec4(in_position, 1.0);\n"
+		"}\n";
+	static const std::string_view fragmentShader =
+		"#version 450\n"
+		"layout(location = 0) in vec2 vs_uv;\n"
+		"layout(binding = 0) uniform sampler2D u_texture;\n"
+		"layout(location = 0) out vec4 fs_color;\n"
+		"void main()\n"
+		"{\n"
+		"	fs_color = texture(u_texture, vs_uv) * 0.5;\n"
+		"}\n";
+	// The warm-up must not show up in the caller's cache, capture, stats or trace
+	Options options {};
+	if(state)
+	{
+		options.obfuscate = state->options.obfuscate;
+		options.filterInactive = state->options.filterInactive;
+		options.substitutionLevel = state->options.substitutionLevel;
+		options.resourceLimits = state->options.resourceLimits;
+	}
+	std::string infoLog;
+	try
+	{
+		return optimize_glsl(std::unordered_map<ShaderStage,std::string_view>{
+			{ShaderStage::Vertex,vertexShader},
+			{ShaderStage::Fragment,fragmentShader}
+		},options,infoLog,state).has_value();
+	}
+	catch(const std::exception&)
+	{
+		return false;
+	}
+}
+
+lunarglass::InitializationStats lunarglass::initialize()
+{
+	InitializationStats stats {};
+	auto t0 = std::chrono::steady_clock::now();
+	detail::initialize_process();
+	auto t1 = std::chrono::steady_clock::now();
+	stats.process = t1 -t0;
+
+	// The outcome of the one warm-up compile, handed to every later call as well
+	static bool warmUpSucceeded = false;
+	static std::once_flag warmUpFlag;
+	std::call_once(warmUpFlag,[]() {warmUpSucceeded = detail::warm_up(nullptr);});
+	stats.warmUp = std::chrono::steady_clock::now() -t1;
+	stats.warmUpSucceeded = warmUpSucceeded;
+	return stats;
+}
+
 std::optional<std::unordered_map<lunarglass::ShaderStage,std::string>> lunarglass::optimize_glsl(const std::unordered_map<ShaderStage,std::string> &shaderStages,std::string &outInfoLog)
 {
-    static auto glslangInitialized = false;
-    if(glslangInitialized == false)
-    {
-        glslangInitialized = true;
-        glslang::InitializeProcess();
-    }
+	return optimize_glsl(shaderStages,Options{},outInfoLog);
+}
+
+static std::optional<lunarglass::ShaderStage> to_shader_stage(int stage)
+{
+	using lunarglass::ShaderStage;
+	switch(stage)
+	{
+	case EShLangVertex:
+		return ShaderStage::Vertex;
+	case EShLangTessControl:
+		return ShaderStage::TessellationControl;
+	case EShLangTessEvaluation:
+		return ShaderStage::TessellationEvaluation;
+	case EShLangGeometry:
+		return ShaderStage::Geometry;
+	case EShLangFragment:
+		return ShaderStage::Fragment;
+	case EShLangCompute:
+		return ShaderStage::Compute;
+	}
+	return {};
+}
+
+const char *lunarglass::get_shader_stage_name(ShaderStage stage)
+{
+	switch(stage)
+	{
+	case ShaderStage::Compute:
+		return "compute";
+	case ShaderStage::Fragment:
+		return "fragment";
+	case ShaderStage::Geometry:
+		return "geometry";
+	case ShaderStage::TessellationControl:
+		return "tessellation_control";
+	case ShaderStage::TessellationEvaluation:
+		return "tessellation_evaluation";
+	case ShaderStage::Vertex:
+		return "vertex";
+	}
+	return "unknown";
+}
+
+lunarglass::detail::CompilerState::CompilerState(const Options &options)
+	: options{options}
+{}
+
+lunarglass::detail::CompilerState::~CompilerState() {}
+
+gla::GlslManager &lunarglass::detail::CompilerState::AcquireManager(uint32_t slot)
+{
+	auto &manager = managers[slot];
+	if(!manager)
+	{
+		manager = std::make_unique<gla::GlslManager>(options.obfuscate,options.filterInactive,options.substitutionLevel);
+		manager->options = gla::TransformOptions{};
+	}
+	else
+		manager->clear();
+	return *manager;
+}
+
+static std::optional<std::unordered_map<lunarglass::ShaderStage,std::string>> optimize_program(const std::unordered_map<lunarglass::ShaderStage,std::string_view> &shaderStages,const lunarglass::Options &options,std::string &outInfoLog,lunarglass::detail::CompilerState *state)
+{
+	using namespace lunarglass;
+	detail::initialize_process();
 	auto program = std::make_unique<glslang::TProgram>();
 	std::vector<std::unique_ptr<glslang::TShader>> shaders;
 	shaders.reserve(shaderStages.size());
-	TBuiltInResource resources;
-    resources.maxLights = 32;
-    resources.maxClipPlanes = 6;
-    resources.maxTextureUnits = 32;
-    resources.maxTextureCoords = 32;
-    resources.maxVertexAttribs = 64;
-    resources.maxVertexUniformComponents = 4096;
-    resources.maxVaryingFloats = 64;
-    resources.maxVertexTextureImageUnits = 32;
-    resources.maxCombinedTextureImageUnits = 80;
-    resources.maxTextureImageUnits = 32;
-    resources.maxFragmentUniformComponents = 4096;
-    resources.maxDrawBuffers = 32;
-    resources.maxVertexUniformVectors = 128;
-    resources.maxVaryingVectors = 8;
-    resources.maxFragmentUniformVectors = 16;
-    resources.maxVertexOutputVectors = 16;
-    resources.maxFragmentInputVectors = 15;
-    resources.minProgramTexelOffset = -8;
-    resources.maxProgramTexelOffset = 7;
-    resources.maxClipDistances = 8;
-    resources.maxComputeWorkGroupCountX = 65535;
-    resources.maxComputeWorkGroupCountY = 65535;
-    resources.maxComputeWorkGroupCountZ = 65535;
-    resources.maxComputeWorkGroupSizeX = 1024;
-    resources.maxComputeWorkGroupSizeY = 1024;
-    resources.maxComputeWorkGroupSizeZ = 64;
-    resources.maxComputeUniformComponents = 1024;
-    resources.maxComputeTextureImageUnits = 16;
-    resources.maxComputeImageUniforms = 8;
-    resources.maxComputeAtomicCounters = 8;
-    resources.maxComputeAtomicCounterBuffers = 1;
-    resources.maxVaryingComponents = 60;
-    resources.maxVertexOutputComponents = 64;
-    resources.maxGeometryInputComponents = 64;
-    resources.maxGeometryOutputComponents = 128;
-    resources.maxFragmentInputComponents = 128;
-    resources.maxImageUnits = 8;
-    resources.maxCombinedImageUnitsAndFragmentOutputs = 8;
-    resources.maxImageSamples = 0;
-    resources.maxVertexImageUniforms = 0;
-    resources.maxTessControlImageUniforms = 0;
-    resources.maxTessEvaluationImageUniforms = 0;
-    resources.maxGeometryImageUniforms = 0;
-    resources.maxFragmentImageUniforms = 8;
-    resources.maxCombinedImageUniforms = 8;
-    resources.maxGeometryTextureImageUnits = 16;
-    resources.maxGeometryOutputVertices = 256;
-    resources.maxGeometryTotalOutputComponents = 1024;
-    resources.maxGeometryUniformComponents = 1024;
-    resources.maxGeometryVaryingComponents = 64;
-    resources.maxTessControlInputComponents = 128;
-    resources.maxTessControlOutputComponents = 128;
-    resources.maxTessControlTextureImageUnits = 16;
-    resources.maxTessControlUniformComponents = 1024;
-    resources.maxTessControlTotalOutputComponents = 4096;
-    resources.maxTessEvaluationInputComponents = 128;
-    resources.maxTessEvaluationOutputComponents = 128;
-    resources.maxTessEvaluationTextureImageUnits = 16;
-    resources.maxTessEvaluationUniformComponents = 1024;
-    resources.maxTessPatchComponents = 120;
-    resources.maxPatchVertices = 32;
-    resources.maxTessGenLevel = 64;
-    resources.maxViewports = 16;
-    resources.maxVertexAtomicCounters = 0;
-    resources.maxTessControlAtomicCounters = 0;
-    resources.maxTessEvaluationAtomicCounters = 0;
-    resources.maxGeometryAtomicCounters = 0;
-    resources.maxFragmentAtomicCounters = 8;
-    resources.maxCombinedAtomicCounters = 8;
-    resources.maxAtomicCounterBindings = 1;
-    resources.maxVertexAtomicCounterBuffers = 0;
-    resources.maxTessControlAtomicCounterBuffers = 0;
-    resources.maxTessEvaluationAtomicCounterBuffers = 0;
-    resources.maxGeometryAtomicCounterBuffers = 0;
-    resources.maxFragmentAtomicCounterBuffers = 1;
-    resources.maxCombinedAtomicCounterBuffers = 1;
-    resources.maxAtomicCounterBufferSize = 16384;
-    resources.maxTransformFeedbackBuffers = 4;
-    resources.maxTransformFeedbackInterleavedComponents = 64;
-    resources.maxCullDistances = 8;
-    resources.maxCombinedClipAndCullDistances = 8;
-    resources.maxSamples = 4;
-
-    resources.limits.nonInductiveForLoops = 1;
-    resources.limits.whileLoops = 1;
-    resources.limits.doWhileLoops = 1;
-    resources.limits.generalUniformIndexing = 1;
-    resources.limits.generalAttributeMatrixVectorIndexing = 1;
-    resources.limits.generalVaryingIndexing = 1;
-    resources.limits.generalSamplerIndexing = 1;
-    resources.limits.generalVariableIndexing = 1;
-    resources.limits.generalConstantMatrixVectorIndexing = 1;
+	auto &resources = (options.resourceLimits ? *options.resourceLimits : ResourceLimits::GetDefault()).GetResources();
 	EShMessages messages = (EShMessages)(EShMsgDefault | EShMsgSpvRules | EShMsgVulkanRules);
 	for(auto &pair : shaderStages)
 	{
@@ -178,13 +236,29 @@ std::optional<std::unordered_map<lunarglass::ShaderStage,std::string>> lunarglas
 		shaders.emplace_back(std::make_unique<glslang::TShader>(stage));
 		auto &shader = shaders.back();
 
-        auto code = pair.second;
-		char *strings[] = {
-			code.data()
-		};
-        shader->setStrings(strings,1);
+		// glslang reads the source in place, so it is neither copied nor required to be null-terminated
+		auto &code = pair.second;
+		if(code.size() > static_cast<size_t>(INT_MAX))
+		{
+			outInfoLog = "Shader source exceeds the maximum supported size";
+			return {};
+		}
+		const char *strings[] = {code.data()};
+		const int lengths[] = {static_cast<int>(code.size())};
+		shader->setStringsWithLengths(strings,lengths,1);
+		if(options.stats)
+		{
+			auto &stageStats = options.stats->GetStage(pair.first);
+			stageStats.present = true;
+			stageStats.inputBytes = code.size();
+		}
 
-        if (! shader->parse(&resources, 100, false, messages)) {
+		bool parsed;
+		{
+			detail::ScopedPhase phase {options,pair.first,CompilePhase::Parse};
+			parsed = shader->parse(&resources, 100, false, messages);
+		}
+        if (! parsed) {
 			outInfoLog = shader->getInfoLog();
 			return {};
         }
@@ -196,62 +270,286 @@ std::optional<std::unordered_map<lunarglass::ShaderStage,std::string>> lunarglas
     // Program-level front-end processing...
     //
 
-    if (! program->link(messages)) {
+	bool linked;
+	{
+		detail::ScopedPhase phase {options.stats ? &options.stats->link : nullptr,detail::get_phase_trace(options,"link")};
+		linked = program->link(messages);
+	}
+    if (! linked) {
 		outInfoLog = program->getInfoLog();
 		return {};
     }
 
-	auto obfuscate = false;
-	auto inactive = false;
-	const int substitutionLevel = 1;
-
-    std::unordered_map<ShaderStage,std::string> optimizedShaders;
+	struct StageTranslation
+	{
+		ShaderStage stage;
+		gla::GlslManager *manager;
+		std::unique_ptr<gla::GlslManager> ownedManager;
+		std::exception_ptr exception;
+	};
+	std::vector<StageTranslation> translations;
+	translations.reserve(EShLangCount);
     for (int stage = 0; stage < EShLangCount; ++stage)
 	{
-	    gla::TransformOptions managerOptions;
-	    gla::GlslManager manager(obfuscate,inactive, substitutionLevel);
-	    manager.options = managerOptions;
         const glslang::TIntermediate* intermediate = program->getIntermediate((EShLanguage)stage);
         if (! intermediate)
             continue;
-		TranslateGlslangToTop(*intermediate, manager);
-		// Generate the Bottom IR
-		manager.translateTopToBottom();
+        auto eStage = to_shader_stage(stage);
+        if(eStage.has_value() == false)
+        {
+            outInfoLog = "Unsupported shader stage: " +std::to_string(stage);
+            return {};
+        }
+		StageTranslation translation {*eStage};
+		if(state)
+			translation.manager = &state->AcquireManager(static_cast<uint32_t>(*eStage));
+		else
+		{
+		    gla::TransformOptions managerOptions;
+		    translation.ownedManager = std::make_unique<gla::GlslManager>(options.obfuscate,options.filterInactive,options.substitutionLevel);
+		    translation.ownedManager->options = managerOptions;
+			translation.manager = translation.ownedManager.get();
+		}
+		// Generate the Top IR. This reads the glslang tree and allocates from glslang's
+		// per-thread pool, so it always runs on the calling thread.
+		{
+			detail::ScopedPhase phase {options,*eStage,CompilePhase::TranslateToTop};
+			TranslateGlslangToTop(*intermediate, *translation.manager);
+		}
+		if(options.stats)
+			options.stats->GetStage(*eStage).topCost = detail::compute_module_cost(*translation.manager->getModule());
+		translations.push_back(std::move(translation));
+	}
 
-		// Generate the GLSL output
-		manager.translateBottomToTarget();
+	// From here on every stage only touches its own manager and LLVM context
+	auto translateStage = [&options](StageTranslation &translation) {
+		try
+		{
+			// Generate the Bottom IR
+			{
+				detail::ScopedPhase phase {options,translation.stage,CompilePhase::TopToBottom};
+				translation.manager->translateTopToBottom();
+			}
 
-		if(manager.getGeneratedShader())
+			// Generate the GLSL output
+			{
+				detail::ScopedPhase phase {options,translation.stage,CompilePhase::BottomToTarget};
+				translation.manager->translateBottomToTarget();
+			}
+		}
+		catch(...)
 		{
-            ShaderStage eStage;
-            switch(stage)
-            {
-            case EShLangVertex:
-                eStage = ShaderStage::Vertex;
-                break;
-            case EShLangTessControl:
-                eStage = ShaderStage::TessellationControl;
-                break;
-            case EShLangTessEvaluation:
-                eStage = ShaderStage::TessellationEvaluation;
-                break;
-            case EShLangGeometry:
-                eStage = ShaderStage::Geometry;
-                break;
-            case EShLangFragment:
-                eStage = ShaderStage::Fragment;
-                break;
-            case EShLangCompute:
-                eStage = ShaderStage::Compute;
-                break;
-            default:
-            {
-                outInfoLog = "Unsupported shader stage: " +std::to_string(stage);
-                return {};
-            }
-            }
-            optimizedShaders[eStage] = manager.getGeneratedShader();
+			translation.exception = std::current_exception();
+		}
+	};
+	if(options.parallelStages && translations.size() > 1)
+	{
+		std::vector<std::thread> threads;
+		threads.reserve(translations.size() -1);
+		// Stages from this index on are translated on the calling thread
+		auto firstLocalStage = translations.size();
+		for(auto i=decltype(translations.size()){1u};i<translations.size();++i)
+		{
+			try
+			{
+				threads.emplace_back(translateStage,std::ref(translations[i]));
+			}
+			catch(const std::system_error&)
+			{
+				// No more threads available; The ones already started still have to be joined
+				firstLocalStage = i;
+				break;
+			}
+		}
+		translateStage(translations.front());
+		for(auto i=firstLocalStage;i<translations.size();++i)
+			translateStage(translations[i]);
+		for(auto &thread : threads)
+			thread.join();
+	}
+	else
+	{
+		for(auto &translation : translations)
+		{
+			translateStage(translation);
+			if(translation.exception)
+				break;
+		}
+	}
+
+    std::unordered_map<ShaderStage,std::string> optimizedShaders;
+	for(auto &translation : translations)
+	{
+		if(translation.exception)
+			std::rethrow_exception(translation.exception);
+		if(translation.manager->getGeneratedShader() == nullptr)
+			continue;
+		auto &glsl = optimizedShaders[translation.stage] = translation.manager->takeGeneratedShader();
+		if(options.stats)
+		{
+			auto &stageStats = options.stats->GetStage(translation.stage);
+			stageStats.outputBytes = glsl.size();
+			stageStats.outputCost = translation.manager->getCost();
+			stageStats.substitutions = translation.manager->getSubstitutionStats();
 		}
 	}
 	return optimizedShaders;
 }
+
+std::unordered_map<lunarglass::ShaderStage,std::string_view> lunarglass::detail::to_source_views(const std::unordered_map<ShaderStage,std::string> &shaderStages)
+{
+	std::unordered_map<ShaderStage,std::string_view> views {};
+	views.reserve(shaderStages.size());
+	for(auto &pair : shaderStages)
+		views[pair.first] = pair.second;
+	return views;
+}
+
+std::optional<std::unordered_map<lunarglass::ShaderStage,std::string>> lunarglass::detail::optimize_glsl(const std::unordered_map<ShaderStage,std::string_view> &shaderStages,const Options &options,std::string &outInfoLog,CompilerState *state)
+{
+	if(options.capture)
+		options.capture->Record(shaderStages,options);
+	if(options.stats)
+		*options.stats = {};
+	detail::ScopedPhase phase {options.stats ? &options.stats->total : nullptr,detail::get_phase_trace(options,"optimize_glsl")};
+	if(!options.cache)
+		return optimize_program(shaderStages,options,outInfoLog,state);
+	auto key = ResultCache::ComputeKey(shaderStages,options);
+	auto cached = options.cache->Find(key);
+	if(cached.has_value())
+	{
+		if(options.stats)
+		{
+			options.stats->cacheHit = true;
+			for(auto &pair : *cached)
+			{
+				auto &stageStats = options.stats->GetStage(pair.first);
+				stageStats.present = true;
+				auto it = shaderStages.find(pair.first);
+				stageStats.inputBytes = (it != shaderStages.end()) ? it->second.size() : 0;
+				stageStats.outputBytes = pair.second.size();
+			}
+		}
+		return cached;
+	}
+	auto result = optimize_program(shaderStages,options,outInfoLog,state);
+	// Failures are not cached, the info log may depend on more than the key
+	if(result.has_value())
+		options.cache->Store(key,*result);
+	return result;
+}
+
+std::optional<std::unordered_map<lunarglass::ShaderStage,std::string>> lunarglass::optimize_glsl(const std::unordered_map<ShaderStage,std::string> &shaderStages,const Options &options,std::string &outInfoLog)
+{
+	return detail::optimize_glsl(detail::to_source_views(shaderStages),options,outInfoLog,nullptr);
+}
+
+std::optional<std::unordered_map<lunarglass::ShaderStage,std::string>> lunarglass::optimize_glsl(const std::unordered_map<ShaderStage,std::string_view> &shaderStages,const Options &options,std::string &outInfoLog)
+{
+	return detail::optimize_glsl(shaderStages,options,outInfoLog,nullptr);
+}
+
+std::optional<std::string> lunarglass::detail::optimize_spirv(const uint32_t *words,size_t count,const Options &options,std::string &outInfoLog,ShaderStage *outStage,CompilerState *state)
+{
+	static_assert(sizeof(uint32_t) == sizeof(unsigned int));
+	if(options.stats)
+		*options.stats = {};
+	detail::ScopedPhase phase {options.stats ? &options.stats->total : nullptr,detail::get_phase_trace(options,"optimize_spirv")};
+	std::optional<CacheKey> key {};
+	if(options.cache)
+	{
+		key = ResultCache::ComputeKey(words,count,options);
+		auto cached = options.cache->Find(*key);
+		if(cached.has_value() && cached->size() == 1)
+		{
+			auto &pair = *cached->begin();
+			if(options.stats)
+			{
+				options.stats->cacheHit = true;
+				auto &stageStats = options.stats->GetStage(pair.first);
+				stageStats.present = true;
+				stageStats.inputBytes = count *sizeof(*words);
+				stageStats.outputBytes = pair.second.size();
+			}
+			if(outStage)
+				*outStage = pair.first;
+			return std::move(pair.second);
+		}
+	}
+
+	if(count < 5 || words[0] != spv::MagicNumber)
+	{
+		outInfoLog = "Input is not a SPIR-V module";
+		return {};
+	}
+	detail::initialize_process();
+
+	std::unique_ptr<gla::GlslManager> ownedManager {};
+	gla::GlslManager *pManager;
+	if(state)
+		pManager = &state->AcquireManager(CompilerState::SPIRV_SLOT);
+	else
+	{
+		ownedManager = std::make_unique<gla::GlslManager>(options.obfuscate,options.filterInactive,options.substitutionLevel);
+		ownedManager->options = gla::TransformOptions{};
+		pManager = ownedManager.get();
+	}
+	auto &manager = *pManager;
+	// The stage is only known once the module has been read, so time into a local first
+	PhaseStats translateToTopStats {};
+	// Generate the Top IR directly from the words, glslang isn't involved at all
+	{
+		detail::ScopedPhase phase {options.stats ? &translateToTopStats : nullptr,detail::get_phase_trace(options,get_compile_phase_name(CompilePhase::TranslateToTop))};
+		gla::SpvToTop(reinterpret_cast<const unsigned int*>(words),count,manager);
+	}
+	auto stage = to_shader_stage(manager.getStage());
+	if(stage.has_value() == false)
+	{
+		outInfoLog = "Unsupported shader stage: " +std::to_string(manager.getStage());
+		return {};
+	}
+	if(options.stats)
+	{
+		auto &stageStats = options.stats->GetStage(*stage);
+		stageStats.present = true;
+		stageStats.inputBytes = count *sizeof(*words);
+		stageStats.GetPhase(CompilePhase::TranslateToTop) = translateToTopStats;
+		stageStats.topCost = detail::compute_module_cost(*manager.getModule());
+	}
+
+	// Generate the Bottom IR
+	{
+		detail::ScopedPhase phase {options,*stage,CompilePhase::TopToBottom};
+		manager.translateTopToBottom();
+	}
+
+	// Generate the GLSL output
+	{
+		detail::ScopedPhase phase {options,*stage,CompilePhase::BottomToTarget};
+		manager.translateBottomToTarget();
+	}
+
+	if(!manager.getGeneratedShader())
+	{
+		outInfoLog = "No GLSL was generated for the SPIR-V module";
+		return {};
+	}
+	auto glsl = manager.takeGeneratedShader();
+	if(options.stats)
+	{
+		auto &stageStats = options.stats->GetStage(*stage);
+		stageStats.outputBytes = glsl.size();
+		stageStats.outputCost = manager.getCost();
+		stageStats.substitutions = manager.getSubstitutionStats();
+	}
+	if(key.has_value())
+		options.cache->Store(*key,{{*stage,glsl}});
+	if(outStage)
+		*outStage = *stage;
+	return glsl;
+}
+
+std::optional<std::string> lunarglass::optimize_spirv(const uint32_t *words,size_t count,const Options &options,std::string &outInfoLog,ShaderStage *outStage)
+{
+	return detail::optimize_spirv(words,count,options,outInfoLog,outStage,nullptr);
+}
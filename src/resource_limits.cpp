@@ -0,0 +1,41 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#include "util_lunarglass/resource_limits.hpp"
+#include "sha256.hpp"
+#include "glslang/Include/ResourceLimits.h"
+
+const lunarglass::ResourceLimits &lunarglass::ResourceLimits::GetDefault()
+{
+	static const ResourceLimits limits {};
+	return limits;
+}
+
+lunarglass::ResourceLimits::ResourceLimits(const ResourceLimitValues &values)
+	: m_values{values},m_resources{std::make_unique<TBuiltInResource>()}
+{
+	// Value-initialized, so that limits this wrapper doesn't know about are zero rather than undefined
+	auto &resources = *m_resources;
+	Sha256 hash {};
+#define UTIL_LUNARGLASS_RESOURCE_LIMIT_APPLY(name,value) \
+	resources.name = values.name; \
+	hash.UpdateValue(static_cast<int32_t>(values.name));
+	UTIL_LUNARGLASS_RESOURCE_LIMITS(UTIL_LUNARGLASS_RESOURCE_LIMIT_APPLY)
+#undef UTIL_LUNARGLASS_RESOURCE_LIMIT_APPLY
+#define UTIL_LUNARGLASS_RESOURCE_LIMIT_APPLY(name,value) \
+	resources.limits.name = values.name; \
+	hash.UpdateValue(static_cast<uint8_t>(values.name));
+	UTIL_LUNARGLASS_RESOURCE_LIMIT_FLAGS(UTIL_LUNARGLASS_RESOURCE_LIMIT_APPLY)
+#undef UTIL_LUNARGLASS_RESOURCE_LIMIT_APPLY
+	m_digest = hash.Finalize();
+}
+
+lunarglass::ResourceLimits::~ResourceLimits() {}
+
+const lunarglass::ResourceLimitValues &lunarglass::ResourceLimits::GetValues() const {return m_values;}
+const TBuiltInResource &lunarglass::ResourceLimits::GetResources() const {return *m_resources;}
+const lunarglass::ResourceLimits::Digest &lunarglass::ResourceLimits::GetDigest() const {return m_digest;}
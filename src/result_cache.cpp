@@ -0,0 +1,320 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#include "util_lunarglass/result_cache.hpp"
+#include "util_lunarglass/shader_pack.hpp"
+#include "util_lunarglass/resource_limits.hpp"
+#include "sha256.hpp"
+#include <filesystem>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// Bump whenever a change to the translation pipeline alters the generated code,
+	// so that stale results are no longer found
+	constexpr uint32_t CACHE_KEY_VERSION = 7;
+
+	constexpr std::array<char,4> DISK_MAGIC = {'L','G','R','C'};
+	constexpr uint32_t DISK_FORMAT_VERSION = 1;
+
+	enum class InputKind : uint8_t
+	{
+		Glsl = 0,
+		Spirv
+	};
+	void hash_options(lunarglass::Sha256 &hash,InputKind inputKind,const lunarglass::Options &options)
+	{
+		hash.UpdateValue(CACHE_KEY_VERSION);
+		hash.UpdateValue(inputKind);
+
+		// Only options that change the generated code are part of the key
+		hash.UpdateValue(static_cast<int32_t>(options.substitutionLevel));
+		hash.UpdateValue(static_cast<uint8_t>(options.obfuscate));
+		hash.UpdateValue(static_cast<uint8_t>(options.filterInactive));
+		// Resource limits only affect the parsing of GLSL sources
+		if(inputKind == InputKind::Glsl)
+		{
+			auto &limits = options.resourceLimits ? *options.resourceLimits : lunarglass::ResourceLimits::GetDefault();
+			hash.Update(limits.GetDigest().data(),limits.GetDigest().size());
+		}
+	}
+
+	template<typename TShaderMap>
+		lunarglass::CacheKey compute_glsl_key(const TShaderMap &shaderStages,const lunarglass::Options &options)
+	{
+		using lunarglass::ShaderStage;
+		lunarglass::Sha256 hash {};
+		hash_options(hash,InputKind::Glsl,options);
+
+		// Iteration order of the map is unspecified, so hash the stages in enum order
+		for(auto i=0u;i<static_cast<uint32_t>(ShaderStage::Count);++i)
+		{
+			auto it = shaderStages.find(static_cast<ShaderStage>(i));
+			if(it == shaderStages.end())
+				continue;
+			auto &source = it->second;
+			hash.UpdateValue(static_cast<uint8_t>(i));
+			hash.UpdateValue(static_cast<uint64_t>(source.size()));
+			hash.Update(source.data(),source.size());
+		}
+		return hash.Finalize();
+	}
+
+	template<typename T>
+		void write_value(std::vector<uint8_t> &data,const T &value)
+	{
+		auto offset = data.size();
+		data.resize(offset +sizeof(value));
+		memcpy(data.data() +offset,&value,sizeof(value));
+	}
+	template<typename T>
+		bool read_value(const std::vector<uint8_t> &data,size_t &offset,T &outValue)
+	{
+		if(offset > data.size() || sizeof(outValue) > data.size() -offset)
+			return false;
+		memcpy(&outValue,data.data() +offset,sizeof(outValue));
+		offset += sizeof(outValue);
+		return true;
+	}
+};
+
+size_t lunarglass::CacheKeyHasher::operator()(const CacheKey &key) const
+{
+	// The key already is a cryptographic hash, any part of it is evenly distributed
+	size_t hash;
+	memcpy(&hash,key.data(),sizeof(hash));
+	return hash;
+}
+
+std::string lunarglass::cache_key_to_string(const CacheKey &key)
+{
+	constexpr const char *digits = "0123456789abcdef";
+	std::string str;
+	str.reserve(key.size() *2);
+	for(auto b : key)
+	{
+		str += digits[b >>4];
+		str += digits[b &0xF];
+	}
+	return str;
+}
+
+lunarglass::CacheKey lunarglass::ResultCache::ComputeKey(const std::unordered_map<ShaderStage,std::string> &shaderStages,const Options &options)
+{
+	return compute_glsl_key(shaderStages,options);
+}
+
+lunarglass::CacheKey lunarglass::ResultCache::ComputeKey(const std::unordered_map<ShaderStage,std::string_view> &shaderStages,const Options &options)
+{
+	return compute_glsl_key(shaderStages,options);
+}
+
+lunarglass::CacheKey lunarglass::ResultCache::ComputeKey(const uint32_t *spirv,size_t wordCount,const Options &options)
+{
+	Sha256 hash {};
+	hash_options(hash,InputKind::Spirv,options);
+	hash.UpdateValue(static_cast<uint64_t>(wordCount));
+	hash.Update(spirv,wordCount *sizeof(*spirv));
+	return hash.Finalize();
+}
+
+lunarglass::ResultCache::ResultCache()
+	: ResultCache{CreateInfo{}}
+{}
+
+lunarglass::ResultCache::ResultCache(const CreateInfo &createInfo)
+	: m_createInfo{createInfo}
+{}
+
+std::optional<lunarglass::ResultCache::ShaderMap> lunarglass::ResultCache::Find(const CacheKey &key)
+{
+	{
+		std::scoped_lock lock {m_mutex};
+		auto it = m_entryMap.find(key);
+		if(it != m_entryMap.end())
+		{
+			m_entries.splice(m_entries.begin(),m_entries,it->second);
+			++m_statistics.memoryHits;
+			return it->second->shaders;
+		}
+		for(auto &pack : m_packs)
+		{
+			auto entry = pack->Find(key);
+			if(entry.has_value() == false)
+				continue;
+			++m_statistics.packHits;
+			return entry->ToShaderMap();
+		}
+	}
+
+	auto shaders = LoadFromDisk(key);
+	std::scoped_lock lock {m_mutex};
+	if(shaders.has_value() == false)
+	{
+		++m_statistics.misses;
+		return {};
+	}
+	++m_statistics.diskHits;
+	StoreInMemory(key,*shaders);
+	return shaders;
+}
+
+void lunarglass::ResultCache::Store(const CacheKey &key,const ShaderMap &shaders)
+{
+	{
+		std::scoped_lock lock {m_mutex};
+		StoreInMemory(key,shaders);
+	}
+	WriteToDisk(key,shaders);
+}
+
+void lunarglass::ResultCache::AddPack(const std::shared_ptr<const ShaderPack> &pack)
+{
+	std::scoped_lock lock {m_mutex};
+	m_packs.push_back(pack);
+}
+
+void lunarglass::ResultCache::StoreInMemory(const CacheKey &key,const ShaderMap &shaders)
+{
+	size_t size = 0;
+	for(auto &pair : shaders)
+		size += pair.second.size();
+
+	auto it = m_entryMap.find(key);
+	if(it != m_entryMap.end())
+	{
+		m_memoryBytes -= it->second->size;
+		m_entries.erase(it->second);
+		m_entryMap.erase(it);
+	}
+	m_entries.push_front({key,shaders,size});
+	m_entryMap[key] = m_entries.begin();
+	m_memoryBytes += size;
+
+	// Evict least recently used results, but always keep the one that was just added
+	while(m_memoryBytes > m_createInfo.maxMemoryBytes && m_entries.size() > 1)
+	{
+		auto &entry = m_entries.back();
+		m_memoryBytes -= entry.size;
+		m_entryMap.erase(entry.key);
+		m_entries.pop_back();
+	}
+}
+
+void lunarglass::ResultCache::Clear()
+{
+	std::scoped_lock lock {m_mutex};
+	m_entries.clear();
+	m_entryMap.clear();
+	m_memoryBytes = 0;
+}
+
+lunarglass::ResultCache::Statistics lunarglass::ResultCache::GetStatistics() const
+{
+	std::scoped_lock lock {m_mutex};
+	auto statistics = m_statistics;
+	statistics.memoryEntryCount = m_entries.size();
+	statistics.memoryBytes = m_memoryBytes;
+	return statistics;
+}
+
+std::string lunarglass::ResultCache::GetDiskPath(const CacheKey &key) const
+{
+	return (std::filesystem::path{m_createInfo.diskDirectory} /(cache_key_to_string(key) +".lgc")).string();
+}
+
+std::optional<lunarglass::ResultCache::ShaderMap> lunarglass::ResultCache::LoadFromDisk(const CacheKey &key) const
+{
+	if(m_createInfo.diskDirectory.empty())
+		return {};
+	std::ifstream file {GetDiskPath(key),std::ios::binary};
+	if(!file)
+		return {};
+	std::vector<uint8_t> data {std::istreambuf_iterator<char>{file},std::istreambuf_iterator<char>{}};
+
+	size_t offset = 0;
+	std::array<char,4> magic;
+	uint32_t version;
+	CacheKey storedKey;
+	uint32_t stageCount;
+	if(read_value(data,offset,magic) == false || magic != DISK_MAGIC || read_value(data,offset,version) == false || version != DISK_FORMAT_VERSION)
+		return {};
+	if(read_value(data,offset,storedKey) == false || storedKey != key || read_value(data,offset,stageCount) == false)
+		return {};
+	ShaderMap shaders {};
+	for(auto i=decltype(stageCount){0u};i<stageCount;++i)
+	{
+		uint8_t stage;
+		uint64_t size;
+		if(read_value(data,offset,stage) == false || stage >= static_cast<uint8_t>(ShaderStage::Count) || read_value(data,offset,size) == false)
+			return {};
+		// A corrupt size must not wrap around the bounds check
+		if(offset > data.size() || size > data.size() -offset)
+			return {};
+		shaders[static_cast<ShaderStage>(stage)] = std::string{reinterpret_cast<const char*>(data.data() +offset),static_cast<size_t>(size)};
+		offset += size;
+	}
+	return shaders;
+}
+
+void lunarglass::ResultCache::WriteToDisk(const CacheKey &key,const ShaderMap &shaders) const
+{
+	if(m_createInfo.diskDirectory.empty())
+		return;
+	std::vector<uint8_t> data {};
+	write_value(data,DISK_MAGIC);
+	write_value(data,DISK_FORMAT_VERSION);
+	write_value(data,key);
+	write_value(data,static_cast<uint32_t>(shaders.size()));
+	for(auto &pair : shaders)
+	{
+		write_value(data,static_cast<uint8_t>(pair.first));
+		write_value(data,static_cast<uint64_t>(pair.second.size()));
+		data.insert(data.end(),pair.second.begin(),pair.second.end());
+	}
+
+	// Write to a temporary file first and move it into place, so that concurrent
+	// readers (or other processes) never observe a partially written result.
+	// The process id keeps writers of different processes off each other's temporary files,
+	// thread id hashes and counters alone repeat between processes.
+	static std::atomic<uint64_t> tmpCounter = 0;
+#ifdef _WIN32
+	auto processId = static_cast<uint64_t>(GetCurrentProcessId());
+#else
+	auto processId = static_cast<uint64_t>(getpid());
+#endif
+	std::error_code ec;
+	std::filesystem::create_directories(m_createInfo.diskDirectory,ec);
+	auto path = GetDiskPath(key);
+	auto tmpPath = path +".tmp" +std::to_string(processId) +"_" +std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) +"_" +std::to_string(tmpCounter++);
+	{
+		std::ofstream file {tmpPath,std::ios::binary | std::ios::trunc};
+		if(!file)
+			return;
+		file.write(reinterpret_cast<const char*>(data.data()),data.size());
+		if(!file)
+		{
+			file.close();
+			std::filesystem::remove(tmpPath,ec);
+			return;
+		}
+	}
+	std::filesystem::rename(tmpPath,path,ec);
+	if(ec)
+		std::filesystem::remove(tmpPath,ec);
+}
@@ -0,0 +1,52 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#ifndef __UTIL_LUNARGLASS_SCOPED_PHASE_HPP__
+#define __UTIL_LUNARGLASS_SCOPED_PHASE_HPP__
+
+#include "util_lunarglass/compile_stats.hpp"
+#include "allocation_tracker.hpp"
+#include <string_view>
+#include <optional>
+#include <chrono>
+
+namespace lunarglass::detail
+{
+	// CPU time consumed by the calling thread so far
+	std::chrono::nanoseconds get_thread_cpu_time();
+
+	struct PhaseTrace
+	{
+		Tracer *tracer = nullptr;
+		const char *name = nullptr;
+		std::string_view programName;
+		std::optional<ShaderStage> stage;
+	};
+	PhaseTrace get_phase_trace(const Options &options,const char *name,std::optional<ShaderStage> stage={});
+
+	// Adds the time (and, if tracked, the allocations of the calling thread) between construction and
+	// destruction to 'target', and records it as a span if trace.tracer is set. Phases may be nested.
+	// Does nothing (and doesn't query any clocks) if neither is set.
+	class ScopedPhase
+	{
+	public:
+		ScopedPhase(PhaseStats *target,const PhaseTrace &trace={});
+		// Records 'phase' of 'stage' into options.stats and options.tracer
+		ScopedPhase(const Options &options,ShaderStage stage,CompilePhase phase);
+		~ScopedPhase();
+		ScopedPhase(const ScopedPhase&)=delete;
+		ScopedPhase &operator=(const ScopedPhase&)=delete;
+	private:
+		PhaseStats *m_target;
+		PhaseTrace m_trace;
+		std::chrono::steady_clock::time_point m_wallStart;
+		std::chrono::nanoseconds m_cpuStart;
+		AllocationCounters m_allocationStart;
+	};
+};
+
+#endif
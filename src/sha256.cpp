@@ -0,0 +1,132 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#include "sha256.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	constexpr std::array<uint32_t,64> ROUND_CONSTANTS = {
+		0x428a2f98,0x71374491,0xb5c0fbcf,0xe9b5dba5,0x3956c25b,0x59f111f1,0x923f82a4,0xab1c5ed5,
+		0xd807aa98,0x12835b01,0x243185be,0x550c7dc3,0x72be5d74,0x80deb1fe,0x9bdc06a7,0xc19bf174,
+		0xe49b69c1,0xefbe4786,0x0fc19dc6,0x240ca1cc,0x2de92c6f,0x4a7484aa,0x5cb0a9dc,0x76f988da,
+		0x983e5152,0xa831c66d,0xb00327c8,0xbf597fc7,0xc6e00bf3,0xd5a79147,0x06ca6351,0x14292967,
+		0x27b70a85,0x2e1b2138,0x4d2c6dfc,0x53380d13,0x650a7354,0x766a0abb,0x81c2c92e,0x92722c85,
+		0xa2bfe8a1,0xa81a664b,0xc24b8b70,0xc76c51a3,0xd192e819,0xd6990624,0xf40e3585,0x106aa070,
+		0x19a4c116,0x1e376c08,0x2748774c,0x34b0bcb5,0x391c0cb3,0x4ed8aa4a,0x5b9cca4f,0x682e6ff3,
+		0x748f82ee,0x78a5636f,0x84c87814,0x8cc70208,0x90befffa,0xa4506ceb,0xbef9a3f7,0xc67178f2
+	};
+	constexpr uint32_t rotr(uint32_t x,uint32_t n) {return (x >>n) | (x <<(32 -n));}
+};
+
+lunarglass::Sha256::Sha256()
+	: m_state{0x6a09e667,0xbb67ae85,0x3c6ef372,0xa54ff53a,0x510e527f,0x9b05688c,0x1f83d9ab,0x5be0cd19}
+{}
+
+void lunarglass::Sha256::ProcessBlock(const uint8_t *block)
+{
+	std::array<uint32_t,64> w;
+	for(auto i=0u;i<16;++i)
+	{
+		w[i] = (static_cast<uint32_t>(block[i *4]) <<24) | (static_cast<uint32_t>(block[i *4 +1]) <<16) |
+			(static_cast<uint32_t>(block[i *4 +2]) <<8) | static_cast<uint32_t>(block[i *4 +3]);
+	}
+	for(auto i=16u;i<64;++i)
+	{
+		auto s0 = rotr(w[i -15],7) ^rotr(w[i -15],18) ^(w[i -15] >>3);
+		auto s1 = rotr(w[i -2],17) ^rotr(w[i -2],19) ^(w[i -2] >>10);
+		w[i] = w[i -16] +s0 +w[i -7] +s1;
+	}
+
+	auto a = m_state[0];
+	auto b = m_state[1];
+	auto c = m_state[2];
+	auto d = m_state[3];
+	auto e = m_state[4];
+	auto f = m_state[5];
+	auto g = m_state[6];
+	auto h = m_state[7];
+	for(auto i=0u;i<64;++i)
+	{
+		auto s1 = rotr(e,6) ^rotr(e,11) ^rotr(e,25);
+		auto ch = (e &f) ^(~e &g);
+		auto t1 = h +s1 +ch +ROUND_CONSTANTS[i] +w[i];
+		auto s0 = rotr(a,2) ^rotr(a,13) ^rotr(a,22);
+		auto maj = (a &b) ^(a &c) ^(b &c);
+		auto t2 = s0 +maj;
+		h = g;
+		g = f;
+		f = e;
+		e = d +t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 +t2;
+	}
+	m_state[0] += a;
+	m_state[1] += b;
+	m_state[2] += c;
+	m_state[3] += d;
+	m_state[4] += e;
+	m_state[5] += f;
+	m_state[6] += g;
+	m_state[7] += h;
+}
+
+void lunarglass::Sha256::Update(const void *data,size_t size)
+{
+	auto *bytes = static_cast<const uint8_t*>(data);
+	m_totalSize += size;
+	if(m_bufferSize > 0)
+	{
+		auto n = std::min(size,m_buffer.size() -m_bufferSize);
+		memcpy(m_buffer.data() +m_bufferSize,bytes,n);
+		m_bufferSize += n;
+		bytes += n;
+		size -= n;
+		if(m_bufferSize < m_buffer.size())
+			return;
+		ProcessBlock(m_buffer.data());
+		m_bufferSize = 0;
+	}
+	while(size >= m_buffer.size())
+	{
+		ProcessBlock(bytes);
+		bytes += m_buffer.size();
+		size -= m_buffer.size();
+	}
+	if(size > 0)
+	{
+		memcpy(m_buffer.data(),bytes,size);
+		m_bufferSize = size;
+	}
+}
+
+lunarglass::Sha256::Digest lunarglass::Sha256::Finalize()
+{
+	auto bitSize = m_totalSize *8;
+	uint8_t padding = 0x80;
+	Update(&padding,1);
+	padding = 0;
+	while(m_bufferSize != 56)
+		Update(&padding,1);
+	std::array<uint8_t,8> length;
+	for(auto i=0u;i<8;++i)
+		length[i] = static_cast<uint8_t>(bitSize >>(56 -i *8));
+	Update(length.data(),length.size());
+
+	Digest digest;
+	for(auto i=0u;i<8;++i)
+	{
+		digest[i *4] = static_cast<uint8_t>(m_state[i] >>24);
+		digest[i *4 +1] = static_cast<uint8_t>(m_state[i] >>16);
+		digest[i *4 +2] = static_cast<uint8_t>(m_state[i] >>8);
+		digest[i *4 +3] = static_cast<uint8_t>(m_state[i]);
+	}
+	return digest;
+}
@@ -0,0 +1,36 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#ifndef __UTIL_LUNARGLASS_SHA256_HPP__
+#define __UTIL_LUNARGLASS_SHA256_HPP__
+
+#include <cinttypes>
+#include <cstddef>
+#include <array>
+
+namespace lunarglass
+{
+	// Incremental SHA-256 (FIPS 180-4), used for content-addressed cache keys
+	class Sha256
+	{
+	public:
+		using Digest = std::array<uint8_t,32>;
+		Sha256();
+		void Update(const void *data,size_t size);
+		template<typename T>
+			void UpdateValue(const T &value) {Update(&value,sizeof(value));}
+		Digest Finalize();
+	private:
+		void ProcessBlock(const uint8_t *block);
+		std::array<uint32_t,8> m_state;
+		std::array<uint8_t,64> m_buffer;
+		uint64_t m_totalSize = 0;
+		size_t m_bufferSize = 0;
+	};
+};
+
+#endif
@@ -0,0 +1,128 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#include "shader_cost.hpp"
+
+// LLVM includes
+#pragma warning(push, 1)
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#pragma warning(pop)
+
+#include <unordered_map>
+#include <string>
+#include <cctype>
+
+static lunarglass::detail::CostCategory get_intrinsic_cost_category(const llvm::IntrinsicInst &intrinsic)
+{
+	using lunarglass::detail::CostCategory;
+	// There are far too many gla intrinsics to list them individually; Their names
+	// follow a consistent scheme (e.g. "llvm.gla.fTextureSampleLodRefZ"), so go by that.
+	std::string name = intrinsic.getCalledFunction()->getName().str();
+	for(auto &c : name)
+		c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+	auto contains = [&name](const char *str) {return name.find(str) != std::string::npos;};
+	if(contains("query"))
+		return CostCategory::None;
+	if(contains("texture") || contains("texel") || contains("image"))
+		return CostCategory::Texture;
+	if(contains("readdata") || contains("readinterpolant"))
+		return CostCategory::Load;
+	if(contains("writedata"))
+		return CostCategory::Store;
+	if(contains("swizzle") || contains("multiinsert"))
+		return CostCategory::None;
+	return CostCategory::Alu;
+}
+
+lunarglass::detail::CostCategory lunarglass::detail::get_cost_category(const llvm::Instruction &instruction)
+{
+	if(instruction.isBinaryOp() || llvm::isa<llvm::CmpInst>(instruction) || llvm::isa<llvm::SelectInst>(instruction))
+		return CostCategory::Alu;
+	if(auto *cast = llvm::dyn_cast<llvm::CastInst>(&instruction))
+		return (cast->getOpcode() == llvm::Instruction::BitCast) ? CostCategory::None : CostCategory::Alu;
+	switch(instruction.getOpcode())
+	{
+	case llvm::Instruction::Load:
+		return CostCategory::Load;
+	case llvm::Instruction::Store:
+		return CostCategory::Store;
+	case llvm::Instruction::Call:
+		if(auto *intrinsic = llvm::dyn_cast<llvm::IntrinsicInst>(&instruction))
+		{
+			if(intrinsic->getIntrinsicID() != llvm::Intrinsic::not_intrinsic)
+				return get_intrinsic_cost_category(*intrinsic);
+		}
+		break;
+	}
+	return CostCategory::None;
+}
+
+void lunarglass::detail::add_cost(ShaderCost &cost,CostCategory category)
+{
+	switch(category)
+	{
+	case CostCategory::Alu:
+		++cost.aluOps;
+		break;
+	case CostCategory::Texture:
+		++cost.textureOps;
+		break;
+	case CostCategory::Load:
+		++cost.loads;
+		break;
+	case CostCategory::Store:
+		++cost.stores;
+		break;
+	default:
+		break;
+	}
+}
+
+lunarglass::ShaderCost lunarglass::detail::compute_module_cost(const llvm::Module &module)
+{
+	ShaderCost cost {};
+	std::unordered_map<const llvm::BasicBlock*,size_t> blockIndices {};
+	for(auto &function : module)
+	{
+		if(function.isDeclaration())
+			continue;
+		// The front ends lay out loop headers before their bodies, so a branch to a block
+		// that doesn't come later is a back edge
+		blockIndices.clear();
+		for(auto &block : function)
+			blockIndices.insert({&block,blockIndices.size()});
+		for(auto &block : function)
+		{
+			for(auto &instruction : block)
+			{
+				if(llvm::isa<llvm::AllocaInst>(instruction))
+					++cost.temporaries;
+				else
+					add_cost(cost,get_cost_category(instruction));
+			}
+			auto *terminator = block.getTerminator();
+			if(!terminator)
+				continue;
+			if(auto *branch = llvm::dyn_cast<llvm::BranchInst>(terminator))
+			{
+				if(branch->isConditional())
+					++cost.branches;
+			}
+			else if(llvm::isa<llvm::SwitchInst>(terminator))
+				++cost.branches;
+			auto blockIndex = blockIndices[&block];
+			for(auto i=decltype(terminator->getNumSuccessors()){0u};i<terminator->getNumSuccessors();++i)
+			{
+				if(blockIndices[terminator->getSuccessor(i)] <= blockIndex)
+					++cost.loops;
+			}
+		}
+	}
+	return cost;
+}
@@ -0,0 +1,32 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#ifndef __UTIL_LUNARGLASS_SHADER_COST_HPP__
+#define __UTIL_LUNARGLASS_SHADER_COST_HPP__
+
+#include "util_lunarglass/compile_stats.hpp"
+
+namespace llvm {class Instruction; class Module;};
+namespace lunarglass::detail
+{
+	enum class CostCategory : uint8_t
+	{
+		None = 0, // Free or structural, e.g. swizzles, address computations and terminators
+		Alu,
+		Texture,
+		Load,
+		Store
+	};
+	// Shared by the Top IR walk and the GLSL back end, so that both sides count the same way
+	CostCategory get_cost_category(const llvm::Instruction &instruction);
+	void add_cost(ShaderCost &cost,CostCategory category);
+
+	// Counts the operations of every defined function of a (Top IR) module
+	ShaderCost compute_module_cost(const llvm::Module &module);
+};
+
+#endif
@@ -0,0 +1,362 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#include "util_lunarglass/shader_pack.hpp"
+#include <filesystem>
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include <array>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	constexpr std::array<char,8> PACK_MAGIC = {'L','G','S','P','A','C','K','\0'};
+	constexpr uint32_t PACK_VERSION = 2;
+	// Reads back as PACK_BYTE_ORDER_SWAPPED on a machine with the opposite byte order
+	constexpr uint32_t PACK_BYTE_ORDER = 0x01020304;
+	constexpr uint32_t PACK_BYTE_ORDER_SWAPPED = 0x04030201;
+
+	struct PackHeader
+	{
+		std::array<char,8> magic;
+		uint32_t byteOrder;
+		uint32_t version;
+		uint32_t entryCount;
+		uint32_t reserved;
+		uint64_t indexOffset;
+		uint64_t fileSize;
+	};
+	static_assert(sizeof(PackHeader) == 40);
+
+	struct PackIndexEntry
+	{
+		lunarglass::CacheKey key;
+		uint64_t offset;
+		uint32_t size;
+		uint32_t stageCount;
+	};
+	static_assert(sizeof(PackIndexEntry) == 48);
+
+	struct PackStageRecord
+	{
+		uint32_t stage;
+		uint32_t size;
+		uint64_t offset;
+	};
+	static_assert(sizeof(PackStageRecord) == 16);
+
+	// Records are read with memcpy, so that a malformed file can't cause misaligned accesses
+	template<typename T>
+		T read_record(const uint8_t *data)
+	{
+		T record;
+		memcpy(&record,data,sizeof(record));
+		return record;
+	}
+	template<typename T>
+		void append_record(std::vector<uint8_t> &data,const T &record)
+	{
+		auto offset = data.size();
+		data.resize(offset +sizeof(record));
+		memcpy(data.data() +offset,&record,sizeof(record));
+	}
+};
+
+lunarglass::ShaderPack::Entry::Entry(const uint8_t *base,const uint8_t *stageRecords,uint32_t stageCount)
+	: m_base{base},m_stageRecords{stageRecords},m_stageCount{stageCount}
+{}
+
+uint32_t lunarglass::ShaderPack::Entry::GetStageCount() const {return m_stageCount;}
+
+std::string_view lunarglass::ShaderPack::Entry::GetStage(ShaderStage stage) const
+{
+	for(auto i=decltype(m_stageCount){0u};i<m_stageCount;++i)
+	{
+		auto record = read_record<PackStageRecord>(m_stageRecords +i *sizeof(PackStageRecord));
+		if(record.stage == static_cast<uint32_t>(stage))
+			return std::string_view{reinterpret_cast<const char*>(m_base +record.offset),record.size};
+	}
+	return {};
+}
+
+bool lunarglass::ShaderPack::Entry::HasStage(ShaderStage stage) const
+{
+	for(auto i=decltype(m_stageCount){0u};i<m_stageCount;++i)
+	{
+		if(read_record<PackStageRecord>(m_stageRecords +i *sizeof(PackStageRecord)).stage == static_cast<uint32_t>(stage))
+			return true;
+	}
+	return false;
+}
+
+std::unordered_map<lunarglass::ShaderStage,std::string> lunarglass::ShaderPack::Entry::ToShaderMap() const
+{
+	std::unordered_map<ShaderStage,std::string> shaders {};
+	for(auto i=decltype(m_stageCount){0u};i<m_stageCount;++i)
+	{
+		auto record = read_record<PackStageRecord>(m_stageRecords +i *sizeof(PackStageRecord));
+		shaders[static_cast<ShaderStage>(record.stage)] = std::string{reinterpret_cast<const char*>(m_base +record.offset),record.size};
+	}
+	return shaders;
+}
+
+std::unique_ptr<lunarglass::ShaderPack> lunarglass::ShaderPack::Open(const std::string &path,std::string &outErr)
+{
+	auto pack = std::unique_ptr<ShaderPack>{new ShaderPack{}};
+#ifdef _WIN32
+	auto hFile = CreateFileA(path.c_str(),GENERIC_READ,FILE_SHARE_READ,nullptr,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,nullptr);
+	if(hFile == INVALID_HANDLE_VALUE)
+	{
+		outErr = "Unable to open file '" +path +"'";
+		return nullptr;
+	}
+	pack->m_fileHandle = hFile;
+	LARGE_INTEGER size;
+	if(GetFileSizeEx(hFile,&size) == FALSE || size.QuadPart < static_cast<LONGLONG>(sizeof(PackHeader)))
+	{
+		outErr = "File '" +path +"' is too small to be a shader pack";
+		return nullptr;
+	}
+	pack->m_size = static_cast<size_t>(size.QuadPart);
+	auto hMapping = CreateFileMappingA(hFile,nullptr,PAGE_READONLY,0,0,nullptr);
+	if(hMapping == nullptr)
+	{
+		outErr = "Unable to map file '" +path +"'";
+		return nullptr;
+	}
+	pack->m_mappingHandle = hMapping;
+	pack->m_data = static_cast<const uint8_t*>(MapViewOfFile(hMapping,FILE_MAP_READ,0,0,0));
+	if(pack->m_data == nullptr)
+	{
+		outErr = "Unable to map file '" +path +"'";
+		return nullptr;
+	}
+#else
+	auto fd = open(path.c_str(),O_RDONLY);
+	if(fd == -1)
+	{
+		outErr = "Unable to open file '" +path +"'";
+		return nullptr;
+	}
+	struct stat st;
+	if(fstat(fd,&st) != 0 || st.st_size < static_cast<off_t>(sizeof(PackHeader)))
+	{
+		close(fd);
+		outErr = "File '" +path +"' is too small to be a shader pack";
+		return nullptr;
+	}
+	auto *data = mmap(nullptr,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+	// The mapping keeps the file referenced on its own
+	close(fd);
+	if(data == MAP_FAILED)
+	{
+		outErr = "Unable to map file '" +path +"'";
+		return nullptr;
+	}
+	pack->m_data = static_cast<const uint8_t*>(data);
+	pack->m_size = static_cast<size_t>(st.st_size);
+#endif
+
+	auto header = read_record<PackHeader>(pack->m_data);
+	if(header.magic != PACK_MAGIC)
+	{
+		outErr = "File '" +path +"' is not a shader pack";
+		return nullptr;
+	}
+	if(header.byteOrder != PACK_BYTE_ORDER)
+	{
+		if(header.byteOrder == PACK_BYTE_ORDER_SWAPPED)
+			outErr = "Shader pack '" +path +"' was written on a machine with a different byte order";
+		else
+			outErr = "Shader pack '" +path +"' is truncated or corrupt";
+		return nullptr;
+	}
+	if(header.version != PACK_VERSION)
+	{
+		outErr = "Shader pack '" +path +"' has unsupported version " +std::to_string(header.version);
+		return nullptr;
+	}
+	if(header.fileSize != pack->m_size || header.indexOffset > pack->m_size || (pack->m_size -header.indexOffset) /sizeof(PackIndexEntry) < header.entryCount)
+	{
+		outErr = "Shader pack '" +path +"' is truncated or corrupt";
+		return nullptr;
+	}
+	pack->m_entryCount = header.entryCount;
+	pack->m_index = pack->m_data +header.indexOffset;
+	return pack;
+}
+
+lunarglass::ShaderPack::~ShaderPack()
+{
+#ifdef _WIN32
+	if(m_data)
+		UnmapViewOfFile(m_data);
+	if(m_mappingHandle)
+		CloseHandle(m_mappingHandle);
+	if(m_fileHandle)
+		CloseHandle(m_fileHandle);
+#else
+	if(m_data)
+		munmap(const_cast<uint8_t*>(m_data),m_size);
+#endif
+}
+
+uint32_t lunarglass::ShaderPack::GetEntryCount() const {return m_entryCount;}
+
+const uint8_t *lunarglass::ShaderPack::GetIndexEntry(uint32_t index) const {return m_index +static_cast<size_t>(index) *sizeof(PackIndexEntry);}
+
+lunarglass::CacheKey lunarglass::ShaderPack::GetKey(uint32_t index) const
+{
+	CacheKey key;
+	memcpy(key.data(),GetIndexEntry(index),key.size());
+	return key;
+}
+
+std::optional<lunarglass::ShaderPack::Entry> lunarglass::ShaderPack::Find(const CacheKey &key) const
+{
+	// The key is the first member of every index entry, so it can be compared in place
+	uint32_t first = 0;
+	auto count = m_entryCount;
+	while(count > 0)
+	{
+		auto step = count /2;
+		auto mid = first +step;
+		if(memcmp(GetIndexEntry(mid),key.data(),key.size()) < 0)
+		{
+			first = mid +1;
+			count -= step +1;
+		}
+		else
+			count = step;
+	}
+	if(first == m_entryCount || memcmp(GetIndexEntry(first),key.data(),key.size()) != 0)
+		return {};
+
+	auto indexEntry = read_record<PackIndexEntry>(GetIndexEntry(first));
+	if(indexEntry.offset > m_size || indexEntry.size > m_size -indexEntry.offset || indexEntry.stageCount > indexEntry.size /sizeof(PackStageRecord))
+		return {};
+	auto *stageRecords = m_data +indexEntry.offset;
+	for(auto i=decltype(indexEntry.stageCount){0u};i<indexEntry.stageCount;++i)
+	{
+		auto record = read_record<PackStageRecord>(stageRecords +i *sizeof(PackStageRecord));
+		// Every source has to be followed by its null-terminator, a corrupt pack must not hand out unterminated text
+		if(record.stage >= static_cast<uint32_t>(ShaderStage::Count) || record.offset > m_size || record.size >= m_size -record.offset || m_data[record.offset +record.size] != '\0')
+			return {};
+	}
+	return Entry{m_data,stageRecords,indexEntry.stageCount};
+}
+
+void lunarglass::ShaderPackWriter::Add(const CacheKey &key,const std::unordered_map<ShaderStage,std::string> &shaders) {m_entries[key] = shaders;}
+
+size_t lunarglass::ShaderPackWriter::GetEntryCount() const {return m_entries.size();}
+
+bool lunarglass::ShaderPackWriter::Write(const std::string &path,std::string &outErr) const
+{
+	// Sizes and counts are stored as 32-bit integers
+	constexpr auto maxSize = std::numeric_limits<uint32_t>::max();
+	if(m_entries.size() > maxSize)
+	{
+		outErr = "Too many programs for a shader pack";
+		return false;
+	}
+
+	std::vector<uint8_t> data {};
+	auto align = [&data]() {data.resize((data.size() +7) &~static_cast<size_t>(7),0);};
+
+	PackHeader header {};
+	header.magic = PACK_MAGIC;
+	header.byteOrder = PACK_BYTE_ORDER;
+	header.version = PACK_VERSION;
+	header.entryCount = static_cast<uint32_t>(m_entries.size());
+	header.indexOffset = sizeof(PackHeader);
+	append_record(data,header);
+
+	// std::map iterates in key order, which matches the lexicographical order of memcmp
+	std::vector<PackIndexEntry> index {};
+	index.reserve(m_entries.size());
+	data.resize(data.size() +m_entries.size() *sizeof(PackIndexEntry),0);
+	for(auto &pair : m_entries)
+	{
+		align();
+		PackIndexEntry indexEntry {};
+		indexEntry.key = pair.first;
+		indexEntry.offset = data.size();
+		indexEntry.stageCount = static_cast<uint32_t>(pair.second.size());
+
+		// Stage records in stage order, so that the file contents are deterministic
+		std::vector<std::pair<ShaderStage,const std::string*>> stages {};
+		stages.reserve(pair.second.size());
+		for(auto &stagePair : pair.second)
+			stages.push_back({stagePair.first,&stagePair.second});
+		std::sort(stages.begin(),stages.end());
+
+		auto recordOffset = data.size();
+		data.resize(data.size() +stages.size() *sizeof(PackStageRecord),0);
+		for(auto &stage : stages)
+		{
+			if(stage.second->size() > maxSize)
+			{
+				outErr = std::string{"The "} +get_shader_stage_name(stage.first) +" shader of a program exceeds the maximum size of a shader pack entry";
+				return false;
+			}
+			PackStageRecord record {};
+			record.stage = static_cast<uint32_t>(stage.first);
+			record.size = static_cast<uint32_t>(stage.second->size());
+			record.offset = data.size();
+			memcpy(data.data() +recordOffset,&record,sizeof(record));
+			recordOffset += sizeof(record);
+			data.insert(data.end(),stage.second->begin(),stage.second->end());
+			data.push_back(0);
+		}
+		if(data.size() -indexEntry.offset > maxSize)
+		{
+			outErr = "A program exceeds the maximum size of a shader pack entry";
+			return false;
+		}
+		indexEntry.size = static_cast<uint32_t>(data.size() -indexEntry.offset);
+		index.push_back(indexEntry);
+	}
+	align();
+	memcpy(data.data() +header.indexOffset,index.data(),index.size() *sizeof(PackIndexEntry));
+	header.fileSize = data.size();
+	memcpy(data.data(),&header,sizeof(header));
+
+	auto tmpPath = path +".tmp";
+	{
+		std::ofstream file {tmpPath,std::ios::binary | std::ios::trunc};
+		if(!file)
+		{
+			outErr = "Unable to open file '" +tmpPath +"' for writing";
+			return false;
+		}
+		file.write(reinterpret_cast<const char*>(data.data()),data.size());
+		if(!file)
+		{
+			outErr = "Unable to write shader pack to '" +tmpPath +"'";
+			return false;
+		}
+	}
+	std::error_code ec;
+	std::filesystem::rename(tmpPath,path,ec);
+	if(ec)
+	{
+		std::filesystem::remove(tmpPath,ec);
+		outErr = "Unable to move shader pack to '" +path +"'";
+		return false;
+	}
+	return true;
+}
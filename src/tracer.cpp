@@ -0,0 +1,175 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#include "util_lunarglass/tracer.hpp"
+#include <fstream>
+#include <cstdio>
+
+namespace
+{
+	void append_json_string(std::string &out,std::string_view str)
+	{
+		out += '"';
+		for(auto c : str)
+		{
+			switch(c)
+			{
+			case '"':
+				out += "\\\"";
+				break;
+			case '\\':
+				out += "\\\\";
+				break;
+			case '\n':
+				out += "\\n";
+				break;
+			case '\r':
+				out += "\\r";
+				break;
+			case '\t':
+				out += "\\t";
+				break;
+			default:
+				if(static_cast<unsigned char>(c) < 0x20)
+				{
+					char buf[8];
+					snprintf(buf,sizeof(buf),"\\u%04x",static_cast<unsigned int>(c));
+					out += buf;
+				}
+				else
+					out += c;
+				break;
+			}
+		}
+		out += '"';
+	}
+	void append_json_number(std::string &out,double value)
+	{
+		char buf[32];
+		snprintf(buf,sizeof(buf),"%.3f",value);
+		out += buf;
+	}
+};
+
+lunarglass::Tracer::Tracer()
+	: m_epoch{Clock::now()}
+{}
+
+uint32_t lunarglass::Tracer::GetThreadIndex()
+{
+	auto it = m_threadIndices.find(std::this_thread::get_id());
+	if(it != m_threadIndices.end())
+		return it->second;
+	auto index = static_cast<uint32_t>(m_threadIndices.size()) +1;
+	m_threadIndices[std::this_thread::get_id()] = index;
+	return index;
+}
+
+void lunarglass::Tracer::AddSpan(std::string_view name,std::string_view category,Clock::time_point start,Clock::time_point end,std::string_view programName,std::optional<ShaderStage> stage)
+{
+	Span span {};
+	span.name = name;
+	span.category = category;
+	span.programName = programName;
+	span.stage = stage;
+	span.startUs = std::chrono::duration<double,std::micro>{start -m_epoch}.count();
+	span.durationUs = std::chrono::duration<double,std::micro>{end -start}.count();
+	std::scoped_lock lock {m_mutex};
+	span.threadIndex = GetThreadIndex();
+	m_spans.push_back(std::move(span));
+}
+
+void lunarglass::Tracer::SetThreadName(std::string_view name)
+{
+	std::scoped_lock lock {m_mutex};
+	m_threadNames[GetThreadIndex()] = name;
+}
+
+size_t lunarglass::Tracer::GetSpanCount() const
+{
+	std::scoped_lock lock {m_mutex};
+	return m_spans.size();
+}
+
+void lunarglass::Tracer::Clear()
+{
+	std::scoped_lock lock {m_mutex};
+	m_spans.clear();
+}
+
+std::string lunarglass::Tracer::ToJson() const
+{
+	std::scoped_lock lock {m_mutex};
+	std::string json;
+	json.reserve(256 +m_spans.size() *160);
+	json += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	auto first = true;
+	auto beginEvent = [&json,&first]() {
+		if(first == false)
+			json += ",";
+		first = false;
+		json += "\n{";
+	};
+	for(auto &pair : m_threadNames)
+	{
+		beginEvent();
+		json += "\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" +std::to_string(pair.first) +",\"args\":{\"name\":";
+		append_json_string(json,pair.second);
+		json += "}}";
+	}
+	for(auto &span : m_spans)
+	{
+		beginEvent();
+		json += "\"name\":";
+		append_json_string(json,span.name);
+		json += ",\"cat\":";
+		append_json_string(json,span.category);
+		json += ",\"ph\":\"X\",\"ts\":";
+		append_json_number(json,span.startUs);
+		json += ",\"dur\":";
+		append_json_number(json,span.durationUs);
+		json += ",\"pid\":1,\"tid\":" +std::to_string(span.threadIndex);
+		if(span.programName.empty() == false || span.stage.has_value())
+		{
+			json += ",\"args\":{";
+			if(span.programName.empty() == false)
+			{
+				json += "\"shader\":";
+				append_json_string(json,span.programName);
+				if(span.stage.has_value())
+					json += ",";
+			}
+			if(span.stage.has_value())
+			{
+				json += "\"stage\":";
+				append_json_string(json,get_shader_stage_name(*span.stage));
+			}
+			json += "}";
+		}
+		json += "}";
+	}
+	json += "\n]}\n";
+	return json;
+}
+
+bool lunarglass::Tracer::Write(const std::string &path,std::string &outErr) const
+{
+	auto json = ToJson();
+	std::ofstream file {path,std::ios::binary | std::ios::trunc};
+	if(!file)
+	{
+		outErr = "Unable to open file '" +path +"' for writing";
+		return false;
+	}
+	file.write(json.data(),json.size());
+	if(!file)
+	{
+		outErr = "Unable to write trace to '" +path +"'";
+		return false;
+	}
+	return true;
+}
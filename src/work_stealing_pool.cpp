@@ -0,0 +1,127 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#include "work_stealing_pool.hpp"
+#include <algorithm>
+
+lunarglass::WorkStealingPool::WorkStealingPool(uint32_t threadCount)
+{
+	if(threadCount == 0)
+		threadCount = std::max(std::thread::hardware_concurrency(),1u);
+	m_queues.reserve(threadCount);
+	for(auto i=decltype(threadCount){0u};i<threadCount;++i)
+		m_queues.push_back(std::make_unique<TaskQueue>());
+
+	// Worker 0 is whichever thread calls Run
+	m_threads.reserve(threadCount -1);
+	for(auto i=decltype(threadCount){1u};i<threadCount;++i)
+		m_threads.emplace_back(&WorkStealingPool::WorkerMain,this,i);
+}
+
+lunarglass::WorkStealingPool::~WorkStealingPool()
+{
+	{
+		std::scoped_lock lock {m_mutex};
+		m_stop = true;
+	}
+	m_workAvailable.notify_all();
+	for(auto &thread : m_threads)
+		thread.join();
+}
+
+uint32_t lunarglass::WorkStealingPool::GetThreadCount() const {return static_cast<uint32_t>(m_queues.size());}
+
+bool lunarglass::WorkStealingPool::PopTask(uint32_t workerIndex,size_t &outTaskIndex)
+{
+	// Own queue first (LIFO keeps the caches warm), then steal from the front of the others
+	{
+		auto &queue = *m_queues[workerIndex];
+		std::scoped_lock lock {queue.mutex};
+		if(queue.tasks.empty() == false)
+		{
+			outTaskIndex = queue.tasks.back();
+			queue.tasks.pop_back();
+			return true;
+		}
+	}
+	auto numQueues = m_queues.size();
+	for(auto offset=decltype(numQueues){1u};offset<numQueues;++offset)
+	{
+		auto &queue = *m_queues[(workerIndex +offset) %numQueues];
+		std::scoped_lock lock {queue.mutex};
+		if(queue.tasks.empty())
+			continue;
+		outTaskIndex = queue.tasks.front();
+		queue.tasks.pop_front();
+		return true;
+	}
+	return false;
+}
+
+void lunarglass::WorkStealingPool::ProcessTasks(uint32_t workerIndex)
+{
+	size_t taskIndex;
+	while(PopTask(workerIndex,taskIndex))
+		(*m_task)(workerIndex,taskIndex);
+}
+
+void lunarglass::WorkStealingPool::WorkerMain(uint32_t workerIndex)
+{
+	uint64_t lastGeneration = 0;
+	for(;;)
+	{
+		{
+			std::unique_lock lock {m_mutex};
+			m_workAvailable.wait(lock,[this,lastGeneration]() {return m_stop || m_generation != lastGeneration;});
+			if(m_stop)
+				return;
+			lastGeneration = m_generation;
+		}
+		ProcessTasks(workerIndex);
+		{
+			std::scoped_lock lock {m_mutex};
+			if(--m_activeWorkers == 0)
+				m_workDone.notify_all();
+		}
+	}
+}
+
+void lunarglass::WorkStealingPool::Run(size_t taskCount,const std::function<void(uint32_t,size_t)> &fn)
+{
+	if(taskCount == 0)
+		return;
+	std::scoped_lock runLock {m_runMutex};
+
+	// Hand out contiguous blocks so that workers only start stealing once their own share is exhausted
+	auto numQueues = m_queues.size();
+	auto blockSize = (taskCount +numQueues -1) /numQueues;
+	for(auto i=decltype(numQueues){0u};i<numQueues;++i)
+	{
+		auto &queue = *m_queues[i];
+		std::scoped_lock lock {queue.mutex};
+		auto start = std::min(i *blockSize,taskCount);
+		auto end = std::min(start +blockSize,taskCount);
+		// Pushed in reverse, so that popping from the back processes the block in order
+		for(auto taskIndex=end;taskIndex>start;--taskIndex)
+			queue.tasks.push_back(taskIndex -1);
+	}
+
+	{
+		std::scoped_lock lock {m_mutex};
+		m_task = &fn;
+		m_activeWorkers = static_cast<uint32_t>(m_threads.size());
+		++m_generation;
+	}
+	m_workAvailable.notify_all();
+
+	ProcessTasks(0);
+
+	// All queues are empty at this point, but workers may still be busy with their last task
+	std::unique_lock lock {m_mutex};
+	m_workDone.wait(lock,[this]() {return m_activeWorkers == 0;});
+	m_task = nullptr;
+}
@@ -0,0 +1,65 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+#ifndef __UTIL_LUNARGLASS_WORK_STEALING_POOL_HPP__
+#define __UTIL_LUNARGLASS_WORK_STEALING_POOL_HPP__
+
+#include <condition_variable>
+#include <functional>
+#include <cinttypes>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <mutex>
+
+namespace lunarglass
+{
+	// Fixed-size thread pool in which every worker owns a task queue. Workers pop from the back
+	// of their own queue and steal from the front of other queues once their own queue runs dry,
+	// which keeps all threads busy even if the cost of individual tasks varies wildly.
+	class WorkStealingPool
+	{
+	public:
+		// A thread count of 0 uses the number of hardware threads
+		explicit WorkStealingPool(uint32_t threadCount=0);
+		~WorkStealingPool();
+		WorkStealingPool(const WorkStealingPool&)=delete;
+		WorkStealingPool &operator=(const WorkStealingPool&)=delete;
+
+		// Total number of threads taking part in Run, including the calling thread
+		uint32_t GetThreadCount() const;
+
+		// Invokes fn(workerIndex,taskIndex) for every task index in [0,taskCount) and blocks
+		// until all of them have completed. The calling thread takes part as worker 0.
+		// The task function must not throw.
+		void Run(size_t taskCount,const std::function<void(uint32_t,size_t)> &fn);
+	private:
+		struct TaskQueue
+		{
+			std::mutex mutex;
+			std::deque<size_t> tasks;
+		};
+		bool PopTask(uint32_t workerIndex,size_t &outTaskIndex);
+		void ProcessTasks(uint32_t workerIndex);
+		void WorkerMain(uint32_t workerIndex);
+
+		std::vector<std::unique_ptr<TaskQueue>> m_queues;
+		std::vector<std::thread> m_threads;
+
+		std::mutex m_runMutex;
+		std::mutex m_mutex;
+		std::condition_variable m_workAvailable;
+		std::condition_variable m_workDone;
+		const std::function<void(uint32_t,size_t)> *m_task = nullptr;
+		uint64_t m_generation = 0;
+		uint32_t m_activeWorkers = 0;
+		bool m_stop = false;
+	};
+};
+
+#endif
@@ -0,0 +1,227 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+// Stress test for the thread safety of optimize_glsl: Every corpus program is compiled serially first,
+// then by several threads calling optimize_glsl at the same time, twice in a row by one Compiler
+// session and as a batch. All of them have to produce output byte-identical to the serial one.
+
+#include "corpus.hpp"
+#include <util_lunarglass/util_lunarglass.hpp>
+#include <util_lunarglass/compiler.hpp>
+#include <condition_variable>
+#include <algorithm>
+#include <iostream>
+#include <optional>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <vector>
+
+#ifndef UTIL_LUNARGLASS_BENCH_CORPUS_DIR
+#define UTIL_LUNARGLASS_BENCH_CORPUS_DIR "corpus"
+#endif
+
+using namespace lunarglass;
+using namespace lunarglass::bench;
+
+namespace
+{
+	using ShaderMap = std::unordered_map<ShaderStage,std::string>;
+
+	struct TestConfig
+	{
+		std::string corpusDirectory = UTIL_LUNARGLASS_BENCH_CORPUS_DIR;
+		uint32_t threadCount = 0;
+		uint32_t rounds = 4;
+	};
+
+	struct OptionSet
+	{
+		const char *name;
+		Options options;
+	};
+
+	// Obfuscation used to share its line counter between translators, parallelStages adds threads of its own
+	std::vector<OptionSet> get_option_sets()
+	{
+		std::vector<OptionSet> sets {};
+		sets.push_back({"default",Options{}});
+		Options obfuscated {};
+		obfuscated.obfuscate = true;
+		sets.push_back({"obfuscate",obfuscated});
+		Options parallel {};
+		parallel.parallelStages = true;
+		sets.push_back({"parallel_stages",parallel});
+		return sets;
+	}
+
+	std::optional<ShaderMap> compile(const CorpusProgram &program,const Options &options)
+	{
+		std::string infoLog;
+		try
+		{
+			return optimize_glsl(program.shaders,options,infoLog);
+		}
+		catch(const std::exception&)
+		{
+			return {};
+		}
+	}
+
+	bool parse_args(int argc,char *argv[],TestConfig &config)
+	{
+		for(auto i=1;i<argc;++i)
+		{
+			std::string arg = argv[i];
+			if(i +1 >= argc)
+			{
+				std::cerr<<"Usage: util_lunarglass_test_concurrency [--corpus <dir>] [--threads <n>] [--rounds <n>]\n";
+				return false;
+			}
+			std::string value = argv[++i];
+			try
+			{
+				if(arg == "--corpus")
+					config.corpusDirectory = value;
+				else if(arg == "--threads")
+					config.threadCount = static_cast<uint32_t>(std::stoul(value));
+				else if(arg == "--rounds")
+					config.rounds = static_cast<uint32_t>(std::stoul(value));
+				else
+				{
+					std::cerr<<"Unknown argument '"<<arg<<"'\n";
+					return false;
+				}
+			}
+			catch(const std::exception&)
+			{
+				std::cerr<<"Invalid value '"<<value<<"' for "<<arg<<"\n";
+				return false;
+			}
+		}
+		// At least a few threads even on small machines, the point is to have them overlap
+		if(config.threadCount == 0)
+			config.threadCount = std::max(std::thread::hardware_concurrency(),4u);
+		return true;
+	}
+};
+
+int main(int argc,char *argv[])
+{
+	TestConfig config {};
+	if(parse_args(argc,argv,config) == false)
+		return 2;
+	std::string err;
+	auto programs = load_corpus(config.corpusDirectory,"",err);
+	if(programs.has_value() == false || programs->empty())
+	{
+		std::cerr<<"Unable to load corpus '"<<config.corpusDirectory<<"': "<<err<<"\n";
+		return 2;
+	}
+
+	uint32_t failures = 0;
+	for(auto &optionSet : get_option_sets())
+	{
+		std::vector<std::optional<ShaderMap>> serial {};
+		serial.reserve(programs->size());
+		for(auto &program : *programs)
+		{
+			serial.push_back(compile(program,optionSet.options));
+			if(serial.back().has_value() == false)
+			{
+				std::cerr<<"["<<optionSet.name<<"] "<<program.name<<": failed to compile serially\n";
+				++failures;
+			}
+		}
+
+		// Threads are released at the same time, so that their first compiles (and their process-wide
+		// initialization) overlap as well
+		std::mutex startMutex;
+		std::condition_variable startCondition;
+		auto started = false;
+		std::mutex mismatchMutex;
+		std::vector<std::string> mismatches {};
+		auto reportMismatch = [&](const std::string &name) {
+			std::scoped_lock lock {mismatchMutex};
+			if(std::find(mismatches.begin(),mismatches.end(),name) == mismatches.end())
+				mismatches.push_back(name);
+		};
+		auto worker = [&](uint32_t threadIndex) {
+			{
+				std::unique_lock lock {startMutex};
+				startCondition.wait(lock,[&started]() {return started;});
+			}
+			for(auto round=0u;round<config.rounds;++round)
+			{
+				// Every thread starts at a different program, so that different translations interleave
+				for(auto i=decltype(programs->size()){0u};i<programs->size();++i)
+				{
+					auto programIndex = (i +threadIndex +round) %programs->size();
+					auto &program = (*programs)[programIndex];
+					if(compile(program,optionSet.options) != serial[programIndex])
+						reportMismatch(program.name);
+				}
+			}
+		};
+		std::vector<std::thread> threads {};
+		threads.reserve(config.threadCount);
+		for(auto i=0u;i<config.threadCount;++i)
+			threads.emplace_back(worker,i);
+		{
+			std::scoped_lock lock {startMutex};
+			started = true;
+		}
+		startCondition.notify_all();
+		for(auto &thread : threads)
+			thread.join();
+
+		// A session keeps its back ends between programs; Nothing of an earlier program may leak into
+		// the output of a later one, so the whole corpus goes through it twice
+		Compiler session {optionSet.options};
+		for(auto pass=0u;pass<2u;++pass)
+		{
+			for(auto i=decltype(programs->size()){0u};i<programs->size();++i)
+			{
+				auto &program = (*programs)[i];
+				std::string infoLog;
+				std::optional<ShaderMap> shaders {};
+				try
+				{
+					shaders = session.Optimize(program.shaders,infoLog);
+				}
+				catch(const std::exception&)
+				{}
+				if(shaders != serial[i])
+					reportMismatch(program.name +" (session)");
+			}
+		}
+
+		// Batches run on one session per worker, which programs share a session depends on scheduling
+		std::vector<ShaderMap> batchPrograms {};
+		for(auto i=0u;i<config.rounds;++i)
+		{
+			for(auto &program : *programs)
+				batchPrograms.push_back(program.shaders);
+		}
+		BatchOptions batchOptions {};
+		batchOptions.threadCount = config.threadCount;
+		batchOptions.programOptions = optionSet.options;
+		auto batchResults = optimize_glsl_batch(batchPrograms,batchOptions);
+		for(auto i=decltype(batchResults.size()){0u};i<batchResults.size();++i)
+		{
+			auto programIndex = i %programs->size();
+			if(batchResults[i].shaders != serial[programIndex])
+				reportMismatch((*programs)[programIndex].name +" (batch)");
+		}
+
+		for(auto &name : mismatches)
+			std::cerr<<"["<<optionSet.name<<"] "<<name<<": output differs from serial optimize_glsl output\n";
+		failures += static_cast<uint32_t>(mismatches.size());
+		std::cerr<<"["<<optionSet.name<<"] "<<programs->size()<<" programs x "<<config.rounds<<" rounds on "<<config.threadCount<<" threads, "<<mismatches.size()<<" mismatches\n";
+	}
+	return (failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,90 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+// Names made by the GLSL back end for hashed (obfuscated) identifiers: Repeats have to be unique and
+// must never contain "__", which GLSL reserves.
+
+#include "GlslTargetUtil.h"
+#include <iostream>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace
+{
+	uint32_t check_names(const char *caseName,const std::vector<std::string> &names,const gla::HashedNameMap &hashedNames)
+	{
+		uint32_t failures = 0;
+		for(auto i=decltype(names.size()){0u};i<names.size();++i)
+		{
+			if(names[i].find("__") != std::string::npos)
+			{
+				std::cerr<<caseName<<": '"<<names[i]<<"' contains a double underscore\n";
+				++failures;
+			}
+			for(auto j=decltype(names.size()){0u};j<i;++j)
+			{
+				if(names[i] == names[j])
+				{
+					std::cerr<<caseName<<": '"<<names[i]<<"' was made twice\n";
+					++failures;
+				}
+			}
+			if(hashedNames.find(names[i]) == hashedNames.end())
+			{
+				std::cerr<<caseName<<": '"<<names[i]<<"' was not recorded\n";
+				++failures;
+			}
+		}
+		return failures;
+	}
+
+	// Every base name is requested several times, so that the repeats have to be numbered
+	uint32_t test_unique_names(const char *caseName,const std::vector<std::string> &baseNames)
+	{
+		gla::HashedNameMap hashedNames {};
+		std::vector<std::string> names {};
+		for(auto repeat=0u;repeat<3u;++repeat)
+		{
+			for(auto &baseName : baseNames)
+			{
+				auto name = baseName;
+				gla::MakeUniqueName(name,hashedNames);
+				names.push_back(name);
+			}
+		}
+		return check_names(caseName,names,hashedNames);
+	}
+
+	uint32_t test_hash_names(const char *caseName,const char *prefix)
+	{
+		gla::HashedNameMap hashedNames {};
+		std::vector<std::string> names {};
+		for(auto repeat=0u;repeat<3u;++repeat)
+		{
+			for(auto *key : {"color","normal","uv"})
+			{
+				std::string name;
+				gla::MakeHashName(prefix,key,name,hashedNames);
+				names.push_back(name);
+			}
+		}
+		return check_names(caseName,names,hashedNames);
+	}
+};
+
+int main()
+{
+	uint32_t failures = 0;
+	// A name that ends in '_' is what MakeHashName produces when the hash text is empty
+	failures += test_unique_names("trailing_underscore",{"H_","H_1","H"});
+	failures += test_unique_names("empty",{"","_1"});
+	failures += test_unique_names("plain",{"Hx31s06qat9y5t3","Hx31s06qat9y5t3_1"});
+	failures += test_hash_names("hash_prefix_underscore","H_");
+	failures += test_hash_names("hash_prefix","H");
+	return (failures > 0) ? 1 : 0;
+}
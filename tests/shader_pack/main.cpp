@@ -0,0 +1,103 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*
+* Copyright (c) 2020 Florian Weischer
+*/
+
+// Shader packs that were truncated or corrupted on disk: Lookups have to miss instead of handing out
+// text that isn't null-terminated.
+
+#include <util_lunarglass/shader_pack.hpp>
+#include <filesystem>
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <fstream>
+#include <vector>
+
+using namespace lunarglass;
+
+namespace
+{
+	const std::string VERTEX_SOURCE = "#version 450\nvoid main() {gl_Position = vec4(0.0);}\n";
+
+	std::vector<char> read_file(const std::string &path)
+	{
+		std::ifstream file {path,std::ios::binary};
+		return {std::istreambuf_iterator<char>{file},std::istreambuf_iterator<char>{}};
+	}
+
+	bool write_file(const std::string &path,const std::vector<char> &data)
+	{
+		std::ofstream file {path,std::ios::binary | std::ios::trunc};
+		file.write(data.data(),data.size());
+		return file.good();
+	}
+
+	// Returns 0 on a hit with the expected source, 1 on a miss and 2 if the pack couldn't be opened
+	int lookup(const std::string &path,const CacheKey &key)
+	{
+		std::string err;
+		auto pack = ShaderPack::Open(path,err);
+		if(pack == nullptr)
+		{
+			std::cerr<<"Unable to open pack '"<<path<<"': "<<err<<"\n";
+			return 2;
+		}
+		auto entry = pack->Find(key);
+		if(entry.has_value() == false)
+			return 1;
+		return (entry->GetStage(ShaderStage::Vertex) == VERTEX_SOURCE) ? 0 : 1;
+	}
+};
+
+int main()
+{
+	auto path = (std::filesystem::temp_directory_path() /"util_lunarglass_test_shader_pack.lgpack").string();
+	CacheKey key {};
+	key.fill(0x5a);
+	ShaderPackWriter writer {};
+	writer.Add(key,{{ShaderStage::Vertex,VERTEX_SOURCE}});
+	std::string err;
+	if(writer.Write(path,err) == false)
+	{
+		std::cerr<<"Unable to write pack '"<<path<<"': "<<err<<"\n";
+		return 2;
+	}
+
+	uint32_t failures = 0;
+	if(lookup(path,key) != 0)
+	{
+		std::cerr<<"Intact pack: entry not found\n";
+		++failures;
+	}
+
+	// Overwrite the null-terminator of the only source
+	auto data = read_file(path);
+	auto it = std::search(data.begin(),data.end(),VERTEX_SOURCE.begin(),VERTEX_SOURCE.end());
+	auto terminatorOffset = (it -data.begin()) +VERTEX_SOURCE.size();
+	if(it == data.end() || terminatorOffset >= data.size())
+	{
+		std::cerr<<"Source not found in pack '"<<path<<"'\n";
+		return 2;
+	}
+	data[terminatorOffset] = 'x';
+	if(write_file(path,data) == false)
+	{
+		std::cerr<<"Unable to corrupt pack '"<<path<<"'\n";
+		return 2;
+	}
+	auto result = lookup(path,key);
+	if(result == 2)
+		return 2;
+	if(result == 0)
+	{
+		std::cerr<<"Corrupted pack: entry without null-terminator was returned\n";
+		++failures;
+	}
+
+	std::error_code ec;
+	std::filesystem::remove(path,ec);
+	return (failures > 0) ? 1 : 0;
+}